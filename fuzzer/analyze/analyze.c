@@ -0,0 +1,975 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "db.h"
+#include "columnar.h"
+#include "segment.h"
+#include "bootstrap.h"
+#include "sketch.h"
+#include "hash.h"
+
+#define ANALYZE_MAX_THREADS 256
+#define ANALYZE_DEFAULT_TOP 20
+#define ANALYZE_DEFAULT_SEED 0x4C56492D444D41ULL
+#define ANALYZE_CSV_CHUNK (8u << 20)
+#define ANALYZE_COLUMNAR_BLOCKS 16
+#define ANALYZE_OUTCOMES (RACE_UNKNOWN + 1)
+#define ANALYZE_HIST_BUCKETS 65
+#define GROUP_EMPTY UINT64_MAX
+
+static const char *outcome_names[ANALYZE_OUTCOMES] = {
+    "SUCCESS", "TOO_EARLY", "TOO_LATE", "FAILED", "UNKNOWN"
+};
+
+typedef enum {
+    BOOTSTRAP_NONE,
+    BOOTSTRAP_CAMPAIGN,
+    BOOTSTRAP_GADGET
+} bootstrap_mode_t;
+
+typedef struct {
+    uint64_t attempts;
+    uint64_t leaks;
+    uint64_t outcomes[ANALYZE_OUTCOMES];
+    uint64_t latency_sum;
+    uint64_t leak_latency_sum;
+    int64_t time_min;
+    int64_t time_max;
+} group_stats_t;
+
+// Open addressing keyed by gadget address or campaign id. GROUP_EMPTY marks
+// a free slot; no gadget or campaign uses it.
+typedef struct {
+    uint64_t *keys;
+    group_stats_t *stats;
+    uint32_t capacity;
+    uint32_t count;
+} group_map_t;
+
+typedef struct {
+    uint64_t key;
+    const group_stats_t *stats;
+} group_entry_t;
+
+// A bootstrap sample tagged with the hash that decided it was kept.
+typedef struct {
+    uint64_t hash;
+    uint64_t latency;
+} tagged_sample_t;
+
+typedef struct {
+    tagged_sample_t *items;
+    uint32_t count;
+    uint32_t capacity;
+} sample_vec_t;
+
+// Groups larger than MAX_SAMPLES are subsampled by hashing each record's
+// (campaign, experiment) id against a threshold, so the kept set does not
+// depend on how the log was split between threads.
+typedef struct {
+    uint64_t key;
+    uint64_t leak_threshold;
+    uint64_t no_leak_threshold;
+} boot_group_t;
+
+typedef struct {
+    const char *path;
+    db_format_t format;
+    db_query_t query;
+    uint32_t threads;
+
+    const char *csv;
+    size_t csv_size;
+    columnar_view_t view;
+
+    uint64_t part_count;
+    uint64_t next_part;
+
+    bootstrap_mode_t mode;
+    bool bootstrap_pass;
+    boot_group_t *groups;       // sorted by key
+    uint32_t group_count;
+} analyze_t;
+
+typedef struct {
+    analyze_t *an;
+    pthread_t thread;
+    bool ok;
+
+    uint64_t scanned;
+    uint64_t malformed;
+    uint64_t segments_read;
+    uint64_t records;
+    uint64_t leaks;
+    uint64_t outcomes[ANALYZE_OUTCOMES];
+    uint64_t histogram[2][ANALYZE_HIST_BUCKETS];   // [leak][bit length of latency]
+    quantile_sketch_t *latency[2];
+    group_map_t gadgets;
+    group_map_t campaigns;
+
+    sample_vec_t *samples;      // [group * 2 + leak]
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool group_map_init(group_map_t *map, uint32_t capacity) {
+    map->capacity = capacity;
+    map->count = 0;
+    map->keys = malloc(capacity * sizeof(uint64_t));
+    map->stats = malloc(capacity * sizeof(group_stats_t));
+    if (!map->keys || !map->stats) return false;
+    memset(map->keys, 0xFF, capacity * sizeof(uint64_t));
+    return true;
+}
+
+static void group_map_free(group_map_t *map) {
+    free(map->keys);
+    free(map->stats);
+    memset(map, 0, sizeof(*map));
+}
+
+static group_stats_t* group_map_get(group_map_t *map, uint64_t key);
+
+static bool group_map_grow(group_map_t *map) {
+    group_map_t grown;
+    if (!group_map_init(&grown, map->capacity * 2)) {
+        group_map_free(&grown);
+        return false;
+    }
+    for (uint32_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i] == GROUP_EMPTY) continue;
+        *group_map_get(&grown, map->keys[i]) = map->stats[i];
+    }
+    group_map_free(map);
+    *map = grown;
+    return true;
+}
+
+static group_stats_t* group_map_get(group_map_t *map, uint64_t key) {
+    if ((map->count + 1) * 4 > map->capacity * 3 && !group_map_grow(map)) return NULL;
+
+    uint32_t mask = map->capacity - 1;
+    uint32_t i = (uint32_t)hash_mix64(key) & mask;
+    while (map->keys[i] != key) {
+        if (map->keys[i] == GROUP_EMPTY) {
+            map->keys[i] = key;
+            memset(&map->stats[i], 0, sizeof(group_stats_t));
+            map->stats[i].time_min = INT64_MAX;
+            map->stats[i].time_max = INT64_MIN;
+            map->count++;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &map->stats[i];
+}
+
+static bool group_map_merge(group_map_t *dst, const group_map_t *src) {
+    for (uint32_t i = 0; i < src->capacity; i++) {
+        if (src->keys[i] == GROUP_EMPTY) continue;
+        const group_stats_t *s = &src->stats[i];
+        group_stats_t *d = group_map_get(dst, src->keys[i]);
+        if (!d) return false;
+
+        d->attempts += s->attempts;
+        d->leaks += s->leaks;
+        for (int o = 0; o < ANALYZE_OUTCOMES; o++) d->outcomes[o] += s->outcomes[o];
+        d->latency_sum += s->latency_sum;
+        d->leak_latency_sum += s->leak_latency_sum;
+        if (s->time_min < d->time_min) d->time_min = s->time_min;
+        if (s->time_max > d->time_max) d->time_max = s->time_max;
+    }
+    return true;
+}
+
+static void group_stats_add(group_stats_t *s, int64_t timestamp, uint32_t outcome,
+                            bool leak, uint64_t latency) {
+    s->attempts++;
+    s->outcomes[outcome]++;
+    s->latency_sum += latency;
+    if (leak) {
+        s->leaks++;
+        s->leak_latency_sum += latency;
+    }
+    if (timestamp < s->time_min) s->time_min = timestamp;
+    if (timestamp > s->time_max) s->time_max = timestamp;
+}
+
+static bool sample_vec_push(sample_vec_t *vec, uint64_t hash, uint64_t latency) {
+    if (vec->count == vec->capacity) {
+        uint32_t capacity = vec->capacity ? vec->capacity * 2 : 256;
+        tagged_sample_t *grown = realloc(vec->items, capacity * sizeof(tagged_sample_t));
+        if (!grown) return false;
+        vec->items = grown;
+        vec->capacity = capacity;
+    }
+    vec->items[vec->count++] = (tagged_sample_t){ hash, latency };
+    return true;
+}
+
+static const boot_group_t* find_group(const analyze_t *an, uint64_t key) {
+    uint32_t lo = 0, hi = an->group_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (an->groups[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < an->group_count && an->groups[lo].key == key) ? &an->groups[lo] : NULL;
+}
+
+static void visit(worker_t *w, int64_t timestamp, uint64_t campaign_id, uint64_t experiment_id,
+                  uint64_t gadget_addr, uint32_t outcome, bool leak, uint64_t latency) {
+    const analyze_t *an = w->an;
+    w->scanned++;
+    if (!db_query_match(&an->query, campaign_id, timestamp)) return;
+    if (outcome > RACE_UNKNOWN) outcome = RACE_UNKNOWN;
+
+    if (an->bootstrap_pass) {
+        const boot_group_t *g = find_group(an, an->mode == BOOTSTRAP_CAMPAIGN ? campaign_id
+                                                                                : gadget_addr);
+        if (!g) return;
+        uint64_t hash = hash_mix64(campaign_id ^ hash_mix64(experiment_id));
+        if (hash > (leak ? g->leak_threshold : g->no_leak_threshold)) return;
+        sample_vec_t *vec = &w->samples[(g - an->groups) * 2 + leak];
+        if (!sample_vec_push(vec, hash, latency)) w->ok = false;
+        return;
+    }
+
+    w->records++;
+    w->leaks += leak;
+    w->outcomes[outcome]++;
+    w->histogram[leak][latency ? 64 - __builtin_clzll(latency) : 0]++;
+    sketch_add(w->latency[leak], latency);
+
+    group_stats_t *g = group_map_get(&w->gadgets, gadget_addr);
+    group_stats_t *c = group_map_get(&w->campaigns, campaign_id);
+    if (!g || !c) {
+        w->ok = false;
+        return;
+    }
+    group_stats_add(g, timestamp, outcome, leak, latency);
+    group_stats_add(c, timestamp, outcome, leak, latency);
+}
+
+static bool visit_block(void *ctx, const columnar_block_t *b) {
+    worker_t *w = ctx;
+    for (uint32_t i = 0; i < b->count; i++) {
+        visit(w, b->timestamp[i], b->campaign_id[i], b->experiment_id[i], b->gadget_addr[i],
+              b->outcome[i], b->leak_detected[i], b->leak_latency[i]);
+    }
+    return w->ok;
+}
+
+// Parsers for the fixed db_open CSV schema; anything else fails the line.
+static bool parse_u64(const char **p, const char *end, uint64_t *v) {
+    const char *s = *p;
+    uint64_t x = 0;
+    while (s < end && *s >= '0' && *s <= '9') x = x * 10 + (uint64_t)(*s++ - '0');
+    if (s == *p) return false;
+    *p = s;
+    *v = x;
+    return true;
+}
+
+static bool parse_hex(const char **p, const char *end, uint64_t *v) {
+    const char *s = *p;
+    if (end - s < 3 || s[0] != '0' || (s[1] != 'x' && s[1] != 'X')) return false;
+    s += 2;
+    const char *digits = s;
+    uint64_t x = 0;
+    for (; s < end; s++) {
+        char c = *s;
+        if (c >= '0' && c <= '9') x = (x << 4) | (uint64_t)(c - '0');
+        else if (c >= 'a' && c <= 'f') x = (x << 4) | (uint64_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') x = (x << 4) | (uint64_t)(c - 'A' + 10);
+        else break;
+    }
+    if (s == digits) return false;
+    *p = s;
+    *v = x;
+    return true;
+}
+
+static bool expect_comma(const char **p, const char *end) {
+    if (*p >= end || **p != ',') return false;
+    (*p)++;
+    return true;
+}
+
+static bool parse_line(worker_t *w, const char *p, const char *end) {
+    bool negative = (p < end && *p == '-');
+    uint64_t ts, campaign_id, experiment_id, gadget_addr, leak, latency;
+    if (negative) p++;
+    if (!parse_u64(&p, end, &ts) || !expect_comma(&p, end) ||
+        !parse_u64(&p, end, &campaign_id) || !expect_comma(&p, end) ||
+        !parse_u64(&p, end, &experiment_id) || !expect_comma(&p, end) ||
+        !parse_hex(&p, end, &gadget_addr) || !expect_comma(&p, end)) {
+        return false;
+    }
+
+    const char *name = p;
+    while (p < end && *p != ',') p++;
+    uint32_t outcome = RACE_UNKNOWN;
+    for (uint32_t o = 0; o < ANALYZE_OUTCOMES; o++) {
+        size_t len = strlen(outcome_names[o]);
+        if ((size_t)(p - name) == len && memcmp(name, outcome_names[o], len) == 0) {
+            outcome = o;
+            break;
+        }
+    }
+
+    if (!expect_comma(&p, end) || !parse_u64(&p, end, &leak) || !expect_comma(&p, end) ||
+        !parse_u64(&p, end, &latency)) {
+        return false;
+    }
+
+    visit(w, negative ? -(int64_t)ts : (int64_t)ts, campaign_id, experiment_id, gadget_addr,
+          outcome, leak != 0, latency);
+    return true;
+}
+
+// A line belongs to the chunk holding its first byte.
+static void scan_csv_chunk(worker_t *w, uint64_t part) {
+    const analyze_t *an = w->an;
+    const char *base = an->csv;
+    const char *file_end = base + an->csv_size;
+    const char *p = base + part * ANALYZE_CSV_CHUNK;
+    const char *chunk_end = p + ANALYZE_CSV_CHUNK;
+    if (chunk_end > file_end) chunk_end = file_end;
+
+    if (p > base && p[-1] != '\n') {
+        const char *nl = memchr(p, '\n', file_end - p);
+        p = nl ? nl + 1 : file_end;
+    }
+
+    while (p < chunk_end && w->ok) {
+        const char *nl = memchr(p, '\n', file_end - p);
+        const char *line_end = nl ? nl : file_end;
+        if (*p != 't' && *p != '#' && line_end > p && !parse_line(w, p, line_end)) {
+            w->malformed++;
+        }
+        p = line_end + 1;
+    }
+}
+
+static bool scan_sqlite(worker_t *w) {
+    const analyze_t *an = w->an;
+    sqlite3 *conn = NULL;
+    sqlite3_stmt *st = NULL;
+    if (sqlite3_open_v2(an->path, &conn, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "SELECT timestamp, campaign_id, experiment_id, gadget_addr, "
+                                 "outcome, leak_detected, leak_latency FROM experiments "
+                                 "WHERE campaign_id BETWEEN ?1 AND ?2 "
+                                 "AND timestamp BETWEEN ?3 AND ?4",
+                           -1, &st, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[-] Cannot read experiment database %s: %s\n", an->path,
+                conn ? sqlite3_errmsg(conn) : "out of memory");
+        sqlite3_close(conn);
+        return false;
+    }
+
+    sqlite3_bind_int64(st, 1, (sqlite3_int64)(an->query.campaign_min > INT64_MAX ? INT64_MAX
+                                              : an->query.campaign_min));
+    sqlite3_bind_int64(st, 2, (sqlite3_int64)(an->query.campaign_max > INT64_MAX ? INT64_MAX
+                                              : an->query.campaign_max));
+    sqlite3_bind_int64(st, 3, an->query.time_min);
+    sqlite3_bind_int64(st, 4, an->query.time_max);
+
+    int rc;
+    while (w->ok && (rc = sqlite3_step(st)) == SQLITE_ROW) {
+        visit(w, sqlite3_column_int64(st, 0), (uint64_t)sqlite3_column_int64(st, 1),
+              (uint64_t)sqlite3_column_int64(st, 2), (uint64_t)sqlite3_column_int64(st, 3),
+              (uint32_t)sqlite3_column_int(st, 4), sqlite3_column_int(st, 5) != 0,
+              (uint64_t)sqlite3_column_int64(st, 6));
+    }
+    bool ok = w->ok && rc == SQLITE_DONE;
+
+    sqlite3_finalize(st);
+    sqlite3_close(conn);
+    return ok;
+}
+
+static void scan_part(worker_t *w, uint64_t part) {
+    analyze_t *an = w->an;
+
+    switch (an->format) {
+        case DB_FORMAT_CSV:
+            scan_csv_chunk(w, part);
+            break;
+        case DB_FORMAT_COLUMNAR: {
+            uint64_t last = (part + 1) * ANALYZE_COLUMNAR_BLOCKS;
+            if (last > an->view.block_count) last = an->view.block_count;
+            for (uint64_t b = part * ANALYZE_COLUMNAR_BLOCKS; b < last && w->ok; b++) {
+                columnar_block_t block;
+                columnar_block(&an->view, b, &block);
+                visit_block(w, &block);
+            }
+            break;
+        }
+        case DB_FORMAT_SEGMENTED: {
+            segment_scan_stats_t stats;
+            if (!segment_log_scan_range(an->path, (uint32_t)part, 1, &an->query, visit_block, w,
+                                        &stats)) {
+                w->ok = false;
+            }
+            w->segments_read += stats.segments_read;
+            break;
+        }
+        case DB_FORMAT_SQLITE:
+            if (!scan_sqlite(w)) w->ok = false;
+            break;
+    }
+}
+
+static void* worker_main(void *arg) {
+    worker_t *w = arg;
+    analyze_t *an = w->an;
+    uint64_t part;
+    while (w->ok && (part = __atomic_fetch_add(&an->next_part, 1, __ATOMIC_RELAXED)) < an->part_count) {
+        scan_part(w, part);
+    }
+    return NULL;
+}
+
+static bool worker_init(worker_t *w, analyze_t *an) {
+    memset(w, 0, sizeof(*w));
+    w->an = an;
+    w->ok = true;
+    w->latency[0] = sketch_create();
+    w->latency[1] = sketch_create();
+    return w->latency[0] && w->latency[1] &&
+           group_map_init(&w->gadgets, 1024) && group_map_init(&w->campaigns, 64);
+}
+
+static void worker_free(worker_t *w, uint32_t group_count) {
+    sketch_destroy(w->latency[0]);
+    sketch_destroy(w->latency[1]);
+    group_map_free(&w->gadgets);
+    group_map_free(&w->campaigns);
+    if (w->samples) {
+        for (uint32_t i = 0; i < group_count * 2; i++) free(w->samples[i].items);
+        free(w->samples);
+    }
+}
+
+// Runs one pass over the log with every worker; worker 0 is this thread.
+static bool run_pass(analyze_t *an, worker_t *workers) {
+    an->next_part = 0;
+    uint32_t started = 1;
+    for (uint32_t t = 1; t < an->threads; t++, started++) {
+        if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) != 0) break;
+    }
+    worker_main(&workers[0]);
+
+    bool ok = true;
+    for (uint32_t t = 1; t < started; t++) pthread_join(workers[t].thread, NULL);
+    for (uint32_t t = 0; t < an->threads; t++) ok &= workers[t].ok;
+    if (started < an->threads) {
+        // Threads that could not start leave their parts to the others.
+        fprintf(stderr, "[-] Started %u of %u threads\n", started, an->threads);
+    }
+    return ok;
+}
+
+static bool merge_workers(worker_t *workers, uint32_t threads) {
+    worker_t *dst = &workers[0];
+    for (uint32_t t = 1; t < threads; t++) {
+        worker_t *w = &workers[t];
+        dst->scanned += w->scanned;
+        dst->malformed += w->malformed;
+        dst->segments_read += w->segments_read;
+        dst->records += w->records;
+        dst->leaks += w->leaks;
+        for (int o = 0; o < ANALYZE_OUTCOMES; o++) dst->outcomes[o] += w->outcomes[o];
+        for (int l = 0; l < 2; l++) {
+            for (int b = 0; b < ANALYZE_HIST_BUCKETS; b++) dst->histogram[l][b] += w->histogram[l][b];
+            sketch_merge(dst->latency[l], w->latency[l]);
+        }
+        if (!group_map_merge(&dst->gadgets, &w->gadgets) ||
+            !group_map_merge(&dst->campaigns, &w->campaigns)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int compare_by_attempts(const void *a, const void *b) {
+    const group_entry_t *x = a, *y = b;
+    if (x->stats->attempts != y->stats->attempts) return x->stats->attempts > y->stats->attempts ? -1 : 1;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int compare_by_key(const void *a, const void *b) {
+    const group_entry_t *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int compare_groups(const void *a, const void *b) {
+    const boot_group_t *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const tagged_sample_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (x->latency > y->latency) - (x->latency < y->latency);
+}
+
+static group_entry_t* group_entries(const group_map_t *map, int (*compare)(const void*, const void*)) {
+    group_entry_t *entries = malloc((map->count ? map->count : 1) * sizeof(group_entry_t));
+    if (!entries) return NULL;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != GROUP_EMPTY) entries[n++] = (group_entry_t){ map->keys[i], &map->stats[i] };
+    }
+    qsort(entries, n, sizeof(group_entry_t), compare);
+    return entries;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? (double)part / whole * 100.0 : 0.0;
+}
+
+static void print_latency(const char *label, const quantile_sketch_t *s) {
+    if (s->total == 0) {
+        printf("    %-8s %12lu\n", label, 0UL);
+        return;
+    }
+    printf("    %-8s %12lu %8lu %8lu %8lu %8lu %8lu\n", label, s->total, s->min,
+           sketch_value_at_rank(s, s->total / 2),
+           sketch_value_at_rank(s, (uint64_t)(s->total * 0.9)),
+           sketch_value_at_rank(s, (uint64_t)(s->total * 0.99)), s->max);
+}
+
+static void print_report(const worker_t *w, uint32_t top) {
+    printf("\nOutcomes:\n");
+    for (int o = 0; o < ANALYZE_OUTCOMES; o++) {
+        printf("    %-10s %12lu  %6.2f%%\n", outcome_names[o], w->outcomes[o],
+               percent(w->outcomes[o], w->records));
+    }
+    printf("    Leaks      %12lu  %6.2f%%\n", w->leaks, percent(w->leaks, w->records));
+
+    printf("\nLatency (cycles):\n");
+    printf("    %-8s %12s %8s %8s %8s %8s %8s\n", "", "count", "min", "p50", "p90", "p99", "max");
+    print_latency("leak", w->latency[1]);
+    print_latency("no leak", w->latency[0]);
+
+    printf("\nLatency histogram:\n");
+    printf("    %-21s %12s %12s\n", "cycles", "leak", "no leak");
+    for (int b = 0; b < ANALYZE_HIST_BUCKETS; b++) {
+        if (w->histogram[0][b] == 0 && w->histogram[1][b] == 0) continue;
+        uint64_t lo = b ? 1ULL << (b - 1) : 0;
+        uint64_t hi = b ? (b == 64 ? UINT64_MAX : (1ULL << b) - 1) : 0;
+        printf("    %9lu - %-9lu %12lu %12lu\n", lo, hi, w->histogram[1][b], w->histogram[0][b]);
+    }
+
+    group_entry_t *campaigns = group_entries(&w->campaigns, compare_by_key);
+    if (campaigns) {
+        printf("\nCampaigns (%u):\n", w->campaigns.count);
+        printf("    %-20s %12s %12s %8s %12s %12s\n", "campaign", "attempts", "leaks", "rate",
+               "first", "last");
+        for (uint32_t i = 0; i < w->campaigns.count; i++) {
+            const group_stats_t *s = campaigns[i].stats;
+            printf("    %-20lu %12lu %12lu %7.2f%% %12ld %12ld\n", campaigns[i].key, s->attempts,
+                   s->leaks, percent(s->leaks, s->attempts), s->time_min, s->time_max);
+        }
+        free(campaigns);
+    }
+
+    group_entry_t *gadgets = group_entries(&w->gadgets, compare_by_attempts);
+    if (gadgets) {
+        uint32_t shown = top < w->gadgets.count ? top : w->gadgets.count;
+        printf("\nGadgets (%u, top %u by attempts):\n", w->gadgets.count, shown);
+        printf("    %-18s %10s %10s %8s %8s %8s %8s %10s\n", "gadget", "attempts", "leaks", "rate",
+               "early", "late", "failed", "latency");
+        for (uint32_t i = 0; i < shown; i++) {
+            const group_stats_t *s = gadgets[i].stats;
+            printf("    0x%-16lx %10lu %10lu %7.2f%% %7.2f%% %7.2f%% %7.2f%% %10.1f\n",
+                   gadgets[i].key, s->attempts, s->leaks, percent(s->leaks, s->attempts),
+                   percent(s->outcomes[RACE_TOO_EARLY], s->attempts),
+                   percent(s->outcomes[RACE_TOO_LATE], s->attempts),
+                   percent(s->outcomes[RACE_FAILED], s->attempts),
+                   s->attempts ? (double)s->latency_sum / s->attempts : 0.0);
+        }
+        free(gadgets);
+    }
+}
+
+static bool write_gadgets_csv(const group_map_t *gadgets, const char *path) {
+    group_entry_t *entries = group_entries(gadgets, compare_by_attempts);
+    FILE *fp = entries ? fopen(path, "w") : NULL;
+    if (!fp) {
+        fprintf(stderr, "[-] Cannot write %s\n", path);
+        free(entries);
+        return false;
+    }
+
+    fprintf(fp, "gadget_addr,attempts,leaks,success_rate,success,too_early,too_late,failed,"
+                "unknown,mean_latency,mean_leak_latency\n");
+    for (uint32_t i = 0; i < gadgets->count; i++) {
+        const group_stats_t *s = entries[i].stats;
+        fprintf(fp, "0x%lx,%lu,%lu,%.6f,%lu,%lu,%lu,%lu,%lu,%.3f,%.3f\n", entries[i].key,
+                s->attempts, s->leaks, s->attempts ? (double)s->leaks / s->attempts : 0.0,
+                s->outcomes[RACE_SUCCESS], s->outcomes[RACE_TOO_EARLY],
+                s->outcomes[RACE_TOO_LATE], s->outcomes[RACE_FAILED], s->outcomes[RACE_UNKNOWN],
+                s->attempts ? (double)s->latency_sum / s->attempts : 0.0,
+                s->leaks ? (double)s->leak_latency_sum / s->leaks : 0.0);
+    }
+    free(entries);
+
+    bool ok = fclose(fp) == 0;
+    if (ok) printf("[+] Wrote %u gadgets to %s\n", gadgets->count, path);
+    return ok;
+}
+
+// Keeps roughly MAX_SAMPLES of n values; the slack makes falling short
+// unlikely and the sort in build_population trims the excess.
+static uint64_t sample_threshold(uint64_t n) {
+    if (n <= MAX_SAMPLES) return UINT64_MAX;
+    double keep = (MAX_SAMPLES + 4.0 * sqrt((double)MAX_SAMPLES)) / (double)n;
+    if (keep >= 1.0) return UINT64_MAX;
+    return (uint64_t)(keep * 18446744073709551616.0);
+}
+
+static sample_population_t* build_population(worker_t *workers, uint32_t threads, uint32_t slot) {
+    uint64_t total = 0;
+    for (uint32_t t = 0; t < threads; t++) total += workers[t].samples[slot].count;
+
+    tagged_sample_t *all = malloc((total ? total : 1) * sizeof(tagged_sample_t));
+    if (!all) return NULL;
+    uint64_t n = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        const sample_vec_t *v = &workers[t].samples[slot];
+        memcpy(all + n, v->items, v->count * sizeof(tagged_sample_t));
+        n += v->count;
+    }
+    qsort(all, n, sizeof(tagged_sample_t), compare_samples);
+    if (n > MAX_SAMPLES) n = MAX_SAMPLES;
+
+    sample_population_t *pop = population_create((uint32_t)(n ? n : 1));
+    for (uint64_t i = 0; pop && i < n; i++) population_add(pop, all[i].latency);
+    free(all);
+    return pop;
+}
+
+static bool run_bootstrap(analyze_t *an, worker_t *workers, bootstrap_config_t *boot) {
+    const group_map_t *source = (an->mode == BOOTSTRAP_CAMPAIGN) ? &workers[0].campaigns
+                                                                 : &workers[0].gadgets;
+    group_entry_t *entries = group_entries(source, compare_by_attempts);
+    if (!entries) return false;
+
+    an->group_count = source->count;
+    an->groups = malloc((an->group_count ? an->group_count : 1) * sizeof(boot_group_t));
+    if (!an->groups) {
+        free(entries);
+        return false;
+    }
+    for (uint32_t i = 0; i < an->group_count; i++) {
+        const group_stats_t *s = entries[i].stats;
+        an->groups[i] = (boot_group_t){
+            .key = entries[i].key,
+            .leak_threshold = sample_threshold(s->leaks),
+            .no_leak_threshold = sample_threshold(s->attempts - s->leaks)
+        };
+    }
+    free(entries);
+    qsort(an->groups, an->group_count, sizeof(boot_group_t), compare_groups);
+
+    // The second pass only collects latencies, so the aggregates gathered
+    // by the first one are left alone.
+    worker_t *pass = calloc(an->threads, sizeof(worker_t));
+    bool ok = pass != NULL;
+    for (uint32_t t = 0; ok && t < an->threads; t++) {
+        pass[t].an = an;
+        pass[t].ok = true;
+        pass[t].samples = calloc((size_t)an->group_count * 2 + 1, sizeof(sample_vec_t));
+        ok = pass[t].samples != NULL;
+    }
+
+    uint64_t start = now_ns();
+    an->bootstrap_pass = true;
+    ok = ok && run_pass(an, pass);
+    an->bootstrap_pass = false;
+    if (ok) {
+        printf("[+] Collected bootstrap samples for %u %s in %.2f s\n", an->group_count,
+               an->mode == BOOTSTRAP_CAMPAIGN ? "campaigns" : "gadgets",
+               (now_ns() - start) / 1e9);
+        printf("\nBootstrap (%u rounds, alpha %.4f, threshold %lu cycles):\n",
+               boot->bootstrap_rounds, boot->alpha, boot->negligible_threshold_cycles);
+        printf("    %-20s %8s %8s %10s %22s %10s  %s\n",
+               an->mode == BOOTSTRAP_CAMPAIGN ? "campaign" : "gadget", "leak", "no leak",
+               "median diff", "CI", "p-value", "verdict");
+    }
+
+    for (uint32_t g = 0; ok && g < an->group_count; g++) {
+        sample_population_t *leak = build_population(pass, an->threads, g * 2 + 1);
+        sample_population_t *no_leak = build_population(pass, an->threads, g * 2);
+        if (!leak || !no_leak) {
+            population_destroy(leak);
+            population_destroy(no_leak);
+            ok = false;
+            break;
+        }
+
+        char key[24];
+        if (an->mode == BOOTSTRAP_CAMPAIGN) snprintf(key, sizeof(key), "%lu", an->groups[g].key);
+        else snprintf(key, sizeof(key), "0x%lx", an->groups[g].key);
+
+        if (leak->count < 10 || no_leak->count < 10) {
+            printf("    %-20s %8u %8u %10s %22s %10s  %s\n", key, leak->count, no_leak->count,
+                   "-", "-", "-", "insufficient samples");
+        } else {
+            population_clean_outliers(leak, boot);
+            population_clean_outliers(no_leak, boot);
+
+            bootstrap_result_t result = {0};
+            bool exploitable = bootstrap_test(leak, no_leak, boot, &result);
+            char ci[48];
+            snprintf(ci, sizeof(ci), "[%.2f, %.2f]", result.ci_lower, result.ci_upper);
+            printf("    %-20s %8u %8u %10.2f %22s %10.6f  %s\n", key, leak->count, no_leak->count,
+                   result.median_diff, ci, result.p_value,
+                   exploitable ? "EXPLOITABLE" :
+                   result.is_significant ? "significant, negligible" : "not significant");
+        }
+
+        population_destroy(leak);
+        population_destroy(no_leak);
+    }
+
+    for (uint32_t t = 0; pass && t < an->threads; t++) worker_free(&pass[t], an->group_count);
+    free(pass);
+    free(an->groups);
+    an->groups = NULL;
+    return ok;
+}
+
+static bool open_input(analyze_t *an) {
+    an->format = db_detect_format(an->path);
+
+    switch (an->format) {
+        case DB_FORMAT_CSV: {
+            int fd = open(an->path, O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                if (fd >= 0) close(fd);
+                fprintf(stderr, "[-] Cannot open %s\n", an->path);
+                return false;
+            }
+            an->csv_size = (size_t)st.st_size;
+            if (an->csv_size > 0) {
+                void *map = mmap(NULL, an->csv_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) {
+                    close(fd);
+                    fprintf(stderr, "[-] Cannot map %s\n", an->path);
+                    return false;
+                }
+                madvise(map, an->csv_size, MADV_SEQUENTIAL);
+                an->csv = map;
+            }
+            close(fd);
+            an->part_count = (an->csv_size + ANALYZE_CSV_CHUNK - 1) / ANALYZE_CSV_CHUNK;
+            return true;
+        }
+        case DB_FORMAT_COLUMNAR:
+            if (!columnar_map(an->path, &an->view)) return false;
+            an->part_count = (an->view.block_count + ANALYZE_COLUMNAR_BLOCKS - 1) /
+                             ANALYZE_COLUMNAR_BLOCKS;
+            return true;
+        case DB_FORMAT_SEGMENTED:
+            an->part_count = segment_log_count(an->path);
+            return true;
+        case DB_FORMAT_SQLITE:
+            // One reader: SQLite serialises a connection anyway.
+            an->part_count = 1;
+            return true;
+    }
+    return false;
+}
+
+static void close_input(analyze_t *an) {
+    if (an->csv) munmap((void*)an->csv, an->csv_size);
+    if (an->format == DB_FORMAT_COLUMNAR) columnar_unmap(&an->view);
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [OPTIONS] LOG\n\n", prog);
+    printf("Summarises an experiment log written by lvi-dma-fuzzer (any --log-format).\n\n");
+    printf("Options:\n");
+    printf("  -j, --threads N          Parser threads (default: 0 = all CPUs)\n");
+    printf("  -n, --top N              Gadgets to list, and to test with --bootstrap gadget (default: 20)\n");
+    printf("  -B, --bootstrap MODE     Rerun the bootstrap test per campaign or per gadget\n");
+    printf("  -r, --rounds N           Bootstrap rounds (default: 10000)\n");
+    printf("  -a, --alpha FLOAT        Statistical significance level (default: 0.05)\n");
+    printf("  -t, --threshold N        Negligible leak threshold in cycles (default: 50)\n");
+    printf("  -S, --seed N             Bootstrap RNG seed (default: fixed)\n");
+    printf("  -c, --campaign ID        Only records of campaign ID\n");
+    printf("  -T, --time T0:T1         Only records with T0 <= timestamp <= T1 (Unix seconds)\n");
+    printf("  -g, --gadgets-csv PATH   Write every gadget's statistics as CSV\n");
+    printf("  -h, --help               Show this help message\n\n");
+    printf("Example:\n");
+    printf("  %s -B gadget -n 10 lvi-dma-results.csv\n\n", prog);
+}
+
+int main(int argc, char **argv) {
+    analyze_t an = {0};
+    db_query_all(&an.query);
+    uint32_t threads = 0;
+    uint32_t top = ANALYZE_DEFAULT_TOP;
+    const char *gadgets_csv = NULL;
+    bootstrap_config_t boot = {
+        .bootstrap_rounds = DEFAULT_BOOTSTRAP_ROUNDS,
+        .alpha = 0.05,
+        .negligible_threshold_cycles = 50,
+        .seed = ANALYZE_DEFAULT_SEED,
+        .histogram_max_range = BOOTSTRAP_HISTOGRAM_MAX_RANGE,
+        .quiet = true
+    };
+
+    static struct option long_options[] = {
+        {"threads",     required_argument, 0, 'j'},
+        {"top",         required_argument, 0, 'n'},
+        {"bootstrap",   required_argument, 0, 'B'},
+        {"rounds",      required_argument, 0, 'r'},
+        {"alpha",       required_argument, 0, 'a'},
+        {"threshold",   required_argument, 0, 't'},
+        {"seed",        required_argument, 0, 'S'},
+        {"campaign",    required_argument, 0, 'c'},
+        {"time",        required_argument, 0, 'T'},
+        {"gadgets-csv", required_argument, 0, 'g'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:n:B:r:a:t:S:c:T:g:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'n':
+                top = atoi(optarg);
+                break;
+            case 'B':
+                if (strcmp(optarg, "campaign") == 0) {
+                    an.mode = BOOTSTRAP_CAMPAIGN;
+                } else if (strcmp(optarg, "gadget") == 0) {
+                    an.mode = BOOTSTRAP_GADGET;
+                } else {
+                    fprintf(stderr, "[-] Unknown bootstrap mode '%s' (campaign or gadget)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                boot.bootstrap_rounds = atoi(optarg);
+                break;
+            case 'a':
+                boot.alpha = atof(optarg);
+                break;
+            case 't':
+                boot.negligible_threshold_cycles = strtoull(optarg, NULL, 0);
+                break;
+            case 'S':
+                boot.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                an.query.campaign_min = strtoull(optarg, NULL, 0);
+                an.query.campaign_max = an.query.campaign_min;
+                break;
+            case 'T': {
+                char *end;
+                an.query.time_min = strtoll(optarg, &end, 0);
+                an.query.time_max = (*end == ':') ? strtoll(end + 1, NULL, 0) : an.query.time_min;
+                break;
+            }
+            case 'g':
+                gadgets_csv = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    an.path = argv[optind];
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (uint32_t)cpus : 1;
+    }
+    if (threads > ANALYZE_MAX_THREADS) threads = ANALYZE_MAX_THREADS;
+    an.threads = threads;
+    boot.num_threads = threads;
+
+    if (!open_input(&an)) return 1;
+    if (an.part_count < an.threads) an.threads = an.part_count ? (uint32_t)an.part_count : 1;
+
+    printf("[*] Analyzing %s (%s, %u threads)\n", an.path, db_format_name(an.format), an.threads);
+
+    worker_t *workers = calloc(an.threads, sizeof(worker_t));
+    bool ok = workers != NULL;
+    for (uint32_t t = 0; ok && t < an.threads; t++) ok = worker_init(&workers[t], &an);
+
+    uint64_t start = now_ns();
+    ok = ok && run_pass(&an, workers) && merge_workers(workers, an.threads);
+    double elapsed = (now_ns() - start) / 1e9;
+
+    if (ok) {
+        worker_t *w = &workers[0];
+        printf("[+] Read %lu records, %lu matched, in %.2f s (%.1f M records/s)\n", w->scanned,
+               w->records, elapsed, elapsed > 0 ? w->scanned / elapsed / 1e6 : 0.0);
+        if (an.format == DB_FORMAT_SEGMENTED) {
+            printf("    Segments read: %lu of %lu\n", w->segments_read, an.part_count);
+        }
+        if (w->malformed > 0) printf("[-] Skipped %lu malformed lines\n", w->malformed);
+
+        print_report(w, top);
+        if (gadgets_csv) ok = write_gadgets_csv(&w->gadgets, gadgets_csv);
+
+        if (an.mode == BOOTSTRAP_GADGET && w->gadgets.count > top) {
+            // Only the most-tried gadgets get a test; trim the rest.
+            group_entry_t *entries = group_entries(&w->gadgets, compare_by_attempts);
+            group_map_t kept = {0};
+            ok = entries && group_map_init(&kept, 64);
+            for (uint32_t i = 0; ok && i < top; i++) {
+                group_stats_t *s = group_map_get(&kept, entries[i].key);
+                ok = s != NULL;
+                if (ok) *s = *entries[i].stats;
+            }
+            free(entries);
+            group_map_free(ok ? &w->gadgets : &kept);
+            if (ok) w->gadgets = kept;
+        }
+        if (ok && an.mode != BOOTSTRAP_NONE) ok = run_bootstrap(&an, workers, &boot);
+    } else {
+        fprintf(stderr, "[-] Failed to read %s\n", an.path);
+    }
+
+    for (uint32_t t = 0; workers && t < an.threads; t++) worker_free(&workers[t], 0);
+    free(workers);
+    close_input(&an);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,470 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "timing.h"
+#include "cache.h"
+#include "virtio.h"
+#include "race.h"
+#include "bootstrap.h"
+#include "gadgets.h"
+#include "db.h"
+#include "rng.h"
+#include "alias.h"
+
+#define BENCH_SEED 0x4C56492D444D41ULL
+#define BENCH_CORPUS_SIZE (1u << 20)
+#define BENCH_DEFAULT_SAMPLES 51
+
+typedef struct {
+    const char *name;
+    uint32_t samples;
+    uint64_t batch;
+    double median_ns;
+    double p99_ns;
+    double ops_per_sec;
+} bench_result_t;
+
+typedef void (*bench_fn_t)(void *ctx, uint64_t batch);
+
+static uint32_t g_samples = BENCH_DEFAULT_SAMPLES;
+static bool g_first_result = true;
+static int g_saved_stdout = -1;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Library code reports progress on stdout; keep it out of the JSON.
+static void quiet_begin(void) {
+    fflush(stdout);
+    g_saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull >= 0) {
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+}
+
+static void quiet_end(void) {
+    fflush(stdout);
+    if (g_saved_stdout >= 0) {
+        dup2(g_saved_stdout, STDOUT_FILENO);
+        close(g_saved_stdout);
+        g_saved_stdout = -1;
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double va = *(const double*)a;
+    double vb = *(const double*)b;
+    return (va > vb) - (va < vb);
+}
+
+static void bench_emit(bench_result_t *r) {
+    printf("%s\n    {\"name\": \"%s\", \"samples\": %u, \"batch\": %lu, "
+           "\"median_ns\": %.3f, \"p99_ns\": %.3f, \"ops_per_sec\": %.1f}",
+           g_first_result ? "" : ",", r->name, r->samples, r->batch,
+           r->median_ns, r->p99_ns, r->ops_per_sec);
+    g_first_result = false;
+    fflush(stdout);
+}
+
+static void bench_run(const char *name, bench_fn_t fn, void *ctx, uint64_t batch) {
+    double *per_op = calloc(g_samples, sizeof(double));
+    if (!per_op) return;
+
+    quiet_begin();
+    fn(ctx, batch);
+
+    for (uint32_t s = 0; s < g_samples; s++) {
+        uint64_t start = now_ns();
+        fn(ctx, batch);
+        per_op[s] = (double)(now_ns() - start) / batch;
+    }
+    quiet_end();
+
+    qsort(per_op, g_samples, sizeof(double), compare_double);
+
+    uint32_t p99_idx = (uint32_t)(0.99 * (g_samples - 1) + 0.5);
+    bench_result_t r = {
+        .name = name,
+        .samples = g_samples,
+        .batch = batch,
+        .median_ns = per_op[g_samples / 2],
+        .p99_ns = per_op[p99_idx],
+        .ops_per_sec = per_op[g_samples / 2] > 0 ? 1e9 / per_op[g_samples / 2] : 0.0
+    };
+    bench_emit(&r);
+
+    free(per_op);
+}
+
+typedef struct {
+    volatile uint64_t *line;
+    uint64_t threshold;
+    uint64_t sink;
+} cache_ctx_t;
+
+static void bench_cache_probe_time(void *ctx, uint64_t batch) {
+    cache_ctx_t *c = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        c->sink += cache_probe_time(c->line);
+    }
+}
+
+static void bench_cache_flush_reload(void *ctx, uint64_t batch) {
+    cache_ctx_t *c = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        c->sink += cache_flush_reload(c->line, c->threshold);
+    }
+}
+
+#define BENCH_SAMPLE_GADGETS (1u << 18)
+
+typedef struct {
+    uint8_t *corpus;
+    size_t size;
+    gadget_list_t *list;
+    alias_table_t alias;
+    rng_t rng;
+    uint64_t sink;
+} gadget_ctx_t;
+
+static void build_corpus(gadget_ctx_t *g) {
+    rng_t rng;
+    rng_seed(&rng, BENCH_SEED, 0);
+
+    for (size_t i = 0; i < g->size; i += 8) {
+        uint64_t word = rng_next(&rng);
+        memcpy(&g->corpus[i], &word, 8);
+    }
+}
+
+static void bench_gadget_is_lvi_susceptible(void *ctx, uint64_t batch) {
+    gadget_ctx_t *g = ctx;
+    size_t span = g->size - MAX_GADGET_LENGTH;
+    for (uint64_t i = 0; i < batch; i++) {
+        size_t offset = (i * 4099) % span;
+        g->sink += gadget_is_lvi_susceptible(&g->corpus[offset], MAX_GADGET_LENGTH);
+    }
+}
+
+static void bench_gadget_scan_memory_region(void *ctx, uint64_t batch) {
+    gadget_ctx_t *g = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        gadget_list_t *list = gadget_list_create();
+        gadget_scan_memory_region((uint64_t)g->corpus, g->size, list);
+        g->sink += list->count;
+        gadget_list_destroy(list);
+    }
+}
+
+// The campaign loop's access pattern: one random gadget address per attempt.
+static void bench_gadget_list_sample(void *ctx, uint64_t batch) {
+    gadget_ctx_t *g = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        g->sink += g->list->addresses[rng_bounded(&g->rng, g->list->count)];
+    }
+}
+
+static void bench_gadget_alias_sample(void *ctx, uint64_t batch) {
+    gadget_ctx_t *g = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        g->sink += g->list->addresses[alias_table_sample(&g->alias, &g->rng)];
+    }
+}
+
+static gadget_list_t* build_sample_list(gadget_ctx_t *g) {
+    gadget_list_t *list = gadget_list_create();
+    if (!list) return NULL;
+
+    for (uint32_t i = 0; i < BENCH_SAMPLE_GADGETS; i++) {
+        size_t offset = rng_bounded(&g->rng, (uint32_t)(g->size - MAX_GADGET_LENGTH));
+        double score = 0.05 + 0.95 * rng_uniform(&g->rng);
+        if (!gadget_list_append(list, 0x400000 + offset, GADGET_LOAD_FAULTING, score, offset,
+                                &g->corpus[offset], 8)) {
+            break;
+        }
+    }
+    return list;
+}
+
+typedef struct {
+    sample_population_t *leak;
+    sample_population_t *no_leak;
+    bootstrap_config_t config;
+} bootstrap_ctx_t;
+
+static void bench_bootstrap_test(void *ctx, uint64_t batch) {
+    bootstrap_ctx_t *b = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        bootstrap_result_t result;
+        bootstrap_test(b->leak, b->no_leak, &b->config, &result);
+    }
+}
+
+static void fill_population(sample_population_t *pop, uint32_t count, uint64_t base,
+                            rng_t *rng) {
+    for (uint32_t i = 0; i < count; i++) {
+        population_add(pop, base + rng_bounded(rng, 120));
+    }
+}
+
+static void run_bootstrap_benches(void) {
+    static const uint32_t sizes[] = {1000, 10000, 100000};
+    static const uint32_t rounds[] = {1000, 10000};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+            for (int exact = 0; exact <= 1; exact++) {
+                // Exact resampling beyond ~1e7 draws per test takes seconds
+                // per sample; those sizes are covered by the histogram path.
+                if (exact && (uint64_t)sizes[s] * rounds[r] > 10000000ULL) continue;
+
+                rng_t rng;
+                rng_seed(&rng, BENCH_SEED, sizes[s]);
+
+                bootstrap_ctx_t b = {
+                    .leak = population_create(sizes[s]),
+                    .no_leak = population_create(sizes[s]),
+                    .config = {
+                        .bootstrap_rounds = rounds[r],
+                        .alpha = DEFAULT_ALPHA,
+                        .negligible_threshold_cycles = DEFAULT_NEGLIGIBLE_THRESHOLD,
+                        .num_threads = 0,
+                        .seed = BENCH_SEED,
+                        .histogram_max_range = exact ? 0 : BOOTSTRAP_HISTOGRAM_MAX_RANGE,
+                        .quiet = true
+                    }
+                };
+                if (!b.leak || !b.no_leak) {
+                    population_destroy(b.leak);
+                    population_destroy(b.no_leak);
+                    continue;
+                }
+
+                fill_population(b.leak, sizes[s], 260, &rng);
+                fill_population(b.no_leak, sizes[s], 200, &rng);
+
+                char name[96];
+                snprintf(name, sizeof(name), "bootstrap_test/%s/n=%u/rounds=%u",
+                         exact ? "exact" : "histogram", sizes[s], rounds[r]);
+
+                uint32_t saved = g_samples;
+                if (g_samples > 11) g_samples = 11;
+                bench_run(name, bench_bootstrap_test, &b, 1);
+                g_samples = saved;
+
+                population_destroy(b.leak);
+                population_destroy(b.no_leak);
+            }
+        }
+    }
+}
+
+typedef struct {
+    db_handle_t *db;
+    experiment_t exp;
+} db_ctx_t;
+
+static void bench_db_experiment_log(void *ctx, uint64_t batch) {
+    db_ctx_t *d = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        d->exp.experiment_id++;
+        d->exp.gadget_addr = 0x401000 + ((d->exp.experiment_id * 2654435761u) & 0xfffff);
+        db_experiment_log(d->db, &d->exp);
+    }
+}
+
+typedef struct {
+    virtqueue_t *vq;
+    uint16_t desc_idx;
+    volatile uint64_t *target;
+    volatile uint64_t *probe;
+    iotlb_profile_t profile;
+    timing_calibration_t cal;
+    uint64_t sink;
+} race_ctx_t;
+
+static void bench_race_execute_lvi_attempt(void *ctx, uint64_t batch) {
+    race_ctx_t *r = ctx;
+    for (uint64_t i = 0; i < batch; i++) {
+        race_attempt_t attempt = {0};
+        r->sink += race_execute_lvi_attempt(r->vq, r->desc_idx, (uint64_t)r->target,
+                                            (uint64_t)r->probe, &r->profile, &r->cal,
+                                            &attempt);
+    }
+}
+
+static bool bench_selected(const char *filter, const char *name) {
+    return !filter || strstr(name, filter) != NULL;
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                g_samples = atoi(optarg);
+                if (g_samples < 3) g_samples = 3;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n samples] [-f name-filter]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("{\n  \"compiler\": \"%s\",\n  \"timestamp\": %ld,\n  \"benchmarks\": [",
+           __VERSION__, (long)time(NULL));
+
+    if (bench_selected(filter, "cache")) {
+        cache_ctx_t c = {
+            .line = aligned_alloc(CACHE_LINE_SIZE, CACHE_LINE_SIZE),
+            .threshold = 150,
+            .sink = 0
+        };
+        if (c.line) {
+            *c.line = 0;
+            bench_run("cache_probe_time", bench_cache_probe_time, &c, 10000);
+            bench_run("cache_flush_reload", bench_cache_flush_reload, &c, 10000);
+            free((void*)c.line);
+        }
+    }
+
+    if (bench_selected(filter, "gadget")) {
+        gadget_ctx_t g = {
+            .corpus = malloc(BENCH_CORPUS_SIZE),
+            .size = BENCH_CORPUS_SIZE,
+            .sink = 0
+        };
+        if (g.corpus) {
+            build_corpus(&g);
+            bench_run("gadget_is_lvi_susceptible", bench_gadget_is_lvi_susceptible, &g, 100000);
+            bench_run("gadget_scan_memory_region/1MiB", bench_gadget_scan_memory_region, &g, 1);
+
+            rng_seed(&g.rng, BENCH_SEED, 1);
+            g.list = build_sample_list(&g);
+            if (g.list && g.list->count > 0) {
+                bench_run("gadget_list_sample/256K", bench_gadget_list_sample, &g, 100000);
+                if (alias_table_build(&g.alias, g.list->scores, g.list->count)) {
+                    bench_run("gadget_alias_sample/256K", bench_gadget_alias_sample, &g, 100000);
+                    alias_table_destroy(&g.alias);
+                }
+            }
+            gadget_list_destroy(g.list);
+            free(g.corpus);
+        }
+    }
+
+    if (bench_selected(filter, "bootstrap")) {
+        run_bootstrap_benches();
+    }
+
+    if (bench_selected(filter, "db")) {
+        char path[] = "/tmp/lvi-dma-bench-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            close(fd);
+            static const char *db_modes[] = {
+                "db_experiment_log", "db_experiment_log/sync", "db_experiment_log/columnar",
+                "db_experiment_log/sqlite"
+            };
+            static const db_format_t db_formats[] = {
+                DB_FORMAT_CSV, DB_FORMAT_CSV, DB_FORMAT_COLUMNAR, DB_FORMAT_SQLITE
+            };
+            for (int mode = 0; mode < 4; mode++) {
+                db_options_t opts;
+                db_default_options(&opts);
+                opts.synchronous = (mode == 1);
+                opts.format = db_formats[mode];
+                // a stale file would skew the mode's numbers, so skip it
+                if (truncate(path, 0) != 0) {
+                    fprintf(stderr, "%s: cannot reset %s: %s\n", db_modes[mode], path, strerror(errno));
+                    continue;
+                }
+
+                quiet_begin();
+                db_handle_t *db = db_open_opts(path, &opts);
+                quiet_end();
+                if (!db) continue;
+
+                db_ctx_t d = {
+                    .db = db,
+                    .exp = {
+                        .campaign_id = 1,
+                        .timestamp = time(NULL),
+                        .gadget_addr = 0x401000,
+                        .outcome = RACE_FAILED,
+                        .leak_latency = 220,
+                        .window_estimate = 1800
+                    }
+                };
+                bench_run(db_modes[mode], bench_db_experiment_log, &d, 10000);
+                quiet_begin();
+                db_close(db);
+                quiet_end();
+            }
+            unlink(path);
+
+            char sidecar[sizeof(path) + 8];
+            snprintf(sidecar, sizeof(sidecar), "%s-wal", path);
+            unlink(sidecar);
+            snprintf(sidecar, sizeof(sidecar), "%s-shm", path);
+            unlink(sidecar);
+        }
+    }
+
+    if (bench_selected(filter, "race")) {
+        race_ctx_t r = {
+            .vq = virtio_queue_create(VIRTIO_RING_SIZE),
+            .target = aligned_alloc(4096, 4096),
+            .probe = aligned_alloc(4096, 4096),
+            .profile = {
+                .iotlb_inv_mean = 2000,
+                .iotlb_inv_min = 1000,
+                .iotlb_inv_max = 4000,
+                .iotlb_inv_stddev = 300,
+                .sample_count = 1000
+            },
+            .cal = {
+                .overhead = 30,
+                .cache_hit_threshold = 120,
+                .cache_miss_threshold = 200
+            },
+            .sink = 0
+        };
+        if (r.vq && r.target && r.probe) {
+            memset((void*)r.target, 0xAA, 4096);
+            memset((void*)r.probe, 0x00, 4096);
+
+            quiet_begin();
+            bool prepared = virtio_descriptor_prepare_race(r.vq, (uint64_t)r.target,
+                                                           (uint64_t)r.probe, &r.desc_idx);
+            quiet_end();
+
+            if (prepared) {
+                bench_run("race_execute_lvi_attempt", bench_race_execute_lvi_attempt, &r, 1000);
+            }
+        }
+        virtio_queue_destroy(r.vq);
+        free((void*)r.target);
+        free((void*)r.probe);
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
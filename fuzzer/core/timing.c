@@ -1,4 +1,5 @@
 #include "timing.h"
+#include "summary.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -6,16 +7,16 @@
 
 void timing_calibrate(timing_calibration_t *cal) {
     uint64_t measurements[CALIBRATION_ROUNDS];
-    uint64_t sum = 0;
+    summary_t summary;
 
     printf("[*] Calibrating timing overhead...\n");
 
     for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
         measurements[i] = timing_measure();
-        sum += measurements[i];
     }
 
-    cal->overhead = sum / CALIBRATION_ROUNDS;
+    summary_u64(measurements, CALIBRATION_ROUNDS, UINT64_MAX, &summary);
+    cal->overhead = (uint64_t)summary.mean;
 
     printf("[+] Timing overhead: %lu cycles\n", cal->overhead);
 
@@ -28,7 +29,7 @@ void timing_calibrate(timing_calibration_t *cal) {
         volatile uint64_t dummy = *cache_test;
         (void)dummy;
         uint64_t end = timing_end();
-        hit_measurements[i] = end - start - cal->overhead;
+        hit_measurements[i] = (end - start > cal->overhead) ? end - start - cal->overhead : 0;
     }
 
     for (int i = 0; i < 1000; i++) {
@@ -38,17 +39,14 @@ void timing_calibrate(timing_calibration_t *cal) {
         volatile uint64_t dummy = *cache_test;
         (void)dummy;
         uint64_t end = timing_end();
-        miss_measurements[i] = end - start - cal->overhead;
+        miss_measurements[i] = (end - start > cal->overhead) ? end - start - cal->overhead : 0;
     }
 
-    uint64_t hit_sum = 0, miss_sum = 0;
-    for (int i = 0; i < 1000; i++) {
-        hit_sum += hit_measurements[i];
-        miss_sum += miss_measurements[i];
-    }
+    summary_u64(hit_measurements, 1000, UINT64_MAX, &summary);
+    cal->cache_hit_threshold = (uint64_t)summary.mean + 20;
 
-    cal->cache_hit_threshold = (hit_sum / 1000) + 20;
-    cal->cache_miss_threshold = (miss_sum / 1000) - 20;
+    summary_u64(miss_measurements, 1000, UINT64_MAX, &summary);
+    cal->cache_miss_threshold = (uint64_t)summary.mean - 20;
 
     printf("[+] Cache hit threshold: %lu cycles\n", cal->cache_hit_threshold);
     printf("[+] Cache miss threshold: %lu cycles\n", cal->cache_miss_threshold);
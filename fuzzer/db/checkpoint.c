@@ -0,0 +1,322 @@
+#define _DEFAULT_SOURCE
+#include "checkpoint.h"
+#include "hash.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// File layout: this header, then the fields in checkpoint_t order. Arrays
+// and populations are written inline; sketches keep only non-empty buckets.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t body_size;
+    uint64_t checksum;          // hash_bytes over the body
+} checkpoint_header_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    bool ok;
+} ckpt_writer_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} ckpt_reader_t;
+
+static void put(ckpt_writer_t *w, const void *src, size_t size) {
+    if (!w->ok) return;
+    if (w->length + size > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity : 4096;
+        while (capacity < w->length + size) capacity *= 2;
+        uint8_t *grown = realloc(w->data, capacity);
+        if (!grown) {
+            w->ok = false;
+            return;
+        }
+        w->data = grown;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->length, src, size);
+    w->length += size;
+}
+
+static void put_u8(ckpt_writer_t *w, uint8_t v)   { put(w, &v, sizeof(v)); }
+static void put_u32(ckpt_writer_t *w, uint32_t v) { put(w, &v, sizeof(v)); }
+static void put_u64(ckpt_writer_t *w, uint64_t v) { put(w, &v, sizeof(v)); }
+static void put_f64(ckpt_writer_t *w, double v)   { put(w, &v, sizeof(v)); }
+
+static bool get(ckpt_reader_t *r, void *dst, size_t size) {
+    if ((size_t)(r->end - r->p) < size) return false;
+    memcpy(dst, r->p, size);
+    r->p += size;
+    return true;
+}
+
+static bool get_bool(ckpt_reader_t *r, bool *v) {
+    uint8_t b;
+    if (!get(r, &b, sizeof(b))) return false;
+    *v = b != 0;
+    return true;
+}
+
+static void put_population(ckpt_writer_t *w, const sample_population_t *pop) {
+    put_u32(w, pop->capacity);
+    put_u32(w, pop->count);
+    put_u64(w, pop->total_seen);
+    put(w, pop->reservoir_rng.s, sizeof(pop->reservoir_rng.s));
+    put(w, pop->data, (size_t)pop->count * sizeof(uint64_t));
+
+    put_u8(w, pop->sketch != NULL);
+    if (!pop->sketch) return;
+
+    const quantile_sketch_t *s = pop->sketch;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < SKETCH_BUCKETS; i++) used += s->counts[i] != 0;
+    put_u64(w, s->total);
+    put_u64(w, s->min);
+    put_u64(w, s->max);
+    put_u32(w, used);
+    for (uint32_t i = 0; i < SKETCH_BUCKETS; i++) {
+        if (s->counts[i] == 0) continue;
+        put_u32(w, i);
+        put_u64(w, s->counts[i]);
+    }
+}
+
+static sample_population_t* get_population(ckpt_reader_t *r) {
+    uint32_t capacity, count;
+    uint64_t total_seen;
+    rng_t rng;
+    if (!get(r, &capacity, sizeof(capacity)) || !get(r, &count, sizeof(count)) ||
+        !get(r, &total_seen, sizeof(total_seen)) || !get(r, rng.s, sizeof(rng.s)) ||
+        count > capacity || capacity > MAX_SAMPLES ||
+        (size_t)(r->end - r->p) < (size_t)count * sizeof(uint64_t)) {
+        return NULL;
+    }
+    const uint8_t *data = r->p;
+    r->p += (size_t)count * sizeof(uint64_t);
+
+    bool has_sketch;
+    if (!get_bool(r, &has_sketch)) return NULL;
+
+    sample_population_t *pop = has_sketch ? population_create_sketch(capacity, 0)
+                                          : population_create(capacity);
+    if (!pop || pop->capacity < count) {
+        population_destroy(pop);
+        return NULL;
+    }
+    memcpy(pop->data, data, (size_t)count * sizeof(uint64_t));
+    pop->count = count;
+    pop->total_seen = total_seen;
+    pop->reservoir_rng = rng;
+    if (!has_sketch) return pop;
+
+    quantile_sketch_t *s = pop->sketch;
+    uint32_t used;
+    bool ok = get(r, &s->total, sizeof(s->total)) && get(r, &s->min, sizeof(s->min)) &&
+              get(r, &s->max, sizeof(s->max)) && get(r, &used, sizeof(used)) &&
+              used <= SKETCH_BUCKETS;
+    for (uint32_t i = 0; i < used && ok; i++) {
+        uint32_t bucket;
+        ok = get(r, &bucket, sizeof(bucket)) && bucket < SKETCH_BUCKETS &&
+             get(r, &s->counts[bucket], sizeof(s->counts[bucket]));
+    }
+    if (!ok) {
+        population_destroy(pop);
+        return NULL;
+    }
+    return pop;
+}
+
+void checkpoint_path(const char *log_path, char *path, size_t size) {
+    size_t length = strlen(log_path);
+    while (length > 1 && log_path[length - 1] == '/') length--;
+    snprintf(path, size, "%.*s.ckpt", (int)length, log_path);
+}
+
+bool checkpoint_write(const char *path, const checkpoint_t *ckpt) {
+    ckpt_writer_t w = { .ok = true };
+
+    put_u64(&w, ckpt->seed);
+    put_u32(&w, ckpt->num_campaigns);
+    put_u32(&w, ckpt->iterations_per_campaign);
+    put_u32(&w, ckpt->sequential_looks);
+    put_u32(&w, ckpt->adapt_interval);
+    put_u8(&w, ckpt->uniform_gadgets);
+    put_u64(&w, ckpt->gadget_hash);
+    put_u32(&w, ckpt->campaigns_done);
+    put_u8(&w, ckpt->found_exploitable);
+    put_u8(&w, ckpt->in_campaign);
+
+    if (ckpt->in_campaign) {
+        const campaign_t *c = &ckpt->campaign;
+        put_u64(&w, c->campaign_id);
+        put(&w, c->name, sizeof(c->name));
+        put_u64(&w, (uint64_t)c->start_time);
+        put_u64(&w, (uint64_t)c->end_time);
+        put_u32(&w, c->total_attempts);
+        put_u32(&w, c->successful_leaks);
+        put_f64(&w, c->success_rate);
+
+        put_u32(&w, ckpt->iteration);
+        put_u32(&w, ckpt->next_look);
+        put_u32(&w, ckpt->seq.looks_done);
+        put_f64(&w, ckpt->seq.alpha_spent);
+        put_f64(&w, ckpt->seq.last_nominal_alpha);
+
+        put(&w, ckpt->sampler_rng.s, sizeof(ckpt->sampler_rng.s));
+        put_u32(&w, ckpt->since_rebuild);
+        put_u32(&w, ckpt->gadget_count);
+        put(&w, ckpt->weights, (size_t)ckpt->gadget_count * sizeof(double));
+        put_u8(&w, ckpt->attempts != NULL);
+        if (ckpt->attempts) {
+            put(&w, ckpt->attempts, (size_t)ckpt->gadget_count * sizeof(uint32_t));
+            put(&w, ckpt->leaks, (size_t)ckpt->gadget_count * sizeof(uint32_t));
+        }
+        put_population(&w, ckpt->leak);
+        put_population(&w, ckpt->no_leak);
+    }
+
+    if (!w.ok) {
+        free(w.data);
+        return false;
+    }
+
+    checkpoint_header_t header = {
+        .version = CHECKPOINT_VERSION,
+        .body_size = w.length,
+        .checksum = hash_bytes(w.data, w.length, CHECKPOINT_VERSION)
+    };
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+    char tmp[1024];
+    int len = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    bool ok = len > 0 && (size_t)len < sizeof(tmp);
+
+    FILE *fp = ok ? fopen(tmp, "wb") : NULL;
+    ok = fp != NULL;
+    ok = ok && fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+         fwrite(w.data, 1, w.length, fp) == w.length &&
+         fflush(fp) == 0 && fdatasync(fileno(fp)) == 0;
+    if (fp) ok &= fclose(fp) == 0;
+    free(w.data);
+
+    // The previous checkpoint stays intact until the new one is complete.
+    if (!ok || rename(tmp, path) != 0) {
+        if (fp) unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+static bool read_body(ckpt_reader_t *r, checkpoint_t *ckpt) {
+    if (!get(r, &ckpt->seed, sizeof(ckpt->seed)) ||
+        !get(r, &ckpt->num_campaigns, sizeof(ckpt->num_campaigns)) ||
+        !get(r, &ckpt->iterations_per_campaign, sizeof(ckpt->iterations_per_campaign)) ||
+        !get(r, &ckpt->sequential_looks, sizeof(ckpt->sequential_looks)) ||
+        !get(r, &ckpt->adapt_interval, sizeof(ckpt->adapt_interval)) ||
+        !get_bool(r, &ckpt->uniform_gadgets) ||
+        !get(r, &ckpt->gadget_hash, sizeof(ckpt->gadget_hash)) ||
+        !get(r, &ckpt->campaigns_done, sizeof(ckpt->campaigns_done)) ||
+        !get_bool(r, &ckpt->found_exploitable) ||
+        !get_bool(r, &ckpt->in_campaign)) {
+        return false;
+    }
+    if (!ckpt->in_campaign) return true;
+
+    campaign_t *c = &ckpt->campaign;
+    uint64_t start_time, end_time;
+    if (!get(r, &c->campaign_id, sizeof(c->campaign_id)) ||
+        !get(r, c->name, sizeof(c->name)) ||
+        !get(r, &start_time, sizeof(start_time)) ||
+        !get(r, &end_time, sizeof(end_time)) ||
+        !get(r, &c->total_attempts, sizeof(c->total_attempts)) ||
+        !get(r, &c->successful_leaks, sizeof(c->successful_leaks)) ||
+        !get(r, &c->success_rate, sizeof(c->success_rate)) ||
+        !get(r, &ckpt->iteration, sizeof(ckpt->iteration)) ||
+        !get(r, &ckpt->next_look, sizeof(ckpt->next_look)) ||
+        !get(r, &ckpt->seq.looks_done, sizeof(ckpt->seq.looks_done)) ||
+        !get(r, &ckpt->seq.alpha_spent, sizeof(ckpt->seq.alpha_spent)) ||
+        !get(r, &ckpt->seq.last_nominal_alpha, sizeof(ckpt->seq.last_nominal_alpha)) ||
+        !get(r, ckpt->sampler_rng.s, sizeof(ckpt->sampler_rng.s)) ||
+        !get(r, &ckpt->since_rebuild, sizeof(ckpt->since_rebuild)) ||
+        !get(r, &ckpt->gadget_count, sizeof(ckpt->gadget_count))) {
+        return false;
+    }
+    c->name[sizeof(c->name) - 1] = '\0';
+    c->start_time = (time_t)start_time;
+    c->end_time = (time_t)end_time;
+
+    size_t n = ckpt->gadget_count ? ckpt->gadget_count : 1;
+    bool counted;
+    ckpt->weights = malloc(n * sizeof(double));
+    if (!ckpt->weights || !get(r, ckpt->weights, ckpt->gadget_count * sizeof(double)) ||
+        !get_bool(r, &counted)) {
+        return false;
+    }
+    if (counted) {
+        ckpt->attempts = malloc(n * sizeof(uint32_t));
+        ckpt->leaks = malloc(n * sizeof(uint32_t));
+        if (!ckpt->attempts || !ckpt->leaks ||
+            !get(r, ckpt->attempts, ckpt->gadget_count * sizeof(uint32_t)) ||
+            !get(r, ckpt->leaks, ckpt->gadget_count * sizeof(uint32_t))) {
+            return false;
+        }
+    }
+
+    ckpt->leak = get_population(r);
+    ckpt->no_leak = ckpt->leak ? get_population(r) : NULL;
+    return ckpt->no_leak != NULL;
+}
+
+bool checkpoint_read(const char *path, checkpoint_t *ckpt) {
+    memset(ckpt, 0, sizeof(*ckpt));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    checkpoint_header_t header;
+    uint8_t *body = NULL;
+    bool ok = fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CHECKPOINT_VERSION &&
+              header.body_size < (1ULL << 32);
+    if (ok) {
+        body = malloc(header.body_size ? header.body_size : 1);
+        ok = body && fread(body, 1, header.body_size, fp) == header.body_size &&
+             hash_bytes(body, header.body_size, CHECKPOINT_VERSION) == header.checksum;
+    }
+    fclose(fp);
+
+    if (ok) {
+        ckpt_reader_t r = { body, body + header.body_size };
+        ok = read_body(&r, ckpt) && r.p == r.end;
+    }
+    free(body);
+
+    if (!ok) {
+        fprintf(stderr, "[-] %s is not a valid checkpoint\n", path);
+        checkpoint_free(ckpt);
+    }
+    return ok;
+}
+
+void checkpoint_free(checkpoint_t *ckpt) {
+    free(ckpt->weights);
+    free(ckpt->attempts);
+    free(ckpt->leaks);
+    population_destroy(ckpt->leak);
+    population_destroy(ckpt->no_leak);
+    ckpt->weights = NULL;
+    ckpt->attempts = NULL;
+    ckpt->leaks = NULL;
+    ckpt->leak = NULL;
+    ckpt->no_leak = NULL;
+}
@@ -0,0 +1,357 @@
+#define _DEFAULT_SOURCE
+#include "columnar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint8_t column_widths[COLUMNAR_COLUMNS] = {
+    [COLUMN_TIMESTAMP]       = 8,
+    [COLUMN_CAMPAIGN_ID]     = 8,
+    [COLUMN_EXPERIMENT_ID]   = 8,
+    [COLUMN_GADGET_ADDR]     = 8,
+    [COLUMN_LEAK_LATENCY]    = 8,
+    [COLUMN_WINDOW_ESTIMATE] = 8,
+    [COLUMN_P_VALUE]         = 8,
+    [COLUMN_OUTCOME]         = 1,
+    [COLUMN_LEAK_DETECTED]   = 1,
+    [COLUMN_SIGNIFICANT]     = 1,
+};
+
+struct columnar_writer {
+    int fd;
+    uint64_t block_index;
+    uint32_t count;             // records in the current block
+    uint32_t flushed;           // of those, already written to the file
+    size_t block_bytes;
+    size_t column_offset[COLUMNAR_COLUMNS];
+    uint8_t *block;             // in-memory copy of the current block
+};
+
+static size_t column_offset(columnar_column_t column, uint32_t block_records) {
+    size_t offset = COLUMNAR_BLOCK_HEADER_SIZE;
+    for (columnar_column_t c = 0; c < column; c++) {
+        offset += (size_t)column_widths[c] * block_records;
+    }
+    return offset;
+}
+
+static size_t block_bytes(uint32_t block_records) {
+    return column_offset(COLUMNAR_COLUMNS, block_records);
+}
+
+static uint64_t block_file_offset(uint64_t index, size_t bytes) {
+    return COLUMNAR_HEADER_SIZE + index * bytes;
+}
+
+uint32_t columnar_column_width(columnar_column_t column) {
+    return column_widths[column];
+}
+
+size_t columnar_block_size(void) {
+    return block_bytes(COLUMNAR_BLOCK_RECORDS);
+}
+
+static bool header_valid(const columnar_header_t *header) {
+    return memcmp(header->magic, COLUMNAR_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == COLUMNAR_VERSION &&
+           header->header_size == COLUMNAR_HEADER_SIZE &&
+           header->block_records == COLUMNAR_BLOCK_RECORDS &&
+           header->column_count == COLUMNAR_COLUMNS &&
+           memcmp(header->column_widths, column_widths, COLUMNAR_COLUMNS) == 0;
+}
+
+static bool write_full(int fd, const void *buf, size_t size, uint64_t offset) {
+    const uint8_t *p = buf;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+// Blocks are allocated whole, so a reader never finds a column cut short.
+static bool writer_start_block(columnar_writer_t *w, uint64_t index) {
+    w->block_index = index;
+    w->count = 0;
+    w->flushed = 0;
+    memset(w->block, 0, w->block_bytes);
+    return ftruncate(w->fd, (off_t)block_file_offset(index + 1, w->block_bytes)) == 0;
+}
+
+columnar_writer_t* columnar_writer_open(const char *path) {
+    columnar_writer_t *w = calloc(1, sizeof(columnar_writer_t));
+    if (!w) return NULL;
+
+    w->block_bytes = block_bytes(COLUMNAR_BLOCK_RECORDS);
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        w->column_offset[c] = column_offset(c, COLUMNAR_BLOCK_RECORDS);
+    }
+    w->block = malloc(w->block_bytes);
+    w->fd = w->block ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644) : -1;
+    if (w->fd < 0) {
+        free(w->block);
+        free(w);
+        return NULL;
+    }
+
+    struct stat sb;
+    bool ok = fstat(w->fd, &sb) == 0;
+
+    if (ok && sb.st_size == 0) {
+        columnar_header_t header = {
+            .version = COLUMNAR_VERSION,
+            .header_size = COLUMNAR_HEADER_SIZE,
+            .block_records = COLUMNAR_BLOCK_RECORDS,
+            .column_count = COLUMNAR_COLUMNS,
+            .created = (int64_t)time(NULL)
+        };
+        memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+        memcpy(header.column_widths, column_widths, COLUMNAR_COLUMNS);
+
+        ok = write_full(w->fd, &header, sizeof(header), 0) && writer_start_block(w, 0);
+    } else if (ok) {
+        columnar_header_t header;
+        ok = pread(w->fd, &header, sizeof(header), 0) == sizeof(header) && header_valid(&header);
+        if (!ok) {
+            fprintf(stderr, "[-] %s is not a compatible experiment log\n", path);
+        }
+
+        uint64_t data = ok ? (uint64_t)sb.st_size - COLUMNAR_HEADER_SIZE : 0;
+        uint64_t blocks = (data + w->block_bytes - 1) / w->block_bytes;
+
+        if (ok && blocks == 0) {
+            ok = writer_start_block(w, 0);
+        } else if (ok) {
+            // Continue the last block unless it is already full.
+            uint64_t last = blocks - 1;
+            memset(w->block, 0, w->block_bytes);
+            ssize_t n = pread(w->fd, w->block, w->block_bytes,
+                              (off_t)block_file_offset(last, w->block_bytes));
+            const columnar_block_header_t *bh = (const columnar_block_header_t*)w->block;
+            ok = n >= (ssize_t)sizeof(*bh) && bh->count <= COLUMNAR_BLOCK_RECORDS;
+
+            if (ok && bh->count == COLUMNAR_BLOCK_RECORDS) {
+                ok = writer_start_block(w, blocks);
+            } else if (ok) {
+                w->block_index = last;
+                w->count = bh->count;
+                w->flushed = bh->count;
+                ok = ftruncate(w->fd, (off_t)block_file_offset(blocks, w->block_bytes)) == 0;
+            }
+        }
+    }
+
+    if (!ok) {
+        close(w->fd);
+        free(w->block);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void columnar_writer_close(columnar_writer_t *writer) {
+    if (!writer) return;
+    columnar_writer_flush(writer, true);
+    close(writer->fd);
+    free(writer->block);
+    free(writer);
+}
+
+// Column slices go out before the block count, so a crash mid-flush leaves
+// the previous count pointing at complete records.
+static bool writer_write_pending(columnar_writer_t *w) {
+    if (w->count == w->flushed) return true;
+
+    uint64_t base = block_file_offset(w->block_index, w->block_bytes);
+    bool ok = true;
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        size_t width = column_widths[c];
+        size_t offset = w->column_offset[c] + w->flushed * width;
+        ok &= write_full(w->fd, w->block + offset, (w->count - w->flushed) * width, base + offset);
+    }
+    if (!ok) return false;
+
+    columnar_block_header_t bh = { .count = w->count };
+    if (!write_full(w->fd, &bh, sizeof(bh), base)) return false;
+    w->flushed = w->count;
+    return true;
+}
+
+uint64_t columnar_writer_records(const columnar_writer_t *w) {
+    return w->block_index * COLUMNAR_BLOCK_RECORDS + w->count;
+}
+
+bool columnar_writer_append(columnar_writer_t *w, const experiment_t *records, uint32_t count) {
+    bool ok = true;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (w->count == COLUMNAR_BLOCK_RECORDS) {
+            ok &= writer_write_pending(w);
+            ok &= writer_start_block(w, w->block_index + 1);
+        }
+
+        const experiment_t *exp = &records[i];
+        uint32_t k = w->count++;
+        uint8_t *b = w->block;
+        int64_t timestamp = (int64_t)exp->timestamp;
+
+        ((int64_t*)(b + w->column_offset[COLUMN_TIMESTAMP]))[k] = timestamp;
+        ((uint64_t*)(b + w->column_offset[COLUMN_CAMPAIGN_ID]))[k] = exp->campaign_id;
+        ((uint64_t*)(b + w->column_offset[COLUMN_EXPERIMENT_ID]))[k] = exp->experiment_id;
+        ((uint64_t*)(b + w->column_offset[COLUMN_GADGET_ADDR]))[k] = exp->gadget_addr;
+        ((uint64_t*)(b + w->column_offset[COLUMN_LEAK_LATENCY]))[k] = exp->leak_latency;
+        ((uint64_t*)(b + w->column_offset[COLUMN_WINDOW_ESTIMATE]))[k] = exp->window_estimate;
+        ((double*)(b + w->column_offset[COLUMN_P_VALUE]))[k] = exp->p_value;
+        b[w->column_offset[COLUMN_OUTCOME] + k] = (uint8_t)exp->outcome;
+        b[w->column_offset[COLUMN_LEAK_DETECTED] + k] = exp->leak_detected;
+        b[w->column_offset[COLUMN_SIGNIFICANT] + k] = exp->statistically_significant;
+    }
+
+    return ok;
+}
+
+bool columnar_writer_flush(columnar_writer_t *w, bool durable) {
+    bool ok = writer_write_pending(w);
+    if (durable) ok &= fdatasync(w->fd) == 0;
+    return ok;
+}
+
+bool columnar_map(const char *path, columnar_view_t *view) {
+    memset(view, 0, sizeof(*view));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (uint64_t)sb.st_size < COLUMNAR_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    view->data = data;
+    view->size = sb.st_size;
+    view->header = data;
+    if (!header_valid(view->header)) {
+        columnar_unmap(view);
+        return false;
+    }
+
+    view->block_bytes = block_bytes(view->header->block_records);
+    view->block_count = (view->size - COLUMNAR_HEADER_SIZE) / view->block_bytes;
+    madvise(data, view->size, MADV_SEQUENTIAL);
+
+    for (uint64_t i = 0; i < view->block_count; i++) {
+        const columnar_block_header_t *bh = (const columnar_block_header_t*)
+            (view->data + block_file_offset(i, view->block_bytes));
+        if (bh->count > view->header->block_records) {
+            columnar_unmap(view);
+            return false;
+        }
+        view->records += bh->count;
+    }
+
+    return true;
+}
+
+void columnar_unmap(columnar_view_t *view) {
+    if (view->data) munmap((void*)view->data, view->size);
+    memset(view, 0, sizeof(*view));
+}
+
+void columnar_block_from_columns(columnar_block_t *block, uint32_t count,
+                                 const uint8_t *columns[COLUMNAR_COLUMNS]) {
+    block->count = count;
+    block->timestamp = (const int64_t*)columns[COLUMN_TIMESTAMP];
+    block->campaign_id = (const uint64_t*)columns[COLUMN_CAMPAIGN_ID];
+    block->experiment_id = (const uint64_t*)columns[COLUMN_EXPERIMENT_ID];
+    block->gadget_addr = (const uint64_t*)columns[COLUMN_GADGET_ADDR];
+    block->leak_latency = (const uint64_t*)columns[COLUMN_LEAK_LATENCY];
+    block->window_estimate = (const uint64_t*)columns[COLUMN_WINDOW_ESTIMATE];
+    block->p_value = (const double*)columns[COLUMN_P_VALUE];
+    block->outcome = columns[COLUMN_OUTCOME];
+    block->leak_detected = columns[COLUMN_LEAK_DETECTED];
+    block->significant = columns[COLUMN_SIGNIFICANT];
+}
+
+void columnar_block(const columnar_view_t *view, uint64_t index, columnar_block_t *block) {
+    const uint8_t *b = view->data + block_file_offset(index, view->block_bytes);
+    uint32_t records = view->header->block_records;
+
+    const uint8_t *columns[COLUMNAR_COLUMNS];
+    for (columnar_column_t c = 0; c < COLUMNAR_COLUMNS; c++) {
+        columns[c] = b + column_offset(c, records);
+    }
+    columnar_block_from_columns(block, ((const columnar_block_header_t*)b)->count, columns);
+}
+
+void columnar_record(const columnar_block_t *block, uint32_t i, experiment_t *exp) {
+    exp->timestamp = (time_t)block->timestamp[i];
+    exp->campaign_id = block->campaign_id[i];
+    exp->experiment_id = block->experiment_id[i];
+    exp->gadget_addr = block->gadget_addr[i];
+    exp->outcome = (race_outcome_t)block->outcome[i];
+    exp->leak_detected = block->leak_detected[i];
+    exp->leak_latency = block->leak_latency[i];
+    exp->window_estimate = block->window_estimate[i];
+    exp->p_value = block->p_value[i];
+    exp->statistically_significant = block->significant[i];
+}
+
+uint32_t columnar_block_tail(const columnar_block_t *block, uint64_t campaign_id,
+                             uint64_t experiment_id) {
+    uint32_t i = block->count;
+    while (i > 0 && block->campaign_id[i - 1] == campaign_id &&
+           block->experiment_id[i - 1] > experiment_id) {
+        i--;
+    }
+    return block->count - i;
+}
+
+bool columnar_rewind(const char *path, uint64_t campaign_id, uint64_t experiment_id,
+                     uint64_t *kept, uint64_t *dropped) {
+    columnar_view_t view;
+    if (!columnar_map(path, &view)) return false;
+
+    *dropped = 0;
+    for (uint64_t b = view.block_count; b-- > 0; ) {
+        columnar_block_t block;
+        columnar_block(&view, b, &block);
+        uint32_t tail = columnar_block_tail(&block, campaign_id, experiment_id);
+        *dropped += tail;
+        if (tail < block.count) break;
+    }
+    *kept = view.records - *dropped;
+    size_t bytes = view.block_bytes;
+    columnar_unmap(&view);
+    if (*dropped == 0) return true;
+
+    // Only the last block may be partial, so the kept records are a prefix
+    // of whole blocks plus a count in the block after them.
+    uint64_t full = *kept / COLUMNAR_BLOCK_RECORDS;
+    columnar_block_header_t bh = { .count = (uint32_t)(*kept % COLUMNAR_BLOCK_RECORDS) };
+    uint64_t blocks = full + (bh.count > 0);
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = (bh.count == 0 || write_full(fd, &bh, sizeof(bh), block_file_offset(full, bytes))) &&
+              ftruncate(fd, (off_t)block_file_offset(blocks, bytes)) == 0 &&
+              fdatasync(fd) == 0;
+    ok &= close(fd) == 0;
+    return ok;
+}
@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include "log_ring.h"
+#include "affinity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#define LOG_RING_IDLE_NS 200000     // writer poll interval when the ring is empty
+#define LOG_RING_WAIT_NS 50000      // producer/flush wait step
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ns(long ns) {
+    struct timespec ts = { 0, ns };
+    nanosleep(&ts, NULL);
+}
+
+void log_ring_default_config(log_ring_config_t *config) {
+    config->capacity = LOG_RING_DEFAULT_CAPACITY;
+    config->batch_size = LOG_RING_DEFAULT_BATCH;
+    config->flush_interval_ms = LOG_RING_DEFAULT_FLUSH_MS;
+    config->writer_cpu = -1;
+    config->drop_when_full = false;
+}
+
+static void writer_flush(log_ring_t *ring, bool durable) {
+    if (!ring->flush(ring->sink, durable)) {
+        __atomic_fetch_add(&ring->write_errors, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&ring->flushes, 1, __ATOMIC_RELAXED);
+}
+
+static void* log_ring_writer(void *arg) {
+    log_ring_t *ring = arg;
+    uint64_t tail = ring->tail;
+    uint64_t last_flush = monotonic_ms();
+    bool dirty = false;
+
+    if (ring->config.writer_cpu >= 0) {
+        affinity_pin_thread(ring->config.writer_cpu);
+    }
+
+    while (true) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        if (head != tail) {
+            uint64_t available = head - tail;
+            uint64_t start = tail & ring->mask;
+            uint64_t run = ring->mask + 1 - start;     // contiguous up to the wrap
+            uint32_t n = (uint32_t)(available < run ? available : run);
+            if (n > ring->config.batch_size) n = ring->config.batch_size;
+
+            if (!ring->write(ring->sink, &ring->slots[start], n)) {
+                __atomic_fetch_add(&ring->write_errors, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_fetch_add(&ring->batches, 1, __ATOMIC_RELAXED);
+            tail += n;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            dirty = true;
+        }
+
+        uint64_t target = __atomic_load_n(&ring->flush_target, __ATOMIC_ACQUIRE);
+        uint64_t now = monotonic_ms();
+        if (target > ring->flush_done &&
+            tail >= __atomic_load_n(&ring->flush_head, __ATOMIC_ACQUIRE)) {
+            writer_flush(ring, __atomic_load_n(&ring->flush_durable, __ATOMIC_ACQUIRE));
+            __atomic_store_n(&ring->flush_done, target, __ATOMIC_RELEASE);
+            last_flush = now;
+            dirty = false;
+        } else if (dirty && now - last_flush >= ring->config.flush_interval_ms) {
+            writer_flush(ring, false);
+            last_flush = now;
+            dirty = false;
+        }
+
+        if (head == tail) {
+            if (__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE) &&
+                __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+                break;
+            }
+            sleep_ns(LOG_RING_IDLE_NS);
+        }
+    }
+
+    writer_flush(ring, true);
+    return NULL;
+}
+
+log_ring_t* log_ring_create(const log_ring_config_t *config, log_sink_write_fn write,
+                            log_sink_flush_fn flush, void *sink) {
+    log_ring_t *ring = aligned_alloc(LOG_RING_CACHE_LINE, sizeof(log_ring_t));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(*ring));
+
+    ring->config = *config;
+    if (ring->config.batch_size == 0) ring->config.batch_size = LOG_RING_DEFAULT_BATCH;
+
+    uint64_t capacity = 2;
+    while (capacity < config->capacity) capacity <<= 1;
+    ring->mask = capacity - 1;
+    ring->write = write;
+    ring->flush = flush;
+    ring->sink = sink;
+
+    ring->slots = calloc(capacity, sizeof(experiment_t));
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+
+    if (pthread_create(&ring->writer, NULL, log_ring_writer, ring) != 0) {
+        free(ring->slots);
+        free(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void log_ring_destroy(log_ring_t *ring, log_ring_stats_t *stats) {
+    if (!ring) return;
+
+    __atomic_store_n(&ring->stop, true, __ATOMIC_RELEASE);
+    pthread_join(ring->writer, NULL);
+    if (stats) log_ring_get_stats(ring, stats);
+
+    free(ring->slots);
+    free(ring);
+}
+
+bool log_ring_push(log_ring_t *ring, const experiment_t *record) {
+    uint64_t head = ring->head;
+
+    if (head - ring->cached_tail > ring->mask) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        if (head - ring->cached_tail > ring->mask) {
+            if (ring->config.drop_when_full) {
+                __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+                return false;
+            }
+
+            __atomic_store_n(&ring->full_waits, ring->full_waits + 1, __ATOMIC_RELAXED);
+            while (head - ring->cached_tail > ring->mask) {
+                sched_yield();
+                ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            }
+        }
+    }
+
+    ring->slots[head & ring->mask] = *record;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->logged, ring->logged + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool log_ring_flush(log_ring_t *ring, bool durable) {
+    uint64_t target = ring->flush_target + 1;
+
+    __atomic_store_n(&ring->flush_head, ring->head, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->flush_durable, durable, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->flush_target, target, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(&ring->flush_done, __ATOMIC_ACQUIRE) < target) {
+        sleep_ns(LOG_RING_WAIT_NS);
+    }
+
+    return __atomic_load_n(&ring->write_errors, __ATOMIC_RELAXED) == 0;
+}
+
+void log_ring_get_stats(log_ring_t *ring, log_ring_stats_t *stats) {
+    stats->logged = __atomic_load_n(&ring->logged, __ATOMIC_RELAXED);
+    stats->written = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    stats->full_waits = __atomic_load_n(&ring->full_waits, __ATOMIC_RELAXED);
+    stats->batches = __atomic_load_n(&ring->batches, __ATOMIC_RELAXED);
+    stats->flushes = __atomic_load_n(&ring->flushes, __ATOMIC_RELAXED);
+    stats->write_errors = __atomic_load_n(&ring->write_errors, __ATOMIC_RELAXED);
+}
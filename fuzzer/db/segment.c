@@ -0,0 +1,599 @@
+#define _DEFAULT_SOURCE
+#include "segment.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SEGMENT_HEADER_SIZE 16
+#define SEGMENT_MAX_VARINT 10
+
+// Monotonic columns shrink to a byte or two per record as deltas; latency
+// and window estimates are small but unordered, so they are varints only.
+static const uint8_t column_encoding[COLUMNAR_COLUMNS] = {
+    [COLUMN_TIMESTAMP]       = SEGMENT_DELTA_VARINT,
+    [COLUMN_CAMPAIGN_ID]     = SEGMENT_DELTA_VARINT,
+    [COLUMN_EXPERIMENT_ID]   = SEGMENT_DELTA_VARINT,
+    [COLUMN_GADGET_ADDR]     = SEGMENT_DELTA_VARINT,
+    [COLUMN_LEAK_LATENCY]    = SEGMENT_VARINT,
+    [COLUMN_WINDOW_ESTIMATE] = SEGMENT_VARINT,
+    [COLUMN_P_VALUE]         = SEGMENT_RAW,
+    [COLUMN_OUTCOME]         = SEGMENT_RAW,
+    [COLUMN_LEAK_DETECTED]   = SEGMENT_RAW,
+    [COLUMN_SIGNIFICANT]     = SEGMENT_RAW,
+};
+
+typedef struct {
+    uint32_t index;
+    bool sealed;
+} segment_entry_t;
+
+struct segment_log {
+    char dir[SEGMENT_MAX_PATH / 2];
+    uint64_t max_records;       // 0 = no size limit
+    uint32_t max_seconds;
+    uint32_t index;             // active segment number
+    int64_t opened;             // active segment creation time
+    columnar_writer_t *active;
+};
+
+static size_t put_varint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void segment_path(const char *dir, uint32_t index, bool sealed, char *path, size_t size) {
+    snprintf(path, size, "%s/segment-%06u.%s", dir, index, sealed ? "xseg" : "xlog");
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const segment_entry_t *x = a, *y = b;
+    if (x->index != y->index) return x->index < y->index ? -1 : 1;
+    return (int)x->sealed - (int)y->sealed;
+}
+
+// Segment files sorted by number; a number present both sealed and
+// unsealed (a seal interrupted before the unlink) lists the sealed one.
+static segment_entry_t* list_segments(const char *dir, uint32_t *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+
+    uint32_t capacity = 64;
+    segment_entry_t *entries = malloc(capacity * sizeof(segment_entry_t));
+    struct dirent *de;
+
+    while (entries && (de = readdir(d)) != NULL) {
+        uint32_t index;
+        char ext[8];
+        if (sscanf(de->d_name, "segment-%u.%7s", &index, ext) != 2) continue;
+        if (strcmp(ext, "xseg") != 0 && strcmp(ext, "xlog") != 0) continue;
+
+        if (*count == capacity) {
+            capacity *= 2;
+            segment_entry_t *grown = realloc(entries, capacity * sizeof(segment_entry_t));
+            if (!grown) break;
+            entries = grown;
+        }
+        entries[(*count)++] = (segment_entry_t){ index, ext[2] == 'e' };
+    }
+    closedir(d);
+    if (!entries) return NULL;
+
+    qsort(entries, *count, sizeof(segment_entry_t), compare_entries);
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < *count; i++) {
+        if (kept > 0 && entries[kept - 1].index == entries[i].index) {
+            entries[kept - 1].sealed = true;
+            continue;
+        }
+        entries[kept++] = entries[i];
+    }
+    *count = kept;
+    return entries;
+}
+
+static bool write_segment_file(const char *path, const uint8_t *const *columns,
+                               const segment_footer_t *footer) {
+    char tmp[SEGMENT_MAX_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return false;
+
+    uint8_t header[SEGMENT_HEADER_SIZE] = {0};
+    memcpy(header, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    uint32_t version = SEGMENT_VERSION;
+    memcpy(header + 8, &version, sizeof(version));
+
+    bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+    for (int c = 0; c < COLUMNAR_COLUMNS && ok; c++) {
+        ok = fwrite(columns[c], 1, footer->column_length[c], fp) == footer->column_length[c];
+    }
+    ok = ok && fwrite(footer, 1, sizeof(*footer), fp) == sizeof(*footer);
+    ok = ok && fflush(fp) == 0 && fdatasync(fileno(fp)) == 0;
+    ok &= fclose(fp) == 0;
+
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool segment_seal(const char *log_path, const char *segment_path) {
+    columnar_view_t view;
+    if (!columnar_map(log_path, &view)) return false;
+
+    segment_footer_t footer = {
+        .campaign_min = UINT64_MAX,
+        .time_min = INT64_MAX,
+        .time_max = INT64_MIN,
+        .records = view.records,
+        .version = SEGMENT_VERSION,
+        .footer_size = sizeof(segment_footer_t)
+    };
+    memcpy(footer.magic, SEGMENT_FOOTER_MAGIC, sizeof(footer.magic));
+
+    uint8_t *columns[COLUMNAR_COLUMNS] = {0};
+    bool ok = true;
+    for (int c = 0; c < COLUMNAR_COLUMNS && ok; c++) {
+        size_t worst = column_encoding[c] == SEGMENT_RAW ? columnar_column_width(c)
+                                                         : SEGMENT_MAX_VARINT;
+        columns[c] = malloc(worst * (view.records ? view.records : 1));
+        ok = columns[c] != NULL;
+    }
+
+    size_t length[COLUMNAR_COLUMNS] = {0};
+    uint64_t prev[COLUMNAR_COLUMNS] = {0};
+
+    for (uint64_t b = 0; b < view.block_count && ok; b++) {
+        columnar_block_t block;
+        columnar_block(&view, b, &block);
+
+        const uint64_t *wide[COLUMNAR_COLUMNS] = {
+            [COLUMN_TIMESTAMP]       = (const uint64_t*)block.timestamp,
+            [COLUMN_CAMPAIGN_ID]     = block.campaign_id,
+            [COLUMN_EXPERIMENT_ID]   = block.experiment_id,
+            [COLUMN_GADGET_ADDR]     = block.gadget_addr,
+            [COLUMN_LEAK_LATENCY]    = block.leak_latency,
+            [COLUMN_WINDOW_ESTIMATE] = block.window_estimate,
+            [COLUMN_P_VALUE]         = (const uint64_t*)block.p_value,
+        };
+        const uint8_t *narrow[COLUMNAR_COLUMNS] = {
+            [COLUMN_OUTCOME]       = block.outcome,
+            [COLUMN_LEAK_DETECTED] = block.leak_detected,
+            [COLUMN_SIGNIFICANT]   = block.significant,
+        };
+
+        for (uint32_t i = 0; i < block.count; i++) {
+            if (block.campaign_id[i] < footer.campaign_min) footer.campaign_min = block.campaign_id[i];
+            if (block.campaign_id[i] > footer.campaign_max) footer.campaign_max = block.campaign_id[i];
+            if (block.timestamp[i] < footer.time_min) footer.time_min = block.timestamp[i];
+            if (block.timestamp[i] > footer.time_max) footer.time_max = block.timestamp[i];
+        }
+
+        for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+            uint8_t *out = columns[c];
+            switch (column_encoding[c]) {
+                case SEGMENT_DELTA_VARINT:
+                    for (uint32_t i = 0; i < block.count; i++) {
+                        uint64_t v = wide[c][i];
+                        length[c] += put_varint(out + length[c], zigzag((int64_t)(v - prev[c])));
+                        prev[c] = v;
+                    }
+                    break;
+                case SEGMENT_VARINT:
+                    for (uint32_t i = 0; i < block.count; i++) {
+                        length[c] += put_varint(out + length[c], wide[c][i]);
+                    }
+                    break;
+                default: {
+                    size_t bytes = (size_t)block.count * columnar_column_width(c);
+                    memcpy(out + length[c], wide[c] ? (const void*)wide[c] : narrow[c], bytes);
+                    length[c] += bytes;
+                    break;
+                }
+            }
+        }
+    }
+    columnar_unmap(&view);
+
+    if (ok) {
+        uint64_t offset = SEGMENT_HEADER_SIZE;
+        for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+            footer.column_offset[c] = offset;
+            footer.column_length[c] = length[c];
+            footer.column_encoding[c] = column_encoding[c];
+            footer.checksum = hash_mix64(footer.checksum ^ hash_bytes(columns[c], length[c], c));
+            offset += length[c];
+        }
+        ok = write_segment_file(segment_path, (const uint8_t *const *)columns, &footer);
+    }
+
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) free(columns[c]);
+    return ok;
+}
+
+static bool read_footer(int fd, segment_footer_t *footer, uint64_t *file_size) {
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (uint64_t)sb.st_size < SEGMENT_HEADER_SIZE + sizeof(*footer)) {
+        return false;
+    }
+    *file_size = (uint64_t)sb.st_size;
+
+    if (pread(fd, footer, sizeof(*footer), sb.st_size - (off_t)sizeof(*footer)) !=
+        (ssize_t)sizeof(*footer)) {
+        return false;
+    }
+    if (memcmp(footer->magic, SEGMENT_FOOTER_MAGIC, sizeof(footer->magic)) != 0 ||
+        footer->version != SEGMENT_VERSION || footer->footer_size != sizeof(*footer)) {
+        return false;
+    }
+
+    uint64_t data_end = *file_size - sizeof(*footer);
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) {
+        if (footer->column_encoding[c] != column_encoding[c] ||
+            footer->column_offset[c] > data_end ||
+            footer->column_length[c] > data_end - footer->column_offset[c]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool decode_column(const uint8_t *in, uint64_t length, segment_encoding_t encoding,
+                          uint32_t width, uint64_t records, uint8_t *out) {
+    if (encoding == SEGMENT_RAW) {
+        if (length != records * width) return false;
+        memcpy(out, in, length);
+        return true;
+    }
+
+    const uint8_t *p = in, *end = in + length;
+    uint64_t *values = (uint64_t*)out;
+    uint64_t prev = 0;
+    for (uint64_t i = 0; i < records; i++) {
+        uint64_t v;
+        if (!get_varint(&p, end, &v)) return false;
+        if (encoding == SEGMENT_DELTA_VARINT) {
+            v = prev + (uint64_t)unzigzag(v);
+            prev = v;
+        }
+        values[i] = v;
+    }
+    return p == end;
+}
+
+static bool scan_sealed(const char *path, const db_query_t *query, segment_block_fn fn,
+                        void *ctx, segment_scan_stats_t *stats) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    segment_footer_t footer;
+    uint64_t file_size;
+    if (!read_footer(fd, &footer, &file_size)) {
+        close(fd);
+        fprintf(stderr, "[-] Damaged segment %s\n", path);
+        return false;
+    }
+
+    // The footer is the index: skip segments outside the query unread.
+    if (footer.records == 0 || footer.records > UINT32_MAX ||
+        footer.campaign_max < query->campaign_min || footer.campaign_min > query->campaign_max ||
+        footer.time_max < query->time_min || footer.time_min > query->time_max) {
+        close(fd);
+        return true;
+    }
+
+    uint64_t data_size = file_size - sizeof(footer);
+    uint8_t *data = malloc(data_size);
+    uint8_t *columns[COLUMNAR_COLUMNS] = {0};
+    bool ok = data && pread(fd, data, data_size, 0) == (ssize_t)data_size;
+    close(fd);
+
+    uint64_t checksum = 0;
+    for (int c = 0; c < COLUMNAR_COLUMNS && ok; c++) {
+        const uint8_t *in = data + footer.column_offset[c];
+        checksum = hash_mix64(checksum ^ hash_bytes(in, footer.column_length[c], c));
+        columns[c] = malloc(footer.records * columnar_column_width(c));
+        ok = columns[c] && decode_column(in, footer.column_length[c], footer.column_encoding[c],
+                                         columnar_column_width(c), footer.records, columns[c]);
+    }
+    ok = ok && checksum == footer.checksum;
+    free(data);
+
+    if (ok) {
+        columnar_block_t block;
+        columnar_block_from_columns(&block, (uint32_t)footer.records,
+                                    (const uint8_t**)columns);
+        stats->segments_read++;
+        stats->records_read += footer.records;
+        ok = fn(ctx, &block);
+    } else {
+        fprintf(stderr, "[-] Damaged segment %s\n", path);
+    }
+
+    for (int c = 0; c < COLUMNAR_COLUMNS; c++) free(columns[c]);
+    return ok;
+}
+
+// The active segment has no footer yet; it is bounded by the rotation
+// limits, so reading it whole is cheap.
+static bool scan_active(const char *path, segment_block_fn fn, void *ctx,
+                        segment_scan_stats_t *stats) {
+    columnar_view_t view;
+    if (!columnar_map(path, &view)) return false;
+
+    bool ok = true;
+    if (view.records > 0) stats->segments_read++;
+    for (uint64_t b = 0; b < view.block_count && ok; b++) {
+        columnar_block_t block;
+        columnar_block(&view, b, &block);
+        if (block.count == 0) continue;
+        stats->records_read += block.count;
+        ok = fn(ctx, &block);
+    }
+
+    columnar_unmap(&view);
+    return ok;
+}
+
+uint32_t segment_log_count(const char *dir) {
+    uint32_t count;
+    free(list_segments(dir, &count));
+    return count;
+}
+
+bool segment_log_scan_range(const char *dir, uint32_t first, uint32_t count,
+                            const db_query_t *query, segment_block_fn fn, void *ctx,
+                            segment_scan_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    uint32_t total;
+    segment_entry_t *entries = list_segments(dir, &total);
+    if (!entries) return false;
+
+    uint32_t last = (first >= total) ? first : first + (count < total - first ? count : total - first);
+    stats->segments = last - first;
+
+    bool ok = true;
+    for (uint32_t i = first; i < last && ok; i++) {
+        char path[SEGMENT_MAX_PATH];
+        segment_path(dir, entries[i].index, entries[i].sealed, path, sizeof(path));
+        ok = entries[i].sealed ? scan_sealed(path, query, fn, ctx, stats)
+                               : scan_active(path, fn, ctx, stats);
+    }
+
+    free(entries);
+    return ok;
+}
+
+bool segment_log_scan(const char *dir, const db_query_t *query, segment_block_fn fn, void *ctx,
+                      segment_scan_stats_t *stats) {
+    return segment_log_scan_range(dir, 0, UINT32_MAX, query, fn, ctx, stats);
+}
+
+typedef struct {
+    uint64_t campaign_id;
+    uint64_t experiment_id;
+    const char *active_path;    // where a partly dropped segment is rewritten
+    uint64_t kept;
+    uint64_t dropped;
+} rewind_ctx_t;
+
+// A sealed segment that keeps only some of its records goes back to being
+// the active segment, so the resumed run appends to it.
+static bool rewind_sealed_block(void *ctx, const columnar_block_t *block) {
+    rewind_ctx_t *r = ctx;
+    r->dropped = columnar_block_tail(block, r->campaign_id, r->experiment_id);
+    r->kept = block->count - r->dropped;
+    if (r->dropped == 0 || r->kept == 0) return true;
+
+    columnar_writer_t *w = columnar_writer_open(r->active_path);
+    if (!w) return false;
+
+    experiment_t batch[256];
+    bool ok = true;
+    for (uint32_t i = 0; i < r->kept && ok; ) {
+        uint32_t n = 0;
+        while (n < 256 && i < r->kept) columnar_record(block, i++, &batch[n++]);
+        ok = columnar_writer_append(w, batch, n);
+    }
+    ok = ok && columnar_writer_flush(w, true);
+    columnar_writer_close(w);
+    if (!ok) unlink(r->active_path);
+    return ok;
+}
+
+bool segment_log_rewind(const char *dir, uint64_t campaign_id, uint64_t experiment_id,
+                        uint64_t *dropped) {
+    *dropped = 0;
+
+    uint32_t count;
+    segment_entry_t *entries = list_segments(dir, &count);
+    if (!entries) return false;
+
+    db_query_t all;
+    db_query_all(&all);
+
+    bool ok = true;
+    uint64_t kept = 0;
+    for (uint32_t i = count; i-- > 0 && ok && kept == 0; ) {
+        char path[SEGMENT_MAX_PATH], active[SEGMENT_MAX_PATH];
+        segment_path(dir, entries[i].index, entries[i].sealed, path, sizeof(path));
+        segment_path(dir, entries[i].index, false, active, sizeof(active));
+
+        uint64_t gone = 0;
+        if (entries[i].sealed) {
+            // An unsealed copy next to a sealed one is left over from an
+            // interrupted seal; the sealed copy is authoritative.
+            unlink(active);
+            rewind_ctx_t r = { campaign_id, experiment_id, active, 0, 0 };
+            segment_scan_stats_t stats = {0};
+            ok = scan_sealed(path, &all, rewind_sealed_block, &r, &stats);
+            kept = r.kept;
+            gone = r.dropped;
+        } else {
+            ok = columnar_rewind(path, campaign_id, experiment_id, &kept, &gone);
+        }
+
+        *dropped += gone;
+        if (ok && (kept == 0 || (entries[i].sealed && gone > 0))) ok = unlink(path) == 0;
+    }
+
+    free(entries);
+    return ok;
+}
+
+static bool seal_and_remove(const char *dir, uint32_t index) {
+    char log_path[SEGMENT_MAX_PATH], seg_path[SEGMENT_MAX_PATH];
+    segment_path(dir, index, false, log_path, sizeof(log_path));
+    segment_path(dir, index, true, seg_path, sizeof(seg_path));
+
+    columnar_view_t view;
+    bool empty = columnar_map(log_path, &view) && view.records == 0;
+    if (view.data) columnar_unmap(&view);
+
+    if (!empty && !segment_seal(log_path, seg_path)) {
+        fprintf(stderr, "[-] Could not seal %s; leaving it uncompressed\n", log_path);
+        return false;
+    }
+    return unlink(log_path) == 0;
+}
+
+static bool open_active(segment_log_t *log, uint32_t index) {
+    char path[SEGMENT_MAX_PATH];
+    segment_path(log->dir, index, false, path, sizeof(path));
+
+    log->index = index;
+    log->active = columnar_writer_open(path);
+    if (!log->active) return false;
+
+    // A resumed segment keeps aging from when it was created.
+    columnar_header_t header;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    log->opened = (int64_t)time(NULL);
+    if (fd >= 0) {
+        if (pread(fd, &header, sizeof(header), 0) == sizeof(header)) log->opened = header.created;
+        close(fd);
+    }
+    return true;
+}
+
+static bool rotate(segment_log_t *log) {
+    columnar_writer_close(log->active);
+    log->active = NULL;
+    seal_and_remove(log->dir, log->index);
+    return open_active(log, log->index + 1);
+}
+
+segment_log_t* segment_log_open(const char *dir, uint64_t max_bytes, uint32_t max_seconds) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[-] Cannot create log directory %s\n", dir);
+        return NULL;
+    }
+
+    segment_log_t *log = calloc(1, sizeof(segment_log_t));
+    if (!log) return NULL;
+    snprintf(log->dir, sizeof(log->dir), "%s", dir);
+    log->max_seconds = max_seconds;
+    if (max_bytes > 0) {
+        uint64_t blocks = max_bytes / columnar_block_size();
+        log->max_records = (blocks ? blocks : 1) * COLUMNAR_BLOCK_RECORDS;
+    }
+
+    uint32_t count;
+    segment_entry_t *entries = list_segments(dir, &count);
+    if (!entries) {
+        free(log);
+        return NULL;
+    }
+
+    // Unsealed segments other than the newest were left by a crash
+    // between rotation steps.
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        if (!entries[i].sealed) seal_and_remove(dir, entries[i].index);
+    }
+
+    bool ok;
+    if (count > 0 && !entries[count - 1].sealed) {
+        ok = open_active(log, entries[count - 1].index);
+    } else {
+        ok = open_active(log, count > 0 ? entries[count - 1].index + 1 : 1);
+    }
+    free(entries);
+
+    if (!ok) {
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void segment_log_close(segment_log_t *log) {
+    if (!log) return;
+    columnar_writer_close(log->active);
+    free(log);
+}
+
+bool segment_log_append(segment_log_t *log, const experiment_t *records, uint32_t count) {
+    bool ok = true;
+
+    while (count > 0) {
+        uint64_t held = columnar_writer_records(log->active);
+        bool full = log->max_records > 0 && held >= log->max_records;
+        bool old = log->max_seconds > 0 && held > 0 &&
+                   (int64_t)time(NULL) - log->opened >= log->max_seconds;
+        if (full || old) {
+            if (!rotate(log)) return false;
+            held = 0;
+        }
+
+        uint32_t n = count;
+        if (log->max_records > 0 && log->max_records - held < n) {
+            n = (uint32_t)(log->max_records - held);
+        }
+        ok &= columnar_writer_append(log->active, records, n);
+        records += n;
+        count -= n;
+    }
+
+    return ok;
+}
+
+bool segment_log_flush(segment_log_t *log, bool durable) {
+    return columnar_writer_flush(log->active, durable);
+}
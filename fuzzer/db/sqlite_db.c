@@ -1,49 +1,428 @@
+#define _GNU_SOURCE
 #include "db.h"
+#include "log_ring.h"
+#include "columnar.h"
+#include "segment.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sqlite3.h>
+
+#define DB_BUFFER_SIZE (256 * 1024)
+#define DB_MAX_ROW 256
+
+static const char *outcome_str[] = {
+    "SUCCESS", "TOO_EARLY", "TOO_LATE", "FAILED", "UNKNOWN"
+};
+
+static void write_csv_header(FILE *fp) {
+    fprintf(fp, "# LVI-DMA Fuzzer Experiment Log\n");
+    fprintf(fp, "# Generated: %ld\n", (long)time(NULL));
+    fprintf(fp, "timestamp,campaign_id,experiment_id,gadget_addr,outcome,leak_detected,leak_latency,window_estimate,p_value,significant\n");
+}
+
+static size_t format_row(char *buf, size_t size, const experiment_t *exp) {
+    uint32_t outcome = exp->outcome <= RACE_UNKNOWN ? exp->outcome : RACE_UNKNOWN;
+    int n = snprintf(buf, size, "%ld,%lu,%lu,0x%lx,%s,%d,%lu,%lu,%.6f,%d\n",
+                     (long)exp->timestamp,
+                     exp->campaign_id,
+                     exp->experiment_id,
+                     exp->gadget_addr,
+                     outcome_str[outcome],
+                     exp->leak_detected,
+                     exp->leak_latency,
+                     exp->window_estimate,
+                     exp->p_value,
+                     exp->statistically_significant);
+    return n > 0 ? (size_t)n : 0;
+}
+
+// SQLite backend: one connection in WAL mode, shared by the log writer
+// (experiment inserts) and the campaign calls. Inserts run inside an open
+// transaction that is committed every txn_limit records and on each flush,
+// so the flush interval bounds how much a crash can lose.
+//
+// experiments is clustered on (campaign_id, experiment_id), so inserts are
+// appends and per-campaign scans are range reads. A secondary index on
+// gadget_addr would make every insert a random B-tree write; instead each
+// finalized campaign is summarised into gadget_stats, keyed by gadget, for
+// cross-campaign queries.
+struct db_sqlite {
+    sqlite3 *conn;
+    sqlite3_stmt *insert_experiment;
+    sqlite3_stmt *insert_campaign;
+    sqlite3_stmt *update_campaign;
+    sqlite3_stmt *finalize_campaign;
+    sqlite3_stmt *summarize_campaign;
+    uint32_t txn_records;       // inserts in the open transaction
+    uint32_t txn_limit;
+    bool in_txn;
+};
+
+static const char *sqlite_schema =
+    "PRAGMA journal_mode=WAL;"
+    "PRAGMA synchronous=NORMAL;"
+    "PRAGMA temp_store=MEMORY;"
+    "CREATE TABLE IF NOT EXISTS campaigns ("
+    "  campaign_id INTEGER PRIMARY KEY,"
+    "  name TEXT NOT NULL,"
+    "  start_time INTEGER NOT NULL,"
+    "  end_time INTEGER,"
+    "  total_attempts INTEGER NOT NULL DEFAULT 0,"
+    "  successful_leaks INTEGER NOT NULL DEFAULT 0,"
+    "  success_rate REAL NOT NULL DEFAULT 0);"
+    "CREATE TABLE IF NOT EXISTS experiments ("
+    "  campaign_id INTEGER NOT NULL,"
+    "  experiment_id INTEGER NOT NULL,"
+    "  timestamp INTEGER NOT NULL,"
+    "  gadget_addr INTEGER NOT NULL,"
+    "  outcome INTEGER NOT NULL,"
+    "  leak_detected INTEGER NOT NULL,"
+    "  leak_latency INTEGER NOT NULL,"
+    "  window_estimate INTEGER NOT NULL,"
+    "  p_value REAL NOT NULL,"
+    "  significant INTEGER NOT NULL,"
+    "  PRIMARY KEY (campaign_id, experiment_id)) WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS gadget_stats ("
+    "  gadget_addr INTEGER NOT NULL,"
+    "  campaign_id INTEGER NOT NULL,"
+    "  attempts INTEGER NOT NULL,"
+    "  leaks INTEGER NOT NULL,"
+    "  mean_latency REAL NOT NULL,"
+    "  PRIMARY KEY (gadget_addr, campaign_id)) WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS outcomes (outcome INTEGER PRIMARY KEY, name TEXT NOT NULL);"
+    "INSERT OR IGNORE INTO outcomes VALUES"
+    "  (0, 'SUCCESS'), (1, 'TOO_EARLY'), (2, 'TOO_LATE'), (3, 'FAILED'), (4, 'UNKNOWN');";
+
+static bool sqlite_exec(struct db_sqlite *sq, const char *sql) {
+    char *error = NULL;
+    if (sqlite3_exec(sq->conn, sql, NULL, NULL, &error) != SQLITE_OK) {
+        fprintf(stderr, "[-] SQLite: %s\n", error ? error : sqlite3_errmsg(sq->conn));
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+static bool sqlite_prepare(struct db_sqlite *sq, const char *sql, sqlite3_stmt **stmt) {
+    if (sqlite3_prepare_v3(sq->conn, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[-] SQLite: %s\n", sqlite3_errmsg(sq->conn));
+        return false;
+    }
+    return true;
+}
+
+static bool sqlite_step_reset(struct db_sqlite *sq, sqlite3_stmt *stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "[-] SQLite: %s\n", sqlite3_errmsg(sq->conn));
+        return false;
+    }
+    return true;
+}
+
+static void sqlite_close(struct db_sqlite *sq) {
+    if (!sq) return;
+    sqlite3_finalize(sq->insert_experiment);
+    sqlite3_finalize(sq->insert_campaign);
+    sqlite3_finalize(sq->update_campaign);
+    sqlite3_finalize(sq->finalize_campaign);
+    sqlite3_finalize(sq->summarize_campaign);
+    sqlite3_close(sq->conn);
+    free(sq);
+}
+
+static struct db_sqlite* sqlite_open(const char *path, uint32_t txn_limit) {
+    struct db_sqlite *sq = calloc(1, sizeof(struct db_sqlite));
+    if (!sq) return NULL;
+    sq->txn_limit = txn_limit ? txn_limit : DB_DEFAULT_TXN_RECORDS;
+
+    if (sqlite3_open_v2(path, &sq->conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                        SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[-] SQLite: cannot open %s: %s\n", path,
+                sq->conn ? sqlite3_errmsg(sq->conn) : "out of memory");
+        sqlite_close(sq);
+        return NULL;
+    }
+
+    bool ok = sqlite_exec(sq, sqlite_schema) &&
+        sqlite_prepare(sq, "INSERT INTO experiments VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)",
+                       &sq->insert_experiment) &&
+        sqlite_prepare(sq, "INSERT INTO campaigns (campaign_id, name, start_time) VALUES (?1, ?2, ?3)",
+                       &sq->insert_campaign) &&
+        sqlite_prepare(sq, "UPDATE campaigns SET total_attempts = ?2, successful_leaks = ?3, "
+                           "success_rate = ?4 WHERE campaign_id = ?1",
+                       &sq->update_campaign) &&
+        sqlite_prepare(sq, "UPDATE campaigns SET end_time = ?2 WHERE campaign_id = ?1",
+                       &sq->finalize_campaign) &&
+        sqlite_prepare(sq, "INSERT OR REPLACE INTO gadget_stats "
+                           "SELECT gadget_addr, campaign_id, COUNT(*), SUM(leak_detected), "
+                           "AVG(leak_latency) FROM experiments WHERE campaign_id = ?1 "
+                           "GROUP BY gadget_addr",
+                       &sq->summarize_campaign);
+    if (!ok) {
+        sqlite_close(sq);
+        return NULL;
+    }
+    return sq;
+}
+
+static bool sqlite_commit(struct db_sqlite *sq) {
+    if (!sq->in_txn) return true;
+    sq->in_txn = false;
+    sq->txn_records = 0;
+    return sqlite_exec(sq, "COMMIT");
+}
+
+static bool sqlite_insert(struct db_sqlite *sq, const experiment_t *records, uint32_t count) {
+    bool ok = true;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!sq->in_txn) {
+            if (!sqlite_exec(sq, "BEGIN")) return false;
+            sq->in_txn = true;
+        }
+
+        const experiment_t *exp = &records[i];
+        sqlite3_stmt *st = sq->insert_experiment;
+        sqlite3_bind_int64(st, 1, (sqlite3_int64)exp->campaign_id);
+        sqlite3_bind_int64(st, 2, (sqlite3_int64)exp->experiment_id);
+        sqlite3_bind_int64(st, 3, (sqlite3_int64)exp->timestamp);
+        sqlite3_bind_int64(st, 4, (sqlite3_int64)exp->gadget_addr);
+        sqlite3_bind_int(st, 5, exp->outcome);
+        sqlite3_bind_int(st, 6, exp->leak_detected);
+        sqlite3_bind_int64(st, 7, (sqlite3_int64)exp->leak_latency);
+        sqlite3_bind_int64(st, 8, (sqlite3_int64)exp->window_estimate);
+        sqlite3_bind_double(st, 9, exp->p_value);
+        sqlite3_bind_int(st, 10, exp->statistically_significant);
+        ok &= sqlite_step_reset(sq, st);
+
+        if (++sq->txn_records >= sq->txn_limit) ok &= sqlite_commit(sq);
+    }
+
+    return ok;
+}
+
+// synchronous=NORMAL only syncs the WAL at checkpoints; a durable flush
+// forces one so committed campaigns survive power loss.
+static bool sqlite_flush(struct db_sqlite *sq, bool durable) {
+    bool ok = sqlite_commit(sq);
+    if (durable && ok) {
+        ok = sqlite3_wal_checkpoint_v2(sq->conn, NULL, SQLITE_CHECKPOINT_FULL, NULL, NULL) ==
+             SQLITE_OK;
+    }
+    return ok;
+}
+
+static bool db_buffer_drain(db_handle_t *db) {
+    bool ok = fwrite(db->buf, 1, db->buf_length, db->fp) == db->buf_length;
+    db->buf_length = 0;
+    return ok;
+}
+
+// Formats rows into the handle buffer and hands full buffers to stdio, so a
+// batch costs one write instead of one per record. Columnar logs copy the
+// fields into the current block instead.
+static bool db_sink_write(void *ctx, const experiment_t *records, uint32_t count) {
+    db_handle_t *db = ctx;
+    if (db->sqlite) return sqlite_insert(db->sqlite, records, count);
+    if (db->columnar) return columnar_writer_append(db->columnar, records, count);
+    if (db->segments) return segment_log_append(db->segments, records, count);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++) {
+        if (DB_BUFFER_SIZE - db->buf_length < DB_MAX_ROW) ok &= db_buffer_drain(db);
+        db->buf_length += format_row(db->buf + db->buf_length, DB_BUFFER_SIZE - db->buf_length,
+                                     &records[i]);
+    }
+
+    return ok;
+}
+
+static bool db_sink_flush(void *ctx, bool durable) {
+    db_handle_t *db = ctx;
+    if (db->sqlite) return sqlite_flush(db->sqlite, durable);
+    if (db->columnar) return columnar_writer_flush(db->columnar, durable);
+    if (db->segments) return segment_log_flush(db->segments, durable);
+
+    bool ok = db_buffer_drain(db);
+    ok &= fflush(db->fp) == 0;
+    if (durable) ok &= fdatasync(fileno(db->fp)) == 0;
+    return ok;
+}
+
+static bool db_is_open(const db_handle_t *db) {
+    return db && (db->fp || db->columnar || db->sqlite || db->segments);
+}
+
+void db_default_options(db_options_t *opts) {
+    opts->format = DB_FORMAT_CSV;
+    opts->ring_capacity = LOG_RING_DEFAULT_CAPACITY;
+    opts->flush_interval_ms = LOG_RING_DEFAULT_FLUSH_MS;
+    opts->writer_cpu = -1;
+    opts->drop_when_full = false;
+    opts->synchronous = false;
+    opts->txn_records = DB_DEFAULT_TXN_RECORDS;
+    opts->segment_bytes = SEGMENT_DEFAULT_BYTES;
+    opts->segment_seconds = 0;
+}
 
 db_handle_t* db_open(const char *filepath) {
+    db_options_t opts;
+    db_default_options(&opts);
+    return db_open_opts(filepath, &opts);
+}
+
+db_handle_t* db_open_opts(const char *filepath, const db_options_t *opts) {
     db_handle_t *db = calloc(1, sizeof(db_handle_t));
     if (!db) return NULL;
 
     strncpy(db->filepath, filepath, sizeof(db->filepath) - 1);
+    db->synchronous = opts->synchronous;
 
-    db->fp = fopen(filepath, "a+");
-    if (!db->fp) {
-        free(db);
-        return NULL;
+    // An existing log keeps its format whatever was requested.
+    bool exists = false;
+    FILE *probe = fopen(filepath, "r");
+    if (probe) {
+        exists = fgetc(probe) != EOF;
+        fclose(probe);
     }
+    db_format_t found = db_detect_format(filepath);
+    db->format = (exists || found == DB_FORMAT_SEGMENTED) ? found : opts->format;
 
-    fseek(db->fp, 0, SEEK_END);
-    if (ftell(db->fp) == 0) {
-        fprintf(db->fp, "# LVI-DMA Fuzzer Experiment Log\n");
-        fprintf(db->fp, "# Generated: %ld\n", (long)time(NULL));
-        fprintf(db->fp, "timestamp,campaign_id,experiment_id,gadget_addr,outcome,leak_detected,leak_latency,window_estimate,p_value,significant\n");
-        fflush(db->fp);
+    if (db->format == DB_FORMAT_SQLITE) {
+        db->sqlite = sqlite_open(filepath, opts->txn_records);
+        if (!db->sqlite) {
+            free(db);
+            return NULL;
+        }
+    } else if (db->format == DB_FORMAT_SEGMENTED) {
+        db->segments = segment_log_open(filepath, opts->segment_bytes, opts->segment_seconds);
+        if (!db->segments) {
+            free(db);
+            return NULL;
+        }
+    } else if (db->format == DB_FORMAT_COLUMNAR) {
+        db->columnar = columnar_writer_open(filepath);
+        if (!db->columnar) {
+            free(db);
+            return NULL;
+        }
+    } else {
+        db->buf = malloc(DB_BUFFER_SIZE);
+        db->fp = db->buf ? fopen(filepath, "a+") : NULL;
+        if (!db->fp) {
+            free(db->buf);
+            free(db);
+            return NULL;
+        }
+
+        fseek(db->fp, 0, SEEK_END);
+        if (ftell(db->fp) == 0) {
+            write_csv_header(db->fp);
+            fflush(db->fp);
+        }
     }
 
-    printf("[+] Opened experiment database: %s\n", filepath);
+    if (!db->synchronous) {
+        log_ring_config_t config;
+        log_ring_default_config(&config);
+        config.capacity = opts->ring_capacity;
+        config.flush_interval_ms = opts->flush_interval_ms;
+        config.writer_cpu = opts->writer_cpu;
+        config.drop_when_full = opts->drop_when_full;
+
+        db->ring = log_ring_create(&config, db_sink_write, db_sink_flush, db);
+        if (!db->ring) {
+            fprintf(stderr, "[-] Log writer thread failed; logging synchronously\n");
+            db->synchronous = true;
+        }
+    }
+
+    printf("[+] Opened experiment database: %s (%s)\n", filepath, db_format_name(db->format));
 
     return db;
 }
 
 void db_close(db_handle_t *db) {
     if (db) {
+        if (db->ring) {
+            log_ring_stats_t stats;
+            log_ring_destroy(db->ring, &stats);
+            db->ring = NULL;
+
+            printf("[+] Experiment log: %lu written, %lu dropped, %lu backpressure waits, "
+                   "%lu batches\n", stats.written, stats.dropped, stats.full_waits,
+                   stats.batches);
+            if (stats.write_errors > 0) {
+                fprintf(stderr, "[-] %lu experiment log writes failed\n", stats.write_errors);
+            }
+        }
+        if (db->columnar) {
+            columnar_writer_close(db->columnar);
+        }
+        if (db->segments) {
+            segment_log_close(db->segments);
+        }
+        if (db->sqlite) {
+            sqlite_flush(db->sqlite, true);
+            sqlite_close(db->sqlite);
+        }
         if (db->fp) {
             fclose(db->fp);
         }
+        free(db->buf);
         free(db);
     }
 }
 
+bool db_flush(db_handle_t *db, bool durable) {
+    if (!db_is_open(db)) return false;
+    if (db->ring) return log_ring_flush(db->ring, durable);
+    return db_sink_flush(db, durable);
+}
+
 bool db_campaign_create(db_handle_t *db, campaign_t *campaign) {
-    campaign->campaign_id = (uint64_t)time(NULL);
-    campaign->start_time = time(NULL);
+    // Microseconds since the epoch, kept increasing within a run, so
+    // campaigns started in the same second still get distinct ids.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    campaign->campaign_id = (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000;
+    if (db && campaign->campaign_id <= db->last_campaign_id) {
+        campaign->campaign_id = db->last_campaign_id + 1;
+    }
+    campaign->start_time = now.tv_sec;
     campaign->total_attempts = 0;
     campaign->successful_leaks = 0;
     campaign->success_rate = 0.0;
 
+    if (db && db->sqlite) {
+        // Another run on this database may already hold the id; take the
+        // next free one instead of failing the insert.
+        struct db_sqlite *sq = db->sqlite;
+        int rc;
+        while (true) {
+            sqlite3_bind_int64(sq->insert_campaign, 1, (sqlite3_int64)campaign->campaign_id);
+            sqlite3_bind_text(sq->insert_campaign, 2, campaign->name, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(sq->insert_campaign, 3, (sqlite3_int64)campaign->start_time);
+            rc = sqlite3_step(sq->insert_campaign);
+            sqlite3_reset(sq->insert_campaign);
+            if (rc != SQLITE_CONSTRAINT) break;
+            campaign->campaign_id++;
+        }
+
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "[-] SQLite: %s\n", sqlite3_errmsg(sq->conn));
+            return false;
+        }
+    }
+
+    if (db) db->last_campaign_id = campaign->campaign_id;
     printf("[+] Created campaign %lu: %s\n", campaign->campaign_id, campaign->name);
 
     return true;
@@ -54,59 +433,359 @@ bool db_campaign_update(db_handle_t *db, campaign_t *campaign) {
         campaign->success_rate = (double)campaign->successful_leaks / campaign->total_attempts;
     }
 
+    if (db && db->sqlite) {
+        sqlite3_stmt *st = db->sqlite->update_campaign;
+        sqlite3_bind_int64(st, 1, (sqlite3_int64)campaign->campaign_id);
+        sqlite3_bind_int64(st, 2, campaign->total_attempts);
+        sqlite3_bind_int64(st, 3, campaign->successful_leaks);
+        sqlite3_bind_double(st, 4, campaign->success_rate);
+        return sqlite_step_reset(db->sqlite, st);
+    }
+
     return true;
 }
 
 bool db_campaign_finalize(db_handle_t *db, uint64_t campaign_id) {
     printf("[*] Finalizing campaign %lu\n", campaign_id);
-    return true;
+
+    if (db && db->sqlite) {
+        // Every queued experiment has to be inserted before summarising.
+        if (!db_flush(db, false)) return false;
+
+        sqlite3_stmt *st = db->sqlite->finalize_campaign;
+        sqlite3_bind_int64(st, 1, (sqlite3_int64)campaign_id);
+        sqlite3_bind_int64(st, 2, (sqlite3_int64)time(NULL));
+        if (!sqlite_step_reset(db->sqlite, st)) return false;
+
+        st = db->sqlite->summarize_campaign;
+        sqlite3_bind_int64(st, 1, (sqlite3_int64)campaign_id);
+        if (!sqlite_step_reset(db->sqlite, st)) return false;
+    }
+
+    return db_flush(db, true);
 }
 
 bool db_experiment_log(db_handle_t *db, experiment_t *exp) {
-    if (!db || !db->fp) return false;
+    if (!db_is_open(db)) return false;
 
-    const char *outcome_str[] = {
-        "SUCCESS", "TOO_EARLY", "TOO_LATE", "FAILED", "UNKNOWN"
-    };
+    if (db->ring) return log_ring_push(db->ring, exp);
 
-    fprintf(db->fp, "%ld,%lu,%lu,0x%lx,%s,%d,%lu,%lu,%.6f,%d\n",
-            (long)exp->timestamp,
-            exp->campaign_id,
-            exp->experiment_id,
-            exp->gadget_addr,
-            outcome_str[exp->outcome],
-            exp->leak_detected,
-            exp->leak_latency,
-            exp->window_estimate,
-            exp->p_value,
-            exp->statistically_significant);
+    // SQLite without the writer thread still batches: sqlite_insert commits
+    // every txn_limit records and db_flush commits the rest.
+    if (db->sqlite) return sqlite_insert(db->sqlite, exp, 1);
+    return db_sink_write(db, exp, 1) && db_sink_flush(db, false);
+}
 
-    fflush(db->fp);
+typedef struct {
+    FILE *out;
+    char *buf;
+    size_t length;
+    const db_query_t *query;
+    uint64_t rows;
+    bool ok;
+} csv_export_t;
 
-    return true;
+static void export_record(csv_export_t *x, const experiment_t *exp) {
+    if (!db_query_match(x->query, exp->campaign_id, (int64_t)exp->timestamp)) return;
+
+    if (DB_BUFFER_SIZE - x->length < DB_MAX_ROW) {
+        x->ok &= fwrite(x->buf, 1, x->length, x->out) == x->length;
+        x->length = 0;
+    }
+    x->length += format_row(x->buf + x->length, DB_BUFFER_SIZE - x->length, exp);
+    x->rows++;
 }
 
-bool db_export_csv(db_handle_t *db, const char *output_path) {
-    printf("[*] Exporting database to: %s\n", output_path);
+// Block-at-a-time conversion: rows are formatted straight from the mapped
+// or decoded columns into one output buffer.
+static bool export_block(void *ctx, const columnar_block_t *block) {
+    csv_export_t *x = ctx;
+    for (uint32_t i = 0; i < block->count; i++) {
+        experiment_t exp;
+        columnar_record(block, i, &exp);
+        export_record(x, &exp);
+    }
+    return x->ok;
+}
 
-    FILE *in = fopen(db->filepath, "r");
-    FILE *out = fopen(output_path, "w");
+static bool convert_columnar(const char *log_path, csv_export_t *x) {
+    columnar_view_t view;
+    if (!columnar_map(log_path, &view)) {
+        fprintf(stderr, "[-] Cannot read experiment log %s\n", log_path);
+        return false;
+    }
 
-    if (!in || !out) {
-        if (in) fclose(in);
-        if (out) fclose(out);
+    for (uint64_t b = 0; b < view.block_count && x->ok; b++) {
+        columnar_block_t block;
+        columnar_block(&view, b, &block);
+        export_block(x, &block);
+    }
+
+    columnar_unmap(&view);
+    return x->ok;
+}
+
+static bool convert_segmented(const char *dir, csv_export_t *x) {
+    segment_scan_stats_t stats;
+    if (!segment_log_scan(dir, x->query, export_block, x, &stats)) {
+        fprintf(stderr, "[-] Cannot read segmented log %s\n", dir);
+        return false;
+    }
+    printf("[*] Read %lu of %lu segments (%lu records)\n", stats.segments_read, stats.segments,
+           stats.records_read);
+    return x->ok;
+}
+
+static bool convert_sqlite(const char *log_path, csv_export_t *x) {
+    sqlite3 *conn = NULL;
+    sqlite3_stmt *st = NULL;
+    if (sqlite3_open_v2(log_path, &conn, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "SELECT timestamp, campaign_id, experiment_id, gadget_addr, "
+                                 "outcome, leak_detected, leak_latency, window_estimate, "
+                                 "p_value, significant FROM experiments "
+                                 "WHERE campaign_id BETWEEN ?1 AND ?2 "
+                                 "AND timestamp BETWEEN ?3 AND ?4 "
+                                 "ORDER BY campaign_id, experiment_id",
+                           -1, &st, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[-] Cannot read experiment database %s: %s\n", log_path,
+                conn ? sqlite3_errmsg(conn) : "out of memory");
+        sqlite3_close(conn);
         return false;
     }
 
-    char buffer[4096];
-    while (fgets(buffer, sizeof(buffer), in)) {
-        fputs(buffer, out);
+    // SQLite integers are signed; clamp the unsigned campaign bounds.
+    sqlite3_bind_int64(st, 1, (sqlite3_int64)(x->query->campaign_min > INT64_MAX ? INT64_MAX
+                                              : x->query->campaign_min));
+    sqlite3_bind_int64(st, 2, (sqlite3_int64)(x->query->campaign_max > INT64_MAX ? INT64_MAX
+                                              : x->query->campaign_max));
+    sqlite3_bind_int64(st, 3, x->query->time_min);
+    sqlite3_bind_int64(st, 4, x->query->time_max);
+
+    int rc;
+    while (x->ok && (rc = sqlite3_step(st)) == SQLITE_ROW) {
+        experiment_t exp = {
+            .timestamp = (time_t)sqlite3_column_int64(st, 0),
+            .campaign_id = (uint64_t)sqlite3_column_int64(st, 1),
+            .experiment_id = (uint64_t)sqlite3_column_int64(st, 2),
+            .gadget_addr = (uint64_t)sqlite3_column_int64(st, 3),
+            .outcome = (race_outcome_t)sqlite3_column_int(st, 4),
+            .leak_detected = sqlite3_column_int(st, 5),
+            .leak_latency = (uint64_t)sqlite3_column_int64(st, 6),
+            .window_estimate = (uint64_t)sqlite3_column_int64(st, 7),
+            .p_value = sqlite3_column_double(st, 8),
+            .statistically_significant = sqlite3_column_int(st, 9)
+        };
+        export_record(x, &exp);
+    }
+    if (x->ok && rc != SQLITE_DONE) x->ok = false;
+
+    sqlite3_finalize(st);
+    sqlite3_close(conn);
+    return x->ok;
+}
+
+// Already CSV: data rows are copied through, filtered on their leading
+// timestamp and campaign_id fields.
+static bool convert_csv(const char *log_path, csv_export_t *x) {
+    FILE *in = fopen(log_path, "r");
+    if (!in) return false;
+
+    char line[1024];
+    while (x->ok && fgets(line, sizeof(line), in)) {
+        long timestamp;
+        unsigned long campaign_id;
+        if (sscanf(line, "%ld,%lu,", &timestamp, &campaign_id) != 2) continue;
+        if (!db_query_match(x->query, campaign_id, timestamp)) continue;
+
+        size_t n = strlen(line);
+        if (DB_BUFFER_SIZE - x->length < n) {
+            x->ok &= fwrite(x->buf, 1, x->length, x->out) == x->length;
+            x->length = 0;
+        }
+        memcpy(x->buf + x->length, line, n);
+        x->length += n;
+        x->rows++;
     }
 
     fclose(in);
-    fclose(out);
+    return x->ok;
+}
+
+db_format_t db_detect_format(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        closedir(dir);
+        return DB_FORMAT_SEGMENTED;
+    }
+
+    char magic[16] = {0};
+    FILE *fp = fopen(path, "rb");
+    if (fp) {
+        if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)) memset(magic, 0, sizeof(magic));
+        fclose(fp);
+    }
+
+    if (memcmp(magic, "SQLite format 3", 16) == 0) return DB_FORMAT_SQLITE;
+    if (memcmp(magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) == 0) return DB_FORMAT_COLUMNAR;
+    return DB_FORMAT_CSV;
+}
+
+const char* db_format_name(db_format_t format) {
+    switch (format) {
+        case DB_FORMAT_COLUMNAR: return "columnar";
+        case DB_FORMAT_SQLITE:   return "SQLite";
+        case DB_FORMAT_SEGMENTED: return "segmented";
+        default:                 return "CSV";
+    }
+}
+
+void db_query_all(db_query_t *query) {
+    query->campaign_min = 0;
+    query->campaign_max = UINT64_MAX;
+    query->time_min = INT64_MIN;
+    query->time_max = INT64_MAX;
+}
+
+bool db_convert_csv(const char *log_path, const char *output_path, const db_query_t *query) {
+    printf("[*] Exporting database to: %s\n", output_path);
+
+    db_query_t all;
+    db_query_all(&all);
+
+    csv_export_t x = {
+        .out = fopen(output_path, "w"),
+        .buf = malloc(DB_BUFFER_SIZE),
+        .query = query ? query : &all,
+        .ok = true
+    };
+    if (!x.out || !x.buf) {
+        if (x.out) fclose(x.out);
+        free(x.buf);
+        return false;
+    }
 
-    printf("[+] Database exported successfully\n");
+    write_csv_header(x.out);
+    switch (db_detect_format(log_path)) {
+        case DB_FORMAT_SQLITE:    convert_sqlite(log_path, &x); break;
+        case DB_FORMAT_COLUMNAR:  convert_columnar(log_path, &x); break;
+        case DB_FORMAT_SEGMENTED: convert_segmented(log_path, &x); break;
+        default:                  x.ok = convert_csv(log_path, &x); break;
+    }
+    x.ok = x.ok && fwrite(x.buf, 1, x.length, x.out) == x.length;
+    x.ok &= fclose(x.out) == 0;
+    free(x.buf);
+    if (!x.ok) return false;
 
+    printf("[+] Database exported successfully (%lu records)\n", x.rows);
     return true;
 }
+
+bool db_export_csv(db_handle_t *db, const char *output_path) {
+    if (!db_flush(db, false)) return false;
+    return db_convert_csv(db->filepath, output_path, NULL);
+}
+
+// Rows are appended in order, so the rows to drop are the lines at the end
+// of the file. An unterminated last line is a torn write and goes too.
+static bool rewind_csv(const char *path, uint64_t campaign_id, uint64_t experiment_id,
+                       uint64_t *dropped) {
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size <= 0) {
+        close(fd);
+        return size == 0;
+    }
+
+    char *data = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    size_t end = (size_t)size;
+    if (data[end - 1] != '\n') {
+        const char *nl = memrchr(data, '\n', end);
+        end = nl ? (size_t)(nl - data) + 1 : 0;
+    }
+
+    while (end > 0) {
+        const char *nl = (end > 1) ? memrchr(data, '\n', end - 1) : NULL;
+        size_t start = nl ? (size_t)(nl - data) + 1 : 0;
+
+        char line[64];
+        size_t n = end - start < sizeof(line) - 1 ? end - start : sizeof(line) - 1;
+        memcpy(line, data + start, n);
+        line[n] = '\0';
+
+        long timestamp;
+        uint64_t campaign, experiment;
+        if (sscanf(line, "%ld,%lu,%lu,", &timestamp, &campaign, &experiment) != 3 ||
+            campaign != campaign_id || experiment <= experiment_id) {
+            break;
+        }
+        (*dropped)++;
+        end = start;
+    }
+    munmap(data, (size_t)size);
+
+    bool ok = true;
+    if (end < (size_t)size) {
+        ok = ftruncate(fd, (off_t)end) == 0 && fdatasync(fd) == 0;
+    }
+    ok &= close(fd) == 0;
+    return ok;
+}
+
+static bool rewind_sqlite(const char *path, uint64_t campaign_id, uint64_t experiment_id,
+                          uint64_t *dropped) {
+    sqlite3 *conn = NULL;
+    sqlite3_stmt *st = NULL;
+    if (sqlite3_open_v2(path, &conn, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "DELETE FROM experiments WHERE campaign_id = ?1 "
+                                 "AND experiment_id > ?2", -1, &st, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[-] SQLite: cannot open %s: %s\n", path,
+                conn ? sqlite3_errmsg(conn) : "out of memory");
+        sqlite3_close(conn);
+        return false;
+    }
+
+    sqlite3_bind_int64(st, 1, (sqlite3_int64)campaign_id);
+    sqlite3_bind_int64(st, 2, (sqlite3_int64)experiment_id);
+    bool ok = sqlite3_step(st) == SQLITE_DONE;
+    *dropped = (uint64_t)sqlite3_changes(conn);
+    sqlite3_finalize(st);
+    if (!ok) fprintf(stderr, "[-] SQLite: %s\n", sqlite3_errmsg(conn));
+
+    sqlite3_close(conn);
+    return ok;
+}
+
+bool db_rewind(const char *log_path, uint64_t campaign_id, uint64_t experiment_id) {
+    if (access(log_path, F_OK) != 0) return true;
+
+    uint64_t dropped = 0, kept;
+    bool ok;
+    switch (db_detect_format(log_path)) {
+        case DB_FORMAT_SQLITE:
+            ok = rewind_sqlite(log_path, campaign_id, experiment_id, &dropped);
+            break;
+        case DB_FORMAT_COLUMNAR:
+            ok = columnar_rewind(log_path, campaign_id, experiment_id, &kept, &dropped);
+            break;
+        case DB_FORMAT_SEGMENTED:
+            ok = segment_log_rewind(log_path, campaign_id, experiment_id, &dropped);
+            break;
+        default:
+            ok = rewind_csv(log_path, campaign_id, experiment_id, &dropped);
+            break;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "[-] Could not rewind %s to the checkpoint\n", log_path);
+    } else if (dropped > 0) {
+        printf("[*] Dropped %lu records logged after the checkpoint\n", dropped);
+    }
+    return ok;
+}
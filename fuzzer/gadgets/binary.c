@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+#include "gadgets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READ_CHUNK_SIZE (1u << 20)
+
+static bool image_read_fd(int fd, binary_image_t *image) {
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t size = 0;
+    uint8_t *buffer = malloc(capacity);
+    if (!buffer) return false;
+
+    while (true) {
+        if (size == capacity) {
+            uint8_t *grown = realloc(buffer, capacity * 2);
+            if (!grown) {
+                free(buffer);
+                return false;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, buffer + size, capacity - size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buffer);
+            return false;
+        }
+        if (n == 0) break;
+        size += (size_t)n;
+    }
+
+    image->data = buffer;
+    image->size = size;
+    image->mapped = false;
+    return true;
+}
+
+static bool image_map_fd(int fd, size_t size, uint32_t flags, binary_image_t *image) {
+    int mmap_flags = MAP_PRIVATE;
+    if (flags & GADGET_MAP_POPULATE) mmap_flags |= MAP_POPULATE;
+
+    void *map = mmap(NULL, size, PROT_READ, mmap_flags, fd, 0);
+    if (map == MAP_FAILED) return false;
+
+    madvise(map, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (flags & GADGET_MAP_HUGEPAGE) madvise(map, size, MADV_HUGEPAGE);
+#endif
+
+    image->data = map;
+    image->size = size;
+    image->mapped = true;
+    return true;
+}
+
+bool binary_image_open(const char *path, uint32_t flags, binary_image_t *image) {
+    memset(image, 0, sizeof(binary_image_t));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    bool ok = false;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        ok = image_map_fd(fd, (size_t)st.st_size, flags, image);
+    }
+
+    // Pipes, character devices and anything mmap refuses take the read path.
+    if (!ok) {
+        ok = image_read_fd(fd, image);
+    }
+
+    if (ok && S_ISREG(st.st_mode)) {
+        image->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    }
+
+    close(fd);
+    return ok;
+}
+
+void binary_image_close(binary_image_t *image) {
+    if (!image->data) return;
+
+    if (image->mapped) {
+        munmap((void*)image->data, image->size);
+    } else {
+        free((void*)image->data);
+    }
+
+    memset(image, 0, sizeof(binary_image_t));
+}
@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include "gadget_corpus.h"
+#include "hash.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CORPUS_MAX_DEPTH 64
+
+gadget_corpus_t* gadget_corpus_create(void) {
+    gadget_corpus_t *corpus = calloc(1, sizeof(gadget_corpus_t));
+    if (!corpus) return NULL;
+
+    corpus->gadgets = gadget_list_create();
+    if (!corpus->gadgets) {
+        free(corpus);
+        return NULL;
+    }
+
+    return corpus;
+}
+
+void gadget_corpus_destroy(gadget_corpus_t *corpus) {
+    if (!corpus) return;
+
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        free(corpus->files[i].path);
+    }
+    free(corpus->files);
+    gadget_list_destroy(corpus->gadgets);
+    free(corpus);
+}
+
+static bool corpus_add_file(gadget_corpus_t *corpus, const char *path, const struct stat *st) {
+    if (corpus->file_count >= corpus->capacity) {
+        uint32_t capacity = corpus->capacity ? corpus->capacity * 2 : 256;
+        gadget_corpus_file_t *files = realloc(corpus->files,
+                                              capacity * sizeof(gadget_corpus_file_t));
+        if (!files) return false;
+        corpus->files = files;
+        corpus->capacity = capacity;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return false;
+
+    corpus->files[corpus->file_count++] = (gadget_corpus_file_t){
+        .path = copy,
+        .dev = st->st_dev,
+        .ino = st->st_ino,
+        .size = (uint64_t)st->st_size,
+        .duplicate_of = CORPUS_NOT_DUPLICATE
+    };
+    return true;
+}
+
+// Directory symlinks are not followed, which also rules out loops; file
+// symlinks are resolved and later folded into their target's inode.
+static bool corpus_walk(gadget_corpus_t *corpus, const char *dir, uint32_t depth) {
+    if (depth > CORPUS_MAX_DEPTH) return true;
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "[-] Cannot open directory: %s\n", dir);
+        return true;
+    }
+
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char path[4096];
+        int n = snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (n <= 0 || (size_t)n >= sizeof(path)) continue;
+
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            ok = corpus_walk(corpus, path, depth + 1);
+        } else if (S_ISREG(st.st_mode)) {
+            ok = corpus_add_file(corpus, path, &st);
+        } else if (S_ISLNK(st.st_mode) && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            ok = corpus_add_file(corpus, path, &st);
+        }
+    }
+
+    closedir(d);
+    return ok;
+}
+
+bool gadget_corpus_add_path(gadget_corpus_t *corpus, const char *pattern) {
+    glob_t g;
+    int rc = glob(pattern, GLOB_NOCHECK | GLOB_TILDE | GLOB_BRACE, NULL, &g);
+    if (rc != 0) {
+        fprintf(stderr, "[-] Bad path pattern: %s\n", pattern);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < g.gl_pathc; i++) {
+        const char *path = g.gl_pathv[i];
+        struct stat st;
+
+        if (stat(path, &st) != 0) {
+            fprintf(stderr, "[-] No such file or directory: %s\n", path);
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            ok = corpus_walk(corpus, path, 0);
+        } else if (S_ISREG(st.st_mode)) {
+            ok = corpus_add_file(corpus, path, &st);
+        }
+    }
+
+    globfree(&g);
+    return ok;
+}
+
+static int compare_path(const void *a, const void *b) {
+    return strcmp(((const gadget_corpus_file_t*)a)->path, ((const gadget_corpus_file_t*)b)->path);
+}
+
+// Sorts by path and drops files that were named more than once.
+static void corpus_normalize(gadget_corpus_t *corpus) {
+    if (corpus->file_count == 0) return;
+
+    qsort(corpus->files, corpus->file_count, sizeof(gadget_corpus_file_t), compare_path);
+
+    uint32_t kept = 1;
+    for (uint32_t i = 1; i < corpus->file_count; i++) {
+        if (strcmp(corpus->files[i].path, corpus->files[kept - 1].path) == 0) {
+            free(corpus->files[i].path);
+            continue;
+        }
+        corpus->files[kept++] = corpus->files[i];
+    }
+    corpus->file_count = kept;
+}
+
+typedef struct {
+    const gadget_corpus_t *corpus;
+    uint32_t index;
+} corpus_ref_t;
+
+static int compare_inode(const void *a, const void *b) {
+    const corpus_ref_t *x = a, *y = b;
+    const gadget_corpus_file_t *fx = &x->corpus->files[x->index];
+    const gadget_corpus_file_t *fy = &y->corpus->files[y->index];
+
+    if (fx->dev != fy->dev) return fx->dev < fy->dev ? -1 : 1;
+    if (fx->ino != fy->ino) return fx->ino < fy->ino ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Content duplicates point at the scanned file that claimed their bytes.
+static uint32_t content_owner(const gadget_corpus_t *corpus, uint32_t index) {
+    const gadget_corpus_file_t *f = &corpus->files[index];
+    return f->scanned ? index : f->duplicate_of;
+}
+
+static int compare_content(const void *a, const void *b) {
+    const corpus_ref_t *x = a, *y = b;
+    uint32_t ox = content_owner(x->corpus, x->index);
+    uint32_t oy = content_owner(y->corpus, y->index);
+
+    if (ox != oy) return ox < oy ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static int compare_size_desc(const void *a, const void *b) {
+    const corpus_ref_t *x = a, *y = b;
+    uint64_t sx = x->corpus->files[x->index].size;
+    uint64_t sy = y->corpus->files[y->index].size;
+
+    if (sx != sy) return sx > sy ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Hard links and symlinks to one file: the first path in sort order is kept.
+static void corpus_mark_inode_duplicates(gadget_corpus_t *corpus, corpus_ref_t *refs) {
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        refs[i] = (corpus_ref_t){ corpus, i };
+    }
+    qsort(refs, corpus->file_count, sizeof(corpus_ref_t), compare_inode);
+
+    for (uint32_t i = 1; i < corpus->file_count; i++) {
+        gadget_corpus_file_t *prev = &corpus->files[refs[i - 1].index];
+        gadget_corpus_file_t *cur = &corpus->files[refs[i].index];
+        if (cur->dev == prev->dev && cur->ino == prev->ino) {
+            cur->duplicate_of = (prev->duplicate_of == CORPUS_NOT_DUPLICATE)
+                                ? refs[i - 1].index : prev->duplicate_of;
+        }
+    }
+}
+
+typedef struct {
+    uint64_t hash;
+    uint64_t size;
+    uint32_t index;
+    bool used;
+} content_slot_t;
+
+typedef struct {
+    gadget_corpus_t *corpus;
+    const gadget_scan_options_t *opts;
+    const corpus_ref_t *work;
+    uint32_t work_count;
+    uint32_t next;              // shared work queue cursor
+    gadget_list_t **results;    // per file, NULL until scanned
+    content_slot_t *seen;
+    uint32_t seen_mask;
+    pthread_mutex_t lock;
+} corpus_pool_t;
+
+// Both files are mapped again to compare them; a matching hash and size
+// alone is not proof, since collisions can be forced.
+static bool same_content(corpus_pool_t *pool, uint32_t owner, const binary_image_t *image) {
+    binary_image_t other;
+    if (!binary_image_open(pool->corpus->files[owner].path, pool->opts->map_flags, &other)) {
+        return false;
+    }
+    bool same = other.size == image->size && memcmp(other.data, image->data, image->size) == 0;
+    binary_image_close(&other);
+    return same;
+}
+
+// Returns the file already claiming this content, or index after claiming it.
+static uint32_t claim_content(corpus_pool_t *pool, uint64_t hash, const binary_image_t *image,
+                              uint32_t index) {
+    pthread_mutex_lock(&pool->lock);
+
+    // Slots are never freed, so probing can resume where it left off after
+    // the lock is dropped for a comparison.
+    uint32_t slot = (uint32_t)hash & pool->seen_mask;
+    while (pool->seen[slot].used) {
+        if (pool->seen[slot].hash == hash && pool->seen[slot].size == image->size) {
+            uint32_t owner = pool->seen[slot].index;
+            pthread_mutex_unlock(&pool->lock);
+            if (same_content(pool, owner, image)) return owner;
+            pthread_mutex_lock(&pool->lock);
+        }
+        slot = (slot + 1) & pool->seen_mask;
+    }
+
+    pool->seen[slot] = (content_slot_t){ hash, image->size, index, true };
+
+    pthread_mutex_unlock(&pool->lock);
+    return index;
+}
+
+static void corpus_scan_file(corpus_pool_t *pool, uint32_t index) {
+    gadget_corpus_file_t *file = &pool->corpus->files[index];
+    const gadget_scan_options_t *opts = pool->opts;
+
+    binary_image_t image;
+    if (!binary_image_open(file->path, opts->map_flags, &image)) {
+        file->skipped = true;
+        return;
+    }
+
+    exec_region_t regions[MAX_EXEC_REGIONS];
+    if (!opts->raw && elf_exec_regions(image.data, image.size, regions, MAX_EXEC_REGIONS) == 0) {
+        file->skipped = true;
+        binary_image_close(&image);
+        return;
+    }
+
+    file->content_hash = hash_bytes(image.data, image.size, 0);
+    file->size = image.size;
+
+    uint32_t owner = claim_content(pool, file->content_hash, &image, index);
+    if (owner != index) {
+        file->duplicate_of = owner;
+        binary_image_close(&image);
+        return;
+    }
+
+    // Parallelism is across files; each file gets one thread.
+    gadget_scan_options_t file_opts = *opts;
+    file_opts.threads = 1;
+    file_opts.quiet = true;
+
+    gadget_list_t *list = gadget_list_create();
+    if (list) {
+        gadget_scan_image(&image, file->path, &file_opts, list);
+        pool->results[index] = list;
+        file->scanned = true;
+    } else {
+        file->skipped = true;
+    }
+
+    binary_image_close(&image);
+}
+
+static void* corpus_worker(void *arg) {
+    corpus_pool_t *pool = arg;
+
+    while (true) {
+        uint32_t w = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (w >= pool->work_count) break;
+        corpus_scan_file(pool, pool->work[w].index);
+    }
+
+    return NULL;
+}
+
+static uint32_t corpus_thread_count(uint32_t requested, uint32_t work) {
+    uint32_t threads = requested;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (uint32_t)online : 1;
+    }
+    if (threads > GADGET_SCAN_MAX_THREADS) threads = GADGET_SCAN_MAX_THREADS;
+    if (threads > work) threads = work;
+
+    return threads ? threads : 1;
+}
+
+// Which copy of a duplicated file gets scanned depends on thread timing;
+// hand each scan to the first path with that content so the output does not.
+static void corpus_canonicalize(gadget_corpus_t *corpus, gadget_list_t **results,
+                                corpus_ref_t *refs) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        gadget_corpus_file_t *f = &corpus->files[i];
+        // Inode duplicates were never opened, so they have no content hash.
+        if (f->scanned || (f->duplicate_of != CORPUS_NOT_DUPLICATE && f->content_hash != 0)) {
+            refs[n++] = (corpus_ref_t){ corpus, i };
+        }
+    }
+    qsort(refs, n, sizeof(corpus_ref_t), compare_content);
+
+    for (uint32_t start = 0; start < n; ) {
+        uint32_t end = start + 1;
+        uint32_t owner = content_owner(corpus, refs[start].index);
+        while (end < n && content_owner(corpus, refs[end].index) == owner) end++;
+
+        uint32_t canonical = refs[start].index;
+        for (uint32_t i = start; i < end; i++) {
+            uint32_t idx = refs[i].index;
+            gadget_corpus_file_t *f = &corpus->files[idx];
+            if (idx == canonical) continue;
+
+            if (f->scanned) {
+                results[canonical] = results[idx];
+                results[idx] = NULL;
+                corpus->files[canonical].scanned = true;
+                corpus->files[canonical].duplicate_of = CORPUS_NOT_DUPLICATE;
+                f->scanned = false;
+            }
+            f->duplicate_of = canonical;
+        }
+        start = end;
+    }
+
+    // Inode duplicates may point at a file that turned out to be a content
+    // duplicate itself.
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        uint32_t d = corpus->files[i].duplicate_of;
+        while (d != CORPUS_NOT_DUPLICATE && corpus->files[d].duplicate_of != CORPUS_NOT_DUPLICATE) {
+            d = corpus->files[d].duplicate_of;
+        }
+        corpus->files[i].duplicate_of = d;
+    }
+}
+
+bool gadget_corpus_scan(gadget_corpus_t *corpus, const gadget_scan_options_t *opts) {
+    corpus_normalize(corpus);
+    if (corpus->file_count == 0) {
+        fprintf(stderr, "[-] No files to scan\n");
+        return false;
+    }
+
+    uint32_t seen_size = 16;
+    while (seen_size < 2 * corpus->file_count) seen_size *= 2;
+
+    corpus_ref_t *refs = calloc(corpus->file_count, sizeof(corpus_ref_t));
+    gadget_list_t **results = calloc(corpus->file_count, sizeof(gadget_list_t*));
+    content_slot_t *seen = calloc(seen_size, sizeof(content_slot_t));
+    if (!refs || !results || !seen) {
+        free(refs);
+        free(results);
+        free(seen);
+        return false;
+    }
+
+    corpus_mark_inode_duplicates(corpus, refs);
+
+    // Largest files first, so the pool does not finish on one big straggler.
+    uint32_t work_count = 0;
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        if (corpus->files[i].duplicate_of == CORPUS_NOT_DUPLICATE) {
+            refs[work_count++] = (corpus_ref_t){ corpus, i };
+        }
+    }
+    qsort(refs, work_count, sizeof(corpus_ref_t), compare_size_desc);
+
+    corpus_pool_t pool = {
+        .corpus = corpus,
+        .opts = opts,
+        .work = refs,
+        .work_count = work_count,
+        .next = 0,
+        .results = results,
+        .seen = seen,
+        .seen_mask = seen_size - 1
+    };
+    pthread_mutex_init(&pool.lock, NULL);
+
+    uint32_t threads = corpus_thread_count(opts->threads, work_count);
+    printf("[*] Batch scanning %u files (%u distinct inodes) with %u thread%s\n",
+           corpus->file_count, work_count, threads, threads == 1 ? "" : "s");
+
+    pthread_t tids[GADGET_SCAN_MAX_THREADS];
+    bool launched[GADGET_SCAN_MAX_THREADS] = {false};
+    for (uint32_t t = 1; t < threads; t++) {
+        launched[t] = (pthread_create(&tids[t], NULL, corpus_worker, &pool) == 0);
+    }
+    corpus_worker(&pool);
+    for (uint32_t t = 1; t < threads; t++) {
+        if (launched[t]) pthread_join(tids[t], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    corpus_canonicalize(corpus, results, refs);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        gadget_corpus_file_t *f = &corpus->files[i];
+        if (!f->scanned) continue;
+
+        f->first_gadget = corpus->gadgets->count;
+        f->gadget_count = results[i]->count;
+        if (!gadget_list_extend(corpus->gadgets, results[i], 0)) ok = false;
+        corpus->scanned++;
+        corpus->bytes_scanned += f->size;
+        gadget_list_destroy(results[i]);
+    }
+
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        gadget_corpus_file_t *f = &corpus->files[i];
+        if (f->duplicate_of != CORPUS_NOT_DUPLICATE) {
+            const gadget_corpus_file_t *orig = &corpus->files[f->duplicate_of];
+            f->skipped = orig->skipped;
+            f->content_hash = orig->content_hash;
+            f->first_gadget = orig->first_gadget;
+            f->gadget_count = orig->gadget_count;
+            corpus->duplicates++;
+        } else if (f->skipped) {
+            corpus->skipped++;
+        }
+    }
+
+    printf("[+] Scanned %u files (%lu bytes), %u duplicates, %u skipped\n",
+           corpus->scanned, corpus->bytes_scanned, corpus->duplicates, corpus->skipped);
+    printf("[+] Found %u potential LVI gadgets\n", corpus->gadgets->count);
+
+    free(refs);
+    free(results);
+    free(seen);
+    return ok;
+}
+
+static void csv_write_path(FILE *fp, const char *path) {
+    fputc('"', fp);
+    for (const char *p = path; *p; p++) {
+        if (*p == '"') fputc('"', fp);
+        fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+bool gadget_corpus_write_csv(const gadget_corpus_t *corpus, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "[-] Failed to open batch output: %s\n", path);
+        return false;
+    }
+
+    fprintf(fp, "path,duplicate_of,address,file_offset,type,length,bytes,disassembly\n");
+
+    const gadget_list_t *list = corpus->gadgets;
+    for (uint32_t i = 0; i < corpus->file_count; i++) {
+        const gadget_corpus_file_t *f = &corpus->files[i];
+        if (f->skipped) continue;
+
+        for (uint32_t g = f->first_gadget; g < f->first_gadget + f->gadget_count; g++) {
+            const gadget_code_t *code = &list->code[g];
+            char disassembly[256];
+            gadget_list_disassemble(list, g, disassembly, sizeof(disassembly));
+
+            csv_write_path(fp, f->path);
+            fputc(',', fp);
+            if (f->duplicate_of != CORPUS_NOT_DUPLICATE) {
+                csv_write_path(fp, corpus->files[f->duplicate_of].path);
+            }
+            fprintf(fp, ",0x%lx,0x%lx,%s,%u,", list->addresses[g], code->file_offset,
+                    gadget_type_name((gadget_type_t)list->types[g]), code->length);
+            for (uint32_t b = 0; b < code->length; b++) {
+                fprintf(fp, "%02x", code->bytes[b]);
+            }
+            fprintf(fp, ",\"%s\"\n", disassembly);
+        }
+    }
+
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0) ok = false;
+    return ok;
+}
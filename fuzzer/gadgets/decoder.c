@@ -0,0 +1,669 @@
+#include "decoder.h"
+#include <stdio.h>
+#include <string.h>
+
+#define M    0x01   // ModRM follows
+#define I8   0x02
+#define I16  0x04
+#define I32  0x08
+#define IZ   0x10   // 16 or 32 bits by operand size
+#define IV   0x20   // 16, 32 or 64 bits by operand size
+#define MO   0x40   // moffs: 32 or 64 bits by address size
+#define X    0x80   // invalid in 64-bit mode
+#define G3   (M | 0x100)    // F6/F7: immediate only for /0 and /1
+
+// Prefixes, REX, VEX/EVEX and the 0F escape are consumed before these tables
+// are consulted; their entries are unused.
+static const uint16_t primary_flags[256] = {
+    /* 00 */ M,    M,    M,    M,    I8,   IZ,   X,    X,    M,    M,    M,    M,    I8,   IZ,   X,    0,
+    /* 10 */ M,    M,    M,    M,    I8,   IZ,   X,    X,    M,    M,    M,    M,    I8,   IZ,   X,    X,
+    /* 20 */ M,    M,    M,    M,    I8,   IZ,   0,    X,    M,    M,    M,    M,    I8,   IZ,   0,    X,
+    /* 30 */ M,    M,    M,    M,    I8,   IZ,   0,    X,    M,    M,    M,    M,    I8,   IZ,   0,    X,
+    /* 40 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* 50 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* 60 */ X,    X,    X,    M,    0,    0,    0,    0,    IZ,   M|IZ, I8,   M|I8, 0,    0,    0,    0,
+    /* 70 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,
+    /* 80 */ M|I8, M|IZ, X,    M|I8, M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 90 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    X,    0,    0,    0,    0,    0,
+    /* A0 */ MO,   MO,   MO,   MO,   0,    0,    0,    0,    I8,   IZ,   0,    0,    0,    0,    0,    0,
+    /* B0 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   IV,   IV,   IV,   IV,   IV,   IV,   IV,   IV,
+    /* C0 */ M|I8, M|I8, I16,  0,    X,    X,    M|I8, M|IZ, I16|I8, 0,  I16,  0,    0,    I8,   X,    0,
+    /* D0 */ M,    M,    M,    M,    X,    X,    X,    0,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* E0 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I32,  I32,  X,    I8,   0,    0,    0,    0,
+    /* F0 */ 0,    0,    0,    0,    0,    0,    G3,   G3,   0,    0,    0,    0,    0,    0,    M,    M,
+};
+
+static const uint16_t secondary_flags[256] = {
+    /* 00 */ M,    M,    M,    M,    X,    0,    0,    0,    0,    0,    X,    0,    X,    M,    0,    M|I8,
+    /* 10 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 20 */ M,    M,    M,    M,    X,    X,    X,    X,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 30 */ 0,    0,    0,    0,    0,    0,    X,    0,    0,    X,    0,    X,    X,    X,    X,    X,
+    /* 40 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 50 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 60 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 70 */ M|I8, M|I8, M|I8, M|I8, M,    M,    M,    0,    M,    M,    X,    X,    M,    M,    M,    M,
+    /* 80 */ I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,  I32,
+    /* 90 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* A0 */ 0,    0,    0,    M,    M|I8, M,    X,    X,    0,    0,    0,    M,    M|I8, M,    M,    M,
+    /* B0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M|I8, M,    M,    M,    M,    M,
+    /* C0 */ M,    M,    M|I8, M,    M|I8, M|I8, M|I8, M,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* D0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* E0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* F0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+};
+
+static bool is_legacy_prefix(uint8_t b) {
+    switch (b) {
+        case 0xF0: case 0xF2: case 0xF3:
+        case 0x2E: case 0x36: case 0x3E: case 0x26: case 0x64: case 0x65:
+        case 0x66: case 0x67:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t immediate_size(const x86_insn_t *insn, uint16_t flags) {
+    bool rex_w = insn->rex & 0x08;
+    uint32_t size = 0;
+
+    if (flags & I8) size += 1;
+    if (flags & I16) size += 2;
+    if (flags & I32) size += 4;
+    if (flags & IZ) size += insn->opsize && !rex_w ? 2 : 4;
+    if (flags & IV) size += rex_w ? 8 : (insn->opsize ? 2 : 4);
+    if (flags & MO) size += insn->addrsize ? 4 : 8;
+    if (flags == G3 && ((insn->modrm >> 3) & 7) < 2) {
+        size += (insn->opcode == 0xF6) ? 1 : (insn->opsize && !rex_w ? 2 : 4);
+    }
+
+    return size;
+}
+
+// VEX (C4/C5) and EVEX (62) carry REX, the implied prefix and the opcode map
+// in their payload; every opcode has a ModRM byte except vzeroupper/vzeroall.
+static bool decode_vex(const uint8_t *code, size_t avail, uint32_t *pos, x86_insn_t *insn,
+                       uint16_t *flags) {
+    uint8_t lead = code[*pos];
+    uint32_t payload = (lead == 0xC5) ? 1 : (lead == 0xC4) ? 2 : 3;
+    if (*pos + payload + 1 >= avail) return false;
+
+    const uint8_t *p = &code[*pos + 1];
+    uint32_t map;
+    uint8_t pp;
+
+    if (lead == 0xC5) {
+        map = 1;
+        pp = p[0] & 3;
+        insn->rex = 0x40 | ((~p[0] >> 5) & 0x04);
+    } else {
+        map = (lead == 0xC4) ? (p[0] & 0x1F) : (p[0] & 0x07);
+        pp = p[1] & 3;
+        insn->rex = 0x40 | ((~p[0] >> 5) & 0x07) | ((p[1] >> 4) & 0x08);
+    }
+
+    insn->vex = true;
+    insn->opsize = (pp == 1);
+    insn->rep = (pp == 2) ? 0xF3 : (pp == 3) ? 0xF2 : 0;
+    *pos += payload + 1;
+    insn->opcode_offset = (uint8_t)*pos;
+    insn->opcode = code[*pos];
+
+    switch (map) {
+        case 1:
+            insn->map = X86_MAP_0F;
+            *flags = (insn->opcode == 0x77) ? 0 : (uint16_t)(M | (secondary_flags[insn->opcode] & I8));
+            return true;
+        case 2:
+        case 5:     // EVEX FP16 maps have the 0F38 layout: ModRM, no immediate
+        case 6:
+            if (map != 2 && lead != 0x62) return false;
+            insn->map = X86_MAP_0F38;
+            *flags = M;
+            return true;
+        case 3:
+            insn->map = X86_MAP_0F3A;
+            *flags = M | I8;
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t x86_decode(const uint8_t *code, size_t avail, x86_insn_t *insn) {
+    memset(insn, 0, sizeof(*insn));
+    if (avail > X86_MAX_INSN_LENGTH) avail = X86_MAX_INSN_LENGTH;
+
+    uint32_t pos = 0;
+    uint16_t flags;
+
+    // A REX byte only counts directly before the opcode.
+    while (pos < avail) {
+        uint8_t b = code[pos];
+        if (is_legacy_prefix(b)) {
+            if (b == 0x66) insn->opsize = true;
+            else if (b == 0x67) insn->addrsize = true;
+            else if (b == 0xF2 || b == 0xF3) insn->rep = b;
+            else if (b == 0x64 || b == 0x65) insn->segment = b;
+            insn->rex = 0;
+        } else if ((b & 0xF0) == 0x40) {
+            insn->rex = b;
+        } else {
+            break;
+        }
+        pos++;
+    }
+    if (pos >= avail) return 0;
+
+    uint8_t b = code[pos];
+    if (b == 0xC4 || b == 0xC5 || b == 0x62) {
+        if (insn->rex || insn->rep || insn->opsize) return 0;
+        if (!decode_vex(code, avail, &pos, insn, &flags)) return 0;
+    } else if (b == 0x0F) {
+        insn->opcode_offset = (uint8_t)pos;
+        if (++pos >= avail) return 0;
+        b = code[pos];
+        if (b == 0x38 || b == 0x3A) {
+            insn->map = (b == 0x38) ? X86_MAP_0F38 : X86_MAP_0F3A;
+            flags = (b == 0x38) ? M : (M | I8);
+            if (++pos >= avail) return 0;
+            insn->opcode = code[pos];
+        } else {
+            insn->map = X86_MAP_0F;
+            insn->opcode = b;
+            flags = secondary_flags[b];
+        }
+    } else {
+        insn->opcode_offset = (uint8_t)pos;
+        insn->map = X86_MAP_PRIMARY;
+        insn->opcode = b;
+        flags = primary_flags[b];
+    }
+
+    if (flags & X) return 0;
+    pos++;
+
+    if (flags & M) {
+        if (pos >= avail) return 0;
+        insn->has_modrm = true;
+        insn->modrm = code[pos++];
+
+        uint8_t mod = insn->modrm >> 6;
+        uint8_t rm = insn->modrm & 7;
+        if (mod != 3) {
+            if (rm == 4) {
+                if (pos >= avail) return 0;
+                insn->has_sib = true;
+                insn->sib = code[pos++];
+            }
+            if (mod == 1) insn->disp_size = 1;
+            else if (mod == 2) insn->disp_size = 4;
+            else if (rm == 5 || (insn->has_sib && (insn->sib & 7) == 5)) insn->disp_size = 4;
+        }
+    }
+
+    if (pos + insn->disp_size > avail) return 0;
+    if (insn->disp_size == 1) {
+        insn->disp = (int8_t)code[pos];
+    } else if (insn->disp_size == 4) {
+        int32_t d;
+        memcpy(&d, &code[pos], 4);
+        insn->disp = d;
+    }
+    pos += insn->disp_size;
+
+    uint32_t imm_size = immediate_size(insn, flags);
+    if (pos + imm_size > avail) return 0;
+    insn->imm_size = (uint8_t)imm_size;
+    for (uint32_t i = 0; i < imm_size && i < 8; i++) {
+        insn->imm |= (uint64_t)code[pos + i] << (8 * i);
+    }
+    pos += imm_size;
+
+    insn->length = (uint8_t)pos;
+    return pos;
+}
+
+// 1: legacy prefix, 2: operand size, 3: REX.
+static const uint8_t prefix_kind[256] = {
+    [0x26] = 1, [0x2E] = 1, [0x36] = 1, [0x3E] = 1, [0x64] = 1, [0x65] = 1,
+    [0x67] = 1, [0xF0] = 1, [0xF2] = 1, [0xF3] = 1, [0x66] = 2,
+    [0x40] = 3, [0x41] = 3, [0x42] = 3, [0x43] = 3, [0x44] = 3, [0x45] = 3, [0x46] = 3,
+    [0x47] = 3, [0x48] = 3, [0x49] = 3, [0x4A] = 3, [0x4B] = 3, [0x4C] = 3, [0x4D] = 3,
+    [0x4E] = 3, [0x4F] = 3
+};
+
+// ModRM plus the SIB and displacement bytes it implies, except the disp32
+// of a SIB with base 5 under mod 0, which depends on the SIB byte.
+#define MODRM_ROW(mod) \
+    MODRM_ENTRY(mod, 0), MODRM_ENTRY(mod, 1), MODRM_ENTRY(mod, 2), MODRM_ENTRY(mod, 3), \
+    MODRM_ENTRY(mod, 4), MODRM_ENTRY(mod, 5), MODRM_ENTRY(mod, 6), MODRM_ENTRY(mod, 7)
+#define MODRM_ENTRY(mod, rm) \
+    ((mod) == 3 ? 1 : 1 + ((rm) == 4) + ((mod) == 1 ? 1 : (mod) == 2 || (rm) == 5 ? 4 : 0))
+#define MODRM_MOD(mod) MODRM_ROW(mod), MODRM_ROW(mod), MODRM_ROW(mod), MODRM_ROW(mod), \
+                       MODRM_ROW(mod), MODRM_ROW(mod), MODRM_ROW(mod), MODRM_ROW(mod)
+
+static const uint8_t modrm_size[256] = {
+    MODRM_MOD(0), MODRM_MOD(1), MODRM_MOD(2), MODRM_MOD(3)
+};
+
+#undef MODRM_MOD
+#undef MODRM_ENTRY
+#undef MODRM_ROW
+
+bool x86_is_prefix(uint8_t byte) {
+    return prefix_kind[byte] != 0;
+}
+
+static uint32_t slow_length(const uint8_t *code, size_t avail, uint32_t *opcode_offset,
+                            bool *memory) {
+    x86_insn_t insn;
+    uint32_t length = x86_decode(code, avail, &insn);
+    *opcode_offset = insn.opcode_offset;
+    *memory = length && x86_accesses_memory(&insn);
+    return length;
+}
+
+uint32_t x86_length(const uint8_t *code, size_t avail, uint32_t *opcode_offset, bool *memory) {
+    // The fast path reads a few bytes past the 15-byte limit and lets the
+    // final length check reject what x86_decode would have.
+    if (avail < 2 * X86_MAX_INSN_LENGTH) return slow_length(code, avail, opcode_offset, memory);
+
+    uint32_t pos = 0;
+    bool opsize = false;
+    uint8_t rex = 0;
+    uint8_t kind;
+    while ((kind = prefix_kind[code[pos]]) != 0) {
+        opsize |= (kind == 2);
+        rex = (kind == 3) ? code[pos] : 0;
+        if (++pos == X86_MAX_INSN_LENGTH) return 0;
+    }
+
+    uint8_t op = code[pos];
+    bool primary = (op != 0x0F);
+    uint16_t flags;
+    *opcode_offset = pos;
+    if (primary) {
+        // VEX/EVEX leads are marked invalid in the table; moffs and group 3
+        // immediates need more than the opcode.
+        if (op == 0xC4 || op == 0xC5 || op == 0x62 || (primary_flags[op] & (MO | 0x100))) {
+            return slow_length(code, avail, opcode_offset, memory);
+        }
+        flags = primary_flags[op];
+    } else {
+        if (++pos == X86_MAX_INSN_LENGTH) return 0;
+        op = code[pos];
+        if (op == 0x38 || op == 0x3A) return slow_length(code, avail, opcode_offset, memory);
+        flags = secondary_flags[op];
+    }
+    if (flags & X) return 0;
+    pos++;
+
+    // Sized with arithmetic rather than branches: on arbitrary bytes every
+    // one of these tests is a coin flip for the branch predictor.
+    uint32_t has_modrm = flags & M;
+    uint8_t modrm = code[pos];
+    uint32_t mem_operand = has_modrm & ((modrm >> 6) != 3);
+    uint32_t sib_base5 = ((modrm & 0xC7) == 0x04) & ((code[pos + 1] & 7) == 5);
+    pos += has_modrm * (modrm_size[modrm] + 4 * sib_base5);
+    *memory = mem_operand & !(primary & (op == 0x8D));
+
+    uint32_t rex_w = (rex >> 3) & 1;
+    uint32_t imm_z = 4 - 2 * (opsize & !rex_w);
+    uint32_t imm_v = rex_w ? 8 : 4 - 2 * opsize;
+    pos += ((flags >> 1) & 1) + ((flags >> 2) & 1) * 2 + ((flags >> 3) & 1) * 4 +
+           ((flags >> 4) & 1) * imm_z + ((flags >> 5) & 1) * imm_v;
+
+    return (pos <= X86_MAX_INSN_LENGTH) ? pos : 0;
+}
+
+bool x86_accesses_memory(const x86_insn_t *insn) {
+    if (!insn->has_modrm || (insn->modrm >> 6) == 3) return false;
+    return !(insn->map == X86_MAP_PRIMARY && insn->opcode == 0x8D);
+}
+
+typedef enum {
+    OP_NONE,
+    OP_EB, OP_EW, OP_ED, OP_EV, OP_EQ, OP_MEM,  // ModRM r/m
+    OP_GB, OP_GV,                               // ModRM reg
+    OP_VX, OP_WX,                               // xmm reg, xmm r/m
+    OP_AL, OP_RAX,
+    OP_ZQ,                                      // register in the opcode, 64-bit
+    OP_IMM,
+    OP_REL
+} operand_t;
+
+typedef struct {
+    const char *mnemonic;
+    operand_t ops[3];
+    uint8_t xmm_bits;           // memory width for OP_WX
+} insn_form_t;
+
+static const char *const alu_names[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+static const char *const group3_names[8] = { "test", "test", "not", "neg", "mul", "imul", "div", "idiv" };
+static const char *const group5_names[8] = { "inc", "dec", "call", "call far", "jmp", "jmp far",
+                                             "push", NULL };
+static const char *const cc_names[16] = { "o", "no", "b", "ae", "e", "ne", "be", "a",
+                                          "s", "ns", "p", "np", "l", "ge", "le", "g" };
+
+static const char *const reg64[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                       "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+static const char *const reg32[16] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                       "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
+static const char *const reg16[16] = { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+                                       "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" };
+static const char *const reg8[16] = { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+                                      "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" };
+static const char *const reg8_legacy[8] = { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" };
+static const char *const xmm_regs[16] = { "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                                          "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15" };
+
+static bool describe(const x86_insn_t *insn, insn_form_t *form, char *name, size_t name_size) {
+    uint8_t op = insn->opcode;
+    uint8_t reg = (insn->modrm >> 3) & 7;
+    memset(form, 0, sizeof(*form));
+
+    if (insn->vex) return false;
+
+    if (insn->map == X86_MAP_PRIMARY) {
+        if (op < 0x40 && (op & 7) < 6) {
+            static const operand_t alu_forms[6][2] = {
+                { OP_EB, OP_GB }, { OP_EV, OP_GV }, { OP_GB, OP_EB },
+                { OP_GV, OP_EV }, { OP_AL, OP_IMM }, { OP_RAX, OP_IMM }
+            };
+            *form = (insn_form_t){ alu_names[op >> 3], { alu_forms[op & 7][0], alu_forms[op & 7][1] }, 0 };
+            return true;
+        }
+        if (op >= 0x50 && op <= 0x5F) {
+            *form = (insn_form_t){ op < 0x58 ? "push" : "pop", { OP_ZQ }, 0 };
+            return true;
+        }
+        if (op >= 0x70 && op <= 0x7F) {
+            snprintf(name, name_size, "j%s", cc_names[op & 15]);
+            *form = (insn_form_t){ name, { OP_REL }, 0 };
+            return true;
+        }
+        switch (op) {
+            case 0x63: *form = (insn_form_t){ "movsxd", { OP_GV, OP_ED }, 0 }; return true;
+            case 0x69:
+            case 0x6B: *form = (insn_form_t){ "imul", { OP_GV, OP_EV, OP_IMM }, 0 }; return true;
+            case 0x80: *form = (insn_form_t){ alu_names[reg], { OP_EB, OP_IMM }, 0 }; return true;
+            case 0x81:
+            case 0x83: *form = (insn_form_t){ alu_names[reg], { OP_EV, OP_IMM }, 0 }; return true;
+            case 0x84: *form = (insn_form_t){ "test", { OP_EB, OP_GB }, 0 }; return true;
+            case 0x85: *form = (insn_form_t){ "test", { OP_EV, OP_GV }, 0 }; return true;
+            case 0x86: *form = (insn_form_t){ "xchg", { OP_EB, OP_GB }, 0 }; return true;
+            case 0x87: *form = (insn_form_t){ "xchg", { OP_EV, OP_GV }, 0 }; return true;
+            case 0x88: *form = (insn_form_t){ "mov", { OP_EB, OP_GB }, 0 }; return true;
+            case 0x89: *form = (insn_form_t){ "mov", { OP_EV, OP_GV }, 0 }; return true;
+            case 0x8A: *form = (insn_form_t){ "mov", { OP_GB, OP_EB }, 0 }; return true;
+            case 0x8B: *form = (insn_form_t){ "mov", { OP_GV, OP_EV }, 0 }; return true;
+            case 0x8D: *form = (insn_form_t){ "lea", { OP_GV, OP_MEM }, 0 }; return true;
+            case 0x90: *form = (insn_form_t){ "nop", { OP_NONE }, 0 }; return true;
+            case 0xC3: *form = (insn_form_t){ "ret", { OP_NONE }, 0 }; return true;
+            case 0xC6: *form = (insn_form_t){ "mov", { OP_EB, OP_IMM }, 0 }; return true;
+            case 0xC7: *form = (insn_form_t){ "mov", { OP_EV, OP_IMM }, 0 }; return true;
+            case 0xCC: *form = (insn_form_t){ "int3", { OP_NONE }, 0 }; return true;
+            case 0xE8: *form = (insn_form_t){ "call", { OP_REL }, 0 }; return true;
+            case 0xE9:
+            case 0xEB: *form = (insn_form_t){ "jmp", { OP_REL }, 0 }; return true;
+            case 0xF6: *form = (insn_form_t){ group3_names[reg], { OP_EB, reg < 2 ? OP_IMM : OP_NONE }, 0 }; return true;
+            case 0xF7: *form = (insn_form_t){ group3_names[reg], { OP_EV, reg < 2 ? OP_IMM : OP_NONE }, 0 }; return true;
+            case 0xFE:
+                if (reg > 1) return false;
+                *form = (insn_form_t){ group5_names[reg], { OP_EB }, 0 };
+                return true;
+            case 0xFF:
+                if (!group5_names[reg]) return false;
+                *form = (insn_form_t){ group5_names[reg], { (reg >= 2 && reg != 3 && reg != 5) ? OP_EQ : OP_EV }, 0 };
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if (insn->map == X86_MAP_0F) {
+        if (op >= 0x40 && op <= 0x4F) {
+            snprintf(name, name_size, "cmov%s", cc_names[op & 15]);
+            *form = (insn_form_t){ name, { OP_GV, OP_EV }, 0 };
+            return true;
+        }
+        if (op >= 0x80 && op <= 0x8F) {
+            snprintf(name, name_size, "j%s", cc_names[op & 15]);
+            *form = (insn_form_t){ name, { OP_REL }, 0 };
+            return true;
+        }
+        switch (op) {
+            case 0x05: *form = (insn_form_t){ "syscall", { OP_NONE }, 0 }; return true;
+            case 0x0B: *form = (insn_form_t){ "ud2", { OP_NONE }, 0 }; return true;
+            case 0x10:
+            case 0x11: {
+                const char *mn = insn->rep == 0xF3 ? "movss" : insn->rep == 0xF2 ? "movsd" :
+                                 insn->opsize ? "movupd" : "movups";
+                uint8_t bits = insn->rep == 0xF3 ? 32 : insn->rep == 0xF2 ? 64 : 128;
+                *form = (insn_form_t){ mn, { op == 0x10 ? OP_VX : OP_WX, op == 0x10 ? OP_WX : OP_VX }, bits };
+                return true;
+            }
+            case 0x1F: *form = (insn_form_t){ "nop", { OP_EV }, 0 }; return true;
+            case 0x28:
+            case 0x29:
+                if (insn->rep) return false;
+                *form = (insn_form_t){ insn->opsize ? "movapd" : "movaps",
+                                       { op == 0x28 ? OP_VX : OP_WX, op == 0x28 ? OP_WX : OP_VX }, 128 };
+                return true;
+            case 0x31: *form = (insn_form_t){ "rdtsc", { OP_NONE }, 0 }; return true;
+            case 0xA2: *form = (insn_form_t){ "cpuid", { OP_NONE }, 0 }; return true;
+            case 0xAE:
+                if ((insn->modrm >> 6) == 3 && reg >= 5) {
+                    static const char *const fences[3] = { "lfence", "mfence", "sfence" };
+                    *form = (insn_form_t){ fences[reg - 5], { OP_NONE }, 0 };
+                    return true;
+                }
+                if ((insn->modrm >> 6) != 3 && reg == 7) {
+                    *form = (insn_form_t){ "clflush", { OP_MEM }, 0 };
+                    return true;
+                }
+                return false;
+            case 0xAF: *form = (insn_form_t){ "imul", { OP_GV, OP_EV }, 0 }; return true;
+            case 0xB6: *form = (insn_form_t){ "movzx", { OP_GV, OP_EB }, 0 }; return true;
+            case 0xB7: *form = (insn_form_t){ "movzx", { OP_GV, OP_EW }, 0 }; return true;
+            case 0xBE: *form = (insn_form_t){ "movsx", { OP_GV, OP_EB }, 0 }; return true;
+            case 0xBF: *form = (insn_form_t){ "movsx", { OP_GV, OP_EW }, 0 }; return true;
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t operand_bits(const x86_insn_t *insn) {
+    if (insn->rex & 0x08) return 64;
+    return insn->opsize ? 16 : 32;
+}
+
+static const char* gpr_name(const x86_insn_t *insn, uint32_t index, uint32_t bits) {
+    switch (bits) {
+        case 8:  return insn->rex ? reg8[index] : (index < 8 ? reg8_legacy[index] : reg8[index]);
+        case 16: return reg16[index];
+        case 32: return reg32[index];
+        default: return reg64[index];
+    }
+}
+
+static const char* size_keyword(uint32_t bits) {
+    switch (bits) {
+        case 8:   return "byte ";
+        case 16:  return "word ";
+        case 32:  return "dword ";
+        case 64:  return "qword ";
+        case 128: return "xmmword ";
+        default:  return "";
+    }
+}
+
+// Bounded string builder for the formatter; output is truncated, never overrun.
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} text_t;
+
+static void put_char(text_t *t, char c) {
+    if (t->len + 1 < t->size) t->buf[t->len++] = c;
+}
+
+static void put_str(text_t *t, const char *s) {
+    while (*s) put_char(t, *s++);
+}
+
+static void put_hex(text_t *t, uint64_t v) {
+    static const char digits[] = "0123456789abcdef";
+    char tmp[16];
+    int n = 0;
+
+    do {
+        tmp[n++] = digits[v & 15];
+        v >>= 4;
+    } while (v);
+
+    put_str(t, "0x");
+    while (n) put_char(t, tmp[--n]);
+}
+
+static void put_signed_hex(text_t *t, int64_t v, bool explicit_plus) {
+    if (v < 0) put_char(t, '-');
+    else if (explicit_plus) put_char(t, '+');
+    put_hex(t, v < 0 ? 0 - (uint64_t)v : (uint64_t)v);
+}
+
+static void format_memory(const x86_insn_t *insn, uint32_t bits, text_t *t) {
+    const char *const *addr_regs = insn->addrsize ? reg32 : reg64;
+    uint8_t mod = insn->modrm >> 6;
+    uint8_t rm = insn->modrm & 7;
+    bool empty = false;
+
+    put_str(t, size_keyword(bits));
+    if (insn->segment == 0x64) put_str(t, "fs:");
+    else if (insn->segment == 0x65) put_str(t, "gs:");
+    put_char(t, '[');
+
+    if (!insn->has_sib && mod == 0 && rm == 5) {
+        put_str(t, "rip");
+    } else if (insn->has_sib) {
+        uint8_t base = (insn->sib & 7) | ((insn->rex & 0x01) << 3);
+        uint8_t index = ((insn->sib >> 3) & 7) | ((insn->rex & 0x02) << 2);
+        bool no_base = (mod == 0 && (insn->sib & 7) == 5);
+
+        if (!no_base) put_str(t, addr_regs[base]);
+        if (index != 4) {
+            if (!no_base) put_char(t, '+');
+            put_str(t, addr_regs[index]);
+            put_char(t, '*');
+            put_char(t, (char)('0' + (1 << (insn->sib >> 6))));
+        }
+        empty = no_base && index == 4;
+    } else {
+        put_str(t, addr_regs[rm | ((insn->rex & 0x01) << 3)]);
+    }
+
+    if (insn->disp_size) {
+        if (empty) put_hex(t, (uint32_t)insn->disp);
+        else put_signed_hex(t, insn->disp, true);
+    }
+    put_char(t, ']');
+}
+
+static void format_operand(const x86_insn_t *insn, const insn_form_t *form, operand_t op,
+                           uint64_t address, text_t *t) {
+    uint32_t reg = ((insn->modrm >> 3) & 7) | ((insn->rex & 0x04) << 1);
+    uint32_t rm = (insn->modrm & 7) | ((insn->rex & 0x01) << 3);
+    bool is_reg = (insn->modrm >> 6) == 3;
+    uint32_t bits = 0;
+
+    switch (op) {
+        case OP_EB:  bits = 8; break;
+        case OP_EW:  bits = 16; break;
+        case OP_ED:  bits = 32; break;
+        case OP_EV:  bits = operand_bits(insn); break;
+        case OP_EQ:  bits = 64; break;
+        case OP_MEM: format_memory(insn, 0, t); return;
+        case OP_GB:  put_str(t, gpr_name(insn, reg, 8)); return;
+        case OP_GV:  put_str(t, gpr_name(insn, reg, operand_bits(insn))); return;
+        case OP_VX:  put_str(t, xmm_regs[reg]); return;
+        case OP_WX:
+            if (is_reg) put_str(t, xmm_regs[rm]);
+            else format_memory(insn, form->xmm_bits, t);
+            return;
+        case OP_AL:  put_str(t, "al"); return;
+        case OP_RAX: put_str(t, gpr_name(insn, 0, operand_bits(insn))); return;
+        case OP_ZQ:  put_str(t, reg64[(insn->opcode & 7) | ((insn->rex & 0x01) << 3)]); return;
+        case OP_IMM: {
+            int64_t imm = (insn->imm_size == 1) ? (int8_t)insn->imm :
+                          (insn->imm_size == 2) ? (int16_t)insn->imm :
+                          (insn->imm_size == 4) ? (int32_t)insn->imm : (int64_t)insn->imm;
+            put_signed_hex(t, imm, false);
+            return;
+        }
+        case OP_REL: {
+            int64_t rel = (insn->imm_size == 1) ? (int8_t)insn->imm : (int32_t)insn->imm;
+            put_hex(t, address + insn->length + rel);
+            return;
+        }
+        default:
+            return;
+    }
+
+    if (is_reg) put_str(t, gpr_name(insn, rm, bits));
+    else format_memory(insn, bits, t);
+}
+
+uint32_t x86_memory_bits(const x86_insn_t *insn) {
+    insn_form_t form;
+    char name[16];
+
+    if (!x86_accesses_memory(insn) || !describe(insn, &form, name, sizeof(name))) return 0;
+
+    for (uint32_t i = 0; i < 3; i++) {
+        switch (form.ops[i]) {
+            case OP_EB: return 8;
+            case OP_EW: return 16;
+            case OP_ED: return 32;
+            case OP_EV: return operand_bits(insn);
+            case OP_EQ: return 64;
+            case OP_WX: return form.xmm_bits;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+void x86_format(const x86_insn_t *insn, uint64_t address, char *buf, size_t size) {
+    static const char *const map_names[4] = { "", "0f ", "0f 38 ", "0f 3a " };
+    static const char digits[] = "0123456789abcdef";
+    text_t t = { buf, size, 0 };
+    insn_form_t form;
+    char name[16];
+
+    if (size == 0) return;
+
+    if (!describe(insn, &form, name, sizeof(name))) {
+        put_char(&t, '(');
+        if (insn->vex) put_str(&t, "vex ");
+        put_str(&t, map_names[insn->map]);
+        put_char(&t, digits[insn->opcode >> 4]);
+        put_char(&t, digits[insn->opcode & 15]);
+        put_char(&t, ')');
+        if (insn->has_modrm && (insn->modrm >> 6) != 3) {
+            put_char(&t, ' ');
+            format_memory(insn, 0, &t);
+        }
+    } else {
+        put_str(&t, form.mnemonic);
+        for (uint32_t i = 0; i < 3 && form.ops[i] != OP_NONE; i++) {
+            put_str(&t, i == 0 ? " " : ", ");
+            format_operand(insn, &form, form.ops[i], address, &t);
+        }
+    }
+    buf[t.len] = '\0';
+}
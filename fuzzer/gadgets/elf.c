@@ -0,0 +1,144 @@
+#include "gadgets.h"
+#include <string.h>
+#include <elf.h>
+
+static bool elf_header_valid(const uint8_t *data, size_t size, Elf64_Ehdr *ehdr) {
+    if (size < sizeof(Elf64_Ehdr)) return false;
+
+    memcpy(ehdr, data, sizeof(Elf64_Ehdr));
+
+    return memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0 &&
+           ehdr->e_ident[EI_CLASS] == ELFCLASS64 &&
+           ehdr->e_ident[EI_DATA] == ELFDATA2LSB;
+}
+
+static bool range_in_file(uint64_t offset, uint64_t length, size_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+static uint32_t regions_from_sections(const uint8_t *data, size_t size,
+                                      const Elf64_Ehdr *ehdr,
+                                      exec_region_t *regions, uint32_t max_regions) {
+    if (ehdr->e_shoff == 0 || ehdr->e_shnum == 0 ||
+        ehdr->e_shentsize < sizeof(Elf64_Shdr) ||
+        !range_in_file(ehdr->e_shoff, (uint64_t)ehdr->e_shnum * ehdr->e_shentsize, size)) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < ehdr->e_shnum && count < max_regions; i++) {
+        Elf64_Shdr shdr;
+        memcpy(&shdr, data + ehdr->e_shoff + (uint64_t)i * ehdr->e_shentsize, sizeof(shdr));
+
+        if (shdr.sh_type != SHT_PROGBITS || !(shdr.sh_flags & SHF_EXECINSTR)) continue;
+        if (shdr.sh_size == 0 || !range_in_file(shdr.sh_offset, shdr.sh_size, size)) continue;
+
+        regions[count].file_offset = shdr.sh_offset;
+        regions[count].vaddr = shdr.sh_addr;
+        regions[count].size = shdr.sh_size;
+        count++;
+    }
+
+    return count;
+}
+
+static uint32_t regions_from_segments(const uint8_t *data, size_t size,
+                                      const Elf64_Ehdr *ehdr,
+                                      exec_region_t *regions, uint32_t max_regions) {
+    if (ehdr->e_phoff == 0 || ehdr->e_phnum == 0 ||
+        ehdr->e_phentsize < sizeof(Elf64_Phdr) ||
+        !range_in_file(ehdr->e_phoff, (uint64_t)ehdr->e_phnum * ehdr->e_phentsize, size)) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < ehdr->e_phnum && count < max_regions; i++) {
+        Elf64_Phdr phdr;
+        memcpy(&phdr, data + ehdr->e_phoff + (uint64_t)i * ehdr->e_phentsize, sizeof(phdr));
+
+        if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X)) continue;
+        if (phdr.p_filesz == 0 || !range_in_file(phdr.p_offset, phdr.p_filesz, size)) continue;
+
+        regions[count].file_offset = phdr.p_offset;
+        regions[count].vaddr = phdr.p_vaddr;
+        regions[count].size = phdr.p_filesz;
+        count++;
+    }
+
+    return count;
+}
+
+uint32_t elf_exec_regions(const uint8_t *data, size_t size,
+                          exec_region_t *regions, uint32_t max_regions) {
+    Elf64_Ehdr ehdr;
+    if (!elf_header_valid(data, size, &ehdr)) return 0;
+
+    // Executable sections are tighter than PF_X segments, which may also
+    // cover headers and read-only data; segments are the fallback for
+    // binaries with stripped section headers.
+    uint32_t count = regions_from_sections(data, size, &ehdr, regions, max_regions);
+    if (count == 0) {
+        count = regions_from_segments(data, size, &ehdr, regions, max_regions);
+    }
+
+    return count;
+}
+
+static uint32_t build_id_from_notes(const uint8_t *data, size_t size, uint64_t offset,
+                                    uint64_t length, uint8_t *id, uint32_t max_length) {
+    if (!range_in_file(offset, length, size)) return 0;
+
+    uint64_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= length) {
+        Elf64_Nhdr nhdr;
+        memcpy(&nhdr, data + offset + pos, sizeof(nhdr));
+        pos += sizeof(nhdr);
+
+        uint64_t name_size = ((uint64_t)nhdr.n_namesz + 3) & ~3ULL;
+        uint64_t desc_size = ((uint64_t)nhdr.n_descsz + 3) & ~3ULL;
+        if (name_size > length - pos || desc_size > length - pos - name_size) return 0;
+
+        if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 &&
+            memcmp(data + offset + pos, "GNU", 4) == 0 &&
+            nhdr.n_descsz > 0 && nhdr.n_descsz <= max_length) {
+            memcpy(id, data + offset + pos + name_size, nhdr.n_descsz);
+            return nhdr.n_descsz;
+        }
+        pos += name_size + desc_size;
+    }
+
+    return 0;
+}
+
+uint32_t elf_build_id(const uint8_t *data, size_t size, uint8_t *id, uint32_t max_length) {
+    Elf64_Ehdr ehdr;
+    if (!elf_header_valid(data, size, &ehdr)) return 0;
+
+    if (ehdr.e_phoff != 0 && ehdr.e_phentsize >= sizeof(Elf64_Phdr) &&
+        range_in_file(ehdr.e_phoff, (uint64_t)ehdr.e_phnum * ehdr.e_phentsize, size)) {
+        for (uint16_t i = 0; i < ehdr.e_phnum; i++) {
+            Elf64_Phdr phdr;
+            memcpy(&phdr, data + ehdr.e_phoff + (uint64_t)i * ehdr.e_phentsize, sizeof(phdr));
+            if (phdr.p_type != PT_NOTE) continue;
+
+            uint32_t n = build_id_from_notes(data, size, phdr.p_offset, phdr.p_filesz,
+                                             id, max_length);
+            if (n) return n;
+        }
+    }
+
+    if (ehdr.e_shoff != 0 && ehdr.e_shentsize >= sizeof(Elf64_Shdr) &&
+        range_in_file(ehdr.e_shoff, (uint64_t)ehdr.e_shnum * ehdr.e_shentsize, size)) {
+        for (uint16_t i = 0; i < ehdr.e_shnum; i++) {
+            Elf64_Shdr shdr;
+            memcpy(&shdr, data + ehdr.e_shoff + (uint64_t)i * ehdr.e_shentsize, sizeof(shdr));
+            if (shdr.sh_type != SHT_NOTE) continue;
+
+            uint32_t n = build_id_from_notes(data, size, shdr.sh_offset, shdr.sh_size,
+                                             id, max_length);
+            if (n) return n;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include "gadget_index.h"
+#include "signatures.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INDEX_DIR_SUFFIX "lvi-dma-fuzzer/gadgets"
+
+bool gadget_index_key(const binary_image_t *image, bool raw, gadget_index_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    if (!image->data) return false;
+
+    uint32_t sig_count;
+    const gadget_signature_t *sigs = signature_builtin_table(&sig_count);
+
+    key->raw = raw;
+    key->file_size = image->size;
+    key->signatures = signature_table_fingerprint(sigs, sig_count);
+    key->id_length = elf_build_id(image->data, image->size, key->id, GADGET_INDEX_MAX_ID);
+
+    if (key->id_length > 0) {
+        key->build_id = true;
+        return true;
+    }
+
+    uint64_t h = hash_bytes(image->data, image->size, 0);
+    memcpy(key->id, &h, sizeof(h));
+    key->id_length = sizeof(h);
+    key->mtime_ns = image->mtime_ns;
+    return true;
+}
+
+bool gadget_index_default_dir(char *buf, size_t size) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+
+    if (xdg && xdg[0] == '/') {
+        n = snprintf(buf, size, "%s/" INDEX_DIR_SUFFIX, xdg);
+    } else if (home && home[0]) {
+        n = snprintf(buf, size, "%s/.cache/" INDEX_DIR_SUFFIX, home);
+    } else {
+        return false;
+    }
+
+    return n > 0 && (size_t)n < size;
+}
+
+bool gadget_index_path(const char *dir, const gadget_index_key_t *key, char *path, size_t size) {
+    char default_dir[512];
+    char id_hex[2 * GADGET_INDEX_MAX_ID + 1];
+
+    if (!dir) {
+        if (!gadget_index_default_dir(default_dir, sizeof(default_dir))) return false;
+        dir = default_dir;
+    }
+
+    for (uint32_t i = 0; i < key->id_length; i++) {
+        snprintf(&id_hex[2 * i], 3, "%02x", key->id[i]);
+    }
+    id_hex[2 * key->id_length] = '\0';
+
+    // The name carries only the binary's identity, so a rebuilt signature
+    // table or scanner overwrites the stale entry instead of adding one.
+    int n = snprintf(path, size, "%s/%s%s.gidx", dir, id_hex, key->raw ? "-raw" : "");
+    return n > 0 && (size_t)n < size;
+}
+
+static void header_from_key(const gadget_index_key_t *key, gadget_index_header_t *header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, GADGET_INDEX_MAGIC, sizeof(GADGET_INDEX_MAGIC));
+    header->version = GADGET_INDEX_VERSION;
+    memcpy(header->id, key->id, key->id_length);
+    header->id_length = key->id_length;
+    header->flags = (key->build_id ? GADGET_INDEX_BUILD_ID : 0) |
+                    (key->raw ? GADGET_INDEX_RAW : 0);
+    header->file_size = key->file_size;
+    header->mtime_ns = key->mtime_ns;
+    header->signatures = key->signatures;
+}
+
+static uint64_t index_payload_size(uint32_t count) {
+    return (uint64_t)count * (sizeof(uint64_t) + sizeof(double) +
+                              sizeof(gadget_code_t) + sizeof(uint8_t));
+}
+
+static uint64_t index_checksum(const gadget_list_t *list, uint32_t first) {
+    uint32_t n = list->count - first;
+    uint64_t h = hash_bytes(&list->addresses[first], n * sizeof(uint64_t), n);
+    h = hash_bytes(&list->scores[first], n * sizeof(double), h);
+    h = hash_bytes(&list->code[first], n * sizeof(gadget_code_t), h);
+    return hash_bytes(&list->types[first], n * sizeof(uint8_t), h);
+}
+
+bool gadget_index_load(const char *path, const gadget_index_key_t *key, gadget_list_t *results) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(gadget_index_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    gadget_index_header_t expected;
+    header_from_key(key, &expected);
+
+    const gadget_index_header_t *header = map;
+    const uint8_t *payload = (const uint8_t*)map + sizeof(gadget_index_header_t);
+    uint32_t n = header->count;
+    bool ok = false;
+
+    expected.count = n;
+    expected.checksum = header->checksum;
+
+    if (memcmp(header, &expected, sizeof(expected)) == 0 &&
+        (uint64_t)st.st_size == sizeof(gadget_index_header_t) + index_payload_size(n)) {
+        // A read-only view of the mapped arrays; nothing is written through it.
+        gadget_list_t view = {
+            .addresses = (uint64_t*)payload,
+            .scores = (double*)(payload + (size_t)n * sizeof(uint64_t)),
+            .code = (gadget_code_t*)(payload + (size_t)n * (sizeof(uint64_t) + sizeof(double))),
+            .types = (uint8_t*)(payload + (size_t)n * (sizeof(uint64_t) + sizeof(double) +
+                                                       sizeof(gadget_code_t))),
+            .count = n,
+            .capacity = n
+        };
+        ok = index_checksum(&view, 0) == header->checksum &&
+             gadget_list_extend(results, &view, 0);
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return ok;
+}
+
+static bool make_dirs(const char *path) {
+    char buf[1024];
+    int n = snprintf(buf, sizeof(buf), "%s", path);
+    if (n <= 0 || (size_t)n >= sizeof(buf)) return false;
+
+    char *slash = strrchr(buf, '/');
+    if (!slash || slash == buf) return true;
+    *slash = '\0';
+
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return false;
+        *p = '/';
+    }
+    return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+bool gadget_index_store(const char *path, const gadget_index_key_t *key,
+                        const gadget_list_t *list, uint32_t first) {
+    if (first > list->count || !make_dirs(path)) return false;
+
+    char tmp[1024];
+    int len = snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    if (len <= 0 || (size_t)len >= sizeof(tmp)) return false;
+
+    // A unique name per call: --batch threads may store the same key at once.
+    int fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0) return false;
+    if (fchmod(fd, 0644) != 0) {
+        close(fd);
+        unlink(tmp);
+        return false;
+    }
+
+    uint32_t n = list->count - first;
+    gadget_index_header_t header;
+    header_from_key(key, &header);
+    header.count = n;
+    header.checksum = index_checksum(list, first);
+
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, &list->addresses[first], n * sizeof(uint64_t)) &&
+              write_all(fd, &list->scores[first], n * sizeof(double)) &&
+              write_all(fd, &list->code[first], n * sizeof(gadget_code_t)) &&
+              write_all(fd, &list->types[first], n * sizeof(uint8_t));
+
+    if (close(fd) != 0) ok = false;
+
+    // Readers only ever see a complete file.
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) unlink(tmp);
+    return ok;
+}
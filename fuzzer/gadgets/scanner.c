@@ -1,18 +1,47 @@
+#define _GNU_SOURCE
 #include "gadgets.h"
+#include "signatures.h"
+#include "decoder.h"
+#include "gadget_index.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+static bool gadget_list_reserve(gadget_list_t *list, uint32_t capacity) {
+    if (capacity <= list->capacity) return true;
+
+    // Arrays that grew before a failure simply keep the extra room.
+    uint64_t *addresses = realloc(list->addresses, capacity * sizeof(uint64_t));
+    if (!addresses) return false;
+    list->addresses = addresses;
+
+    uint8_t *types = realloc(list->types, capacity * sizeof(uint8_t));
+    if (!types) return false;
+    list->types = types;
+
+    double *scores = realloc(list->scores, capacity * sizeof(double));
+    if (!scores) return false;
+    list->scores = scores;
+
+    gadget_code_t *code = realloc(list->code, capacity * sizeof(gadget_code_t));
+    if (!code) return false;
+    list->code = code;
+
+    list->capacity = capacity;
+    return true;
+}
 
 gadget_list_t* gadget_list_create(void) {
     gadget_list_t *list = calloc(1, sizeof(gadget_list_t));
     if (!list) return NULL;
 
-    list->capacity = 256;
-    list->gadgets = calloc(list->capacity, sizeof(gadget_t));
-    list->count = 0;
-
-    if (!list->gadgets) {
-        free(list);
+    if (!gadget_list_reserve(list, 256)) {
+        gadget_list_destroy(list);
         return NULL;
     }
 
@@ -21,125 +50,664 @@ gadget_list_t* gadget_list_create(void) {
 
 void gadget_list_destroy(gadget_list_t *list) {
     if (list) {
-        free(list->gadgets);
+        free(list->addresses);
+        free(list->types);
+        free(list->scores);
+        free(list->code);
         free(list);
     }
 }
 
-bool gadget_list_add(gadget_list_t *list, gadget_t *gadget) {
-    if (list->count >= list->capacity) {
-        uint32_t new_capacity = list->capacity * 2;
-        gadget_t *new_gadgets = realloc(list->gadgets,
-                                         new_capacity * sizeof(gadget_t));
-        if (!new_gadgets) return false;
-
-        list->gadgets = new_gadgets;
-        list->capacity = new_capacity;
+bool gadget_list_append(gadget_list_t *list, uint64_t address, gadget_type_t type,
+                        double score, uint64_t file_offset,
+                        const uint8_t *bytes, uint32_t length) {
+    if (list->count >= list->capacity &&
+        !gadget_list_reserve(list, list->capacity ? list->capacity * 2 : 256)) {
+        return false;
     }
 
-    memcpy(&list->gadgets[list->count++], gadget, sizeof(gadget_t));
+    if (length > X86_MAX_INSN_LENGTH) length = X86_MAX_INSN_LENGTH;
+
+    uint32_t i = list->count++;
+    list->addresses[i] = address;
+    list->types[i] = (uint8_t)type;
+    list->scores[i] = score;
+
+    gadget_code_t *code = &list->code[i];
+    memset(code, 0, sizeof(*code));
+    code->file_offset = file_offset;
+    code->length = (uint8_t)length;
+    memcpy(code->bytes, bytes, length);
+    return true;
+}
+
+bool gadget_list_add(gadget_list_t *list, const gadget_t *gadget) {
+    return gadget_list_append(list, gadget->address, gadget->type,
+                              gadget->exploitability_score, gadget->file_offset,
+                              gadget->instructions, gadget->length);
+}
+
+bool gadget_list_extend(gadget_list_t *list, const gadget_list_t *src, uint32_t first) {
+    if (first >= src->count) return true;
+
+    uint32_t n = src->count - first;
+    uint32_t capacity = list->capacity ? list->capacity : 256;
+    while (capacity < list->count + n) capacity *= 2;
+    if (!gadget_list_reserve(list, capacity)) return false;
+
+    memcpy(&list->addresses[list->count], &src->addresses[first], n * sizeof(uint64_t));
+    memcpy(&list->types[list->count], &src->types[first], n * sizeof(uint8_t));
+    memcpy(&list->scores[list->count], &src->scores[first], n * sizeof(double));
+    memcpy(&list->code[list->count], &src->code[first], n * sizeof(gadget_code_t));
+    list->count += n;
     return true;
 }
 
+void gadget_list_disassemble(const gadget_list_t *list, uint32_t index,
+                             char *buf, size_t size) {
+    const gadget_code_t *code = &list->code[index];
+    x86_insn_t insn;
+
+    if (size == 0) return;
+    if (x86_decode(code->bytes, code->length, &insn) != code->length) {
+        snprintf(buf, size, "(bad)");
+        return;
+    }
+    x86_format(&insn, list->addresses[index], buf, size);
+}
+
+void gadget_list_get(const gadget_list_t *list, uint32_t index, gadget_t *gadget) {
+    const gadget_code_t *code = &list->code[index];
+
+    memset(gadget, 0, sizeof(*gadget));
+    gadget->address = list->addresses[index];
+    gadget->file_offset = code->file_offset;
+    gadget->length = code->length;
+    gadget->type = (gadget_type_t)list->types[index];
+    gadget->exploitability_score = list->scores[index];
+    memcpy(gadget->instructions, code->bytes, code->length);
+    gadget_list_disassemble(list, index, gadget->disassembly, sizeof(gadget->disassembly));
+}
+
 bool gadget_is_lvi_susceptible(const uint8_t *code, uint32_t length) {
-    if (length < 2) return false;
+    const signature_set_t *set = signature_set_builtin();
+    if (!set) return false;
+
+    for (uint32_t offset = 0; offset < length; ) {
+        x86_insn_t insn;
+        uint32_t insn_length = x86_decode(&code[offset], length - offset, &insn);
+        if (insn_length == 0) {
+            offset++;
+            continue;
+        }
 
-    for (uint32_t i = 0; i < length - 1; i++) {
-        if ((code[i] & 0xF8) == 0x48) {
-            if ((code[i+1] & 0xC7) == 0x87) {
-                return true;
-            }
+        gadget_type_t type;
+        if (x86_accesses_memory(&insn) &&
+            signature_match_at(set, &code[offset], insn_length, insn.opcode_offset, &type)) {
+            return true;
+        }
+        offset += insn_length;
+    }
 
-            if ((code[i+1] & 0xC7) == 0x03 ||
-                (code[i+1] & 0xC7) == 0x0B ||
-                (code[i+1] & 0xC7) == 0x13 ||
-                (code[i+1] & 0xC7) == 0x1B) {
-                return true;
-            }
+    return false;
+}
+
+// Prefilter: bit i of a block is set when a match can start at base + i,
+// i.e. mem[base + i] is in the signature set's first bytes and the byte
+// after it in its second bytes. Blocks are 64 bytes, aligned to the region.
+#define PREFILTER_BLOCK 64
+
+typedef struct {
+    const signature_set_t *set;
+    const uint8_t *mem;
+    size_t size;
+    size_t base;                // last classified block
+    uint64_t bits;
+} prefilter_t;
+
+static void prefilter_init(prefilter_t *pf, const signature_set_t *set,
+                           const uint8_t *mem, size_t size) {
+    pf->set = set;
+    pf->mem = mem;
+    pf->size = size;
+    pf->base = SIZE_MAX;
+}
+
+#if defined(__AVX2__)
+
+#define PREFILTER_VEC 32
+
+static inline __m256i byte_set_match(__m256i v, const signature_byte_set_t *set) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i bit_of = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->low));
+    __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->high));
+
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low_table, lo),
+                                     _mm256_shuffle_epi8(high_table, lo),
+                                     _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(7)));
+    __m256i bit = _mm256_shuffle_epi8(bit_of, hi);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+}
+
+static inline uint64_t classify_vec(const signature_set_t *set, const uint8_t *p) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    __m256i y = _mm256_loadu_si256((const __m256i *)(p + 1));
+    __m256i hit = _mm256_and_si256(byte_set_match(x, &set->first),
+                                   byte_set_match(y, &set->second));
+    return (uint32_t)_mm256_movemask_epi8(hit);
+}
+
+#elif defined(__SSSE3__)
+
+#define PREFILTER_VEC 16
+
+static inline __m128i byte_set_match(__m128i v, const signature_byte_set_t *set) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i bit_of = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i low_table = _mm_loadu_si128((const __m128i *)set->low);
+    __m128i high_table = _mm_loadu_si128((const __m128i *)set->high);
+
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i upper = _mm_cmpgt_epi8(hi, _mm_set1_epi8(7));
+    __m128i row = _mm_or_si128(_mm_andnot_si128(upper, _mm_shuffle_epi8(low_table, lo)),
+                               _mm_and_si128(upper, _mm_shuffle_epi8(high_table, lo)));
+    __m128i bit = _mm_shuffle_epi8(bit_of, hi);
+    return _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+}
+
+static inline uint64_t classify_vec(const signature_set_t *set, const uint8_t *p) {
+    __m128i x = _mm_loadu_si128((const __m128i *)p);
+    __m128i y = _mm_loadu_si128((const __m128i *)(p + 1));
+    __m128i hit = _mm_and_si128(byte_set_match(x, &set->first),
+                                byte_set_match(y, &set->second));
+    return (uint32_t)_mm_movemask_epi8(hit);
+}
+
+#else
+
+#define PREFILTER_VEC 0
+
+#endif
+
+static uint64_t classify_block(const prefilter_t *pf, size_t base) {
+    const signature_set_t *set = pf->set;
+    const uint8_t *mem = pf->mem;
+    uint64_t bits = 0;
+    size_t i = 0;
+
+#if PREFILTER_VEC
+    // The vector loads read one byte past the block.
+    for (; i < PREFILTER_BLOCK && base + i + PREFILTER_VEC + 1 <= pf->size; i += PREFILTER_VEC) {
+        bits |= classify_vec(set, mem + base + i) << i;
+    }
+#endif
+
+    // A match in the last byte could only be one byte long.
+    for (; i < PREFILTER_BLOCK && base + i < pf->size; i++) {
+        size_t p = base + i;
+        bool hit = signature_byte_set_has(&set->first, mem[p]) &&
+                   (p + 1 == pf->size || signature_byte_set_has(&set->second, mem[p + 1]));
+        bits |= (uint64_t)hit << i;
+    }
+
+    return bits;
+}
+
+static uint64_t prefilter_block(prefilter_t *pf, size_t base) {
+    if (pf->base != base) {
+        pf->bits = classify_block(pf, base);
+        pf->base = base;
+    }
+    return pf->bits;
+}
+
+// True if an instruction starting at q, or in the run of prefix bytes before
+// it, accesses memory and holds the match at m whole within its prefix and
+// opcode bytes.
+static bool match_held_from(const prefilter_t *pf, size_t q, size_t m) {
+    const uint8_t *mem = pf->mem;
+
+    for (size_t s = q;; s--) {
+        uint32_t opcode_offset;
+        bool memory;
+        uint32_t length = x86_length(&mem[s], pf->size - s, &opcode_offset, &memory);
+        gadget_type_t type;
+        if (length && memory && s + opcode_offset >= m &&
+            signature_match_at(pf->set, &mem[m], s + length - m, 0, &type)) {
+            return true;
         }
+        if (s == 0 || m - s == X86_MAX_INSN_LENGTH - 1 || !x86_is_prefix(mem[s - 1])) {
+            return false;
+        }
+    }
+}
+
+// A match can only be recorded for an instruction whose prefix and opcode
+// bytes reach it: one starting in the prefix run that ends at m, or at a
+// VEX/EVEX lead up to 4 bytes back (and its own prefix run).
+static bool match_reachable(const prefilter_t *pf, size_t m) {
+    if (match_held_from(pf, m, m)) return true;
 
-        if (code[i] == 0x0F) {
-            if (code[i+1] == 0xB6 || code[i+1] == 0xB7 ||
-                code[i+1] == 0xBE || code[i+1] == 0xBF) {
-                return true;
+    for (size_t j = 1; j <= 4 && j <= m; j++) {
+        uint8_t lead = pf->mem[m - j];
+        size_t vex = (lead == 0xC5) ? 2 : (lead == 0xC4) ? 3 : (lead == 0x62) ? 4 : 0;
+        if (j <= vex && match_held_from(pf, m - j, m)) return true;
+    }
+
+    return false;
+}
+
+// First offset in [from, limit) where a signature match could be recorded,
+// whatever the instruction boundaries, or SIZE_MAX.
+static size_t next_match(prefilter_t *pf, size_t from, size_t limit) {
+    if (limit > pf->size) limit = pf->size;
+
+    for (size_t base = from - from % PREFILTER_BLOCK; base < limit; base += PREFILTER_BLOCK) {
+        uint64_t bits = prefilter_block(pf, base);
+        if (base < from) bits &= ~0ULL << (from - base);
+
+        while (bits) {
+            size_t p = base + __builtin_ctzll(bits);
+            if (p >= limit) return SIZE_MAX;
+
+            const uint8_t *code = &pf->mem[p];
+            size_t avail = pf->size - p;
+            bool pair = (avail == 1) || signature_pair_set_has(&pf->set->pairs, code[0], code[1]);
+            gadget_type_t type;
+            if (pair &&
+                signature_match_at(pf->set, code,
+                                   avail < SIGNATURE_MAX_LENGTH ? avail : SIGNATURE_MAX_LENGTH,
+                                   0, &type) &&
+                match_reachable(pf, p)) {
+                return p;
             }
+            bits &= bits - 1;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+static inline uint32_t insn_step(const uint8_t *mem, size_t size, size_t offset) {
+    uint32_t opcode_offset;
+    bool memory;
+    uint32_t length = x86_length(&mem[offset], size - offset, &opcode_offset, &memory);
+    return length ? length : 1;
+}
+
+// Instructions are at most 15 bytes, so a walk from any offset <= t visits
+// one of [t, t + 15). Walks from all 15 of them are advanced, lowest first,
+// until they meet; every earlier walk passes the meeting point. The live
+// walks always lie within 15 bytes of the lowest one, so bit i of alive
+// stands for offset base + i. Returns SIZE_MAX if they have not met by
+// limit.
+static size_t scan_resync(const uint8_t *mem, size_t size, size_t t, size_t limit) {
+    uint32_t alive = (1u << X86_MAX_INSN_LENGTH) - 1;
+    size_t base = t;
+
+    while (alive != 1) {
+        if (base >= limit) return SIZE_MAX;
+
+        alive = (alive & ~1u) | (1u << insn_step(mem, size, base));
+        uint32_t skip = __builtin_ctz(alive);
+        alive >>= skip;
+        base += skip;
+    }
+
+    return (base <= limit) ? base : SIZE_MAX;
+}
+
+// Decodes the instruction at offset and records it when it accesses memory
+// and a signature starts in its prefix/opcode bytes and ends inside it.
+// match is the first offset >= offset where one could be recorded; only
+// instructions whose prefix/opcode bytes reach it are fully decoded.
+// Returns the step to the next instruction: its length, or 1 to
+// resynchronise after an undecodable byte.
+static uint32_t scan_insn(const signature_set_t *set, const uint8_t *mem, size_t size,
+                          size_t offset, size_t match,
+                          uint64_t vaddr_base, uint64_t file_offset_base,
+                          gadget_list_t *results, uint32_t *gadget_count) {
+    uint32_t opcode_offset;
+    bool memory;
+    uint32_t length = x86_length(&mem[offset], size - offset, &opcode_offset, &memory);
+    if (length == 0) return 1;
+    if (!memory || match > offset + opcode_offset) return length;
+
+    x86_insn_t insn;
+    x86_decode(&mem[offset], size - offset, &insn);
+
+    gadget_type_t type;
+    if (signature_match_at(set, &mem[offset], length, insn.opcode_offset, &type)) {
+        if (gadget_list_append(results, vaddr_base + offset, type, gadget_score(&insn, type),
+                               file_offset_base + offset, &mem[offset], length)) {
+            (*gadget_count)++;
         }
+    }
 
-        if ((code[i] & 0xF0) == 0x40 && i < length - 2) {
-            if (code[i+1] == 0x8B || code[i+1] == 0x8A) {
-                return true;
+    return length;
+}
+
+// A resync starts SCAN_RESYNC_LEAD bytes before the earliest instruction
+// that can hold the next match, four times further back each time the
+// walks fail to meet in time. It is only tried when it skips at least
+// SCAN_SKIP_MIN bytes; closer matches are reached by walking.
+#define SCAN_RESYNC_LEAD 32
+#define SCAN_SKIP_MIN 32
+
+// Walks instructions starting in [from, end) and returns the start of the
+// first instruction at or past end. The first GADGET_SCAN_SYNC_POINTS
+// instruction starts are recorded in sync when it is non-NULL.
+//
+// Between matches nothing can be recorded, so long gaps are not walked:
+// the walk resyncs a little before the next match (or before end) and goes
+// on from there, with the same result as decoding every instruction.
+static size_t scan_range(const uint8_t *mem, size_t size, size_t from, size_t end,
+                         uint64_t vaddr_base, uint64_t file_offset_base,
+                         gadget_list_t *results, uint32_t *gadget_count,
+                         size_t *sync, uint32_t *sync_count) {
+    const signature_set_t *set = signature_set_builtin();
+    prefilter_t pf;
+    prefilter_init(&pf, set, mem, size);
+    // An instruction starting before end may hold a match just past it.
+    size_t limit = end + X86_MAX_INSN_LENGTH - 1;
+    size_t offset = from;
+    size_t match = next_match(&pf, offset, limit);
+
+    while (offset < end && sync && *sync_count < GADGET_SCAN_SYNC_POINTS) {
+        sync[(*sync_count)++] = offset;
+        if (match < offset) match = next_match(&pf, offset, limit);
+        offset += scan_insn(set, mem, size, offset, match, vaddr_base, file_offset_base,
+                            results, gadget_count);
+    }
+
+    while (offset < end) {
+        match = next_match(&pf, offset, limit);
+        size_t target = (match < end) ? match : end;
+
+        size_t first_start = target - (X86_MAX_INSN_LENGTH - 1);
+        for (size_t lead = SCAN_RESYNC_LEAD;
+             target >= offset + (X86_MAX_INSN_LENGTH - 1) + lead + SCAN_SKIP_MIN; lead *= 4) {
+            size_t resumed = scan_resync(mem, size, first_start - lead, first_start);
+            if (resumed != SIZE_MAX) {
+                offset = resumed;
+                break;
             }
         }
+
+        // No instruction starting 15 or more bytes before the match holds it.
+        while (offset + (X86_MAX_INSN_LENGTH - 1) < target) {
+            offset += insn_step(mem, size, offset);
+        }
+        while (offset <= target && offset < end) {
+            offset += scan_insn(set, mem, size, offset, match, vaddr_base, file_offset_base,
+                                results, gadget_count);
+        }
     }
 
-    return false;
+    return offset;
 }
 
-bool gadget_scan_memory_region(uint64_t start_addr, size_t size,
-                                gadget_list_t *results) {
+typedef struct {
+    const uint8_t *mem;
+    size_t size;
+    size_t begin;
+    size_t end;
+    size_t stop;                // where this chunk's walk ended
+    uint64_t vaddr_base;
+    uint64_t file_offset_base;
+    gadget_list_t *hits;
+    uint32_t hit_count;
+    size_t sync[GADGET_SCAN_SYNC_POINTS];
+    uint32_t sync_count;
+} scan_chunk_t;
+
+static void* scan_chunk_worker(void *arg) {
+    scan_chunk_t *c = (scan_chunk_t*)arg;
+    // The last instruction may run up to X86_MAX_INSN_LENGTH - 1 bytes into
+    // the next chunk.
+    c->stop = scan_range(c->mem, c->size, c->begin, c->end, c->vaddr_base,
+                         c->file_offset_base, c->hits, &c->hit_count,
+                         c->sync, &c->sync_count);
+    return NULL;
+}
 
-    printf("[*] Scanning memory region 0x%lx - 0x%lx\n",
-           start_addr, start_addr + size);
+static uint32_t scan_thread_count(uint32_t requested, size_t bytes) {
+    uint32_t threads = requested;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (uint32_t)online : 1;
+    }
+    if (threads > GADGET_SCAN_MAX_THREADS) threads = GADGET_SCAN_MAX_THREADS;
 
-    const uint8_t *mem = (const uint8_t *)start_addr;
+    size_t max_chunks = bytes / GADGET_SCAN_MIN_CHUNK;
+    if (max_chunks < 1) max_chunks = 1;
+    if (threads > max_chunks) threads = (uint32_t)max_chunks;
+
+    return threads;
+}
+
+// Appends chunk c's hits in address order. Every chunk but the first was
+// decoded from its first byte, which may be mid-instruction, so the walk
+// carried over from the previous chunk is continued serially until it lands
+// on one of the chunk's own instruction starts; from there on the two walks
+// are identical.
+static size_t merge_chunk(scan_chunk_t *c, size_t cursor, gadget_list_t *results,
+                          uint32_t *gadget_count) {
+    const signature_set_t *set = signature_set_builtin();
+    gadget_list_t *hits = c->hits;
+    uint32_t s = 0;
+    prefilter_t pf;
+    prefilter_init(&pf, set, c->mem, c->size);
+    size_t limit = c->end + X86_MAX_INSN_LENGTH - 1;
+    size_t match = next_match(&pf, cursor, limit);
+
+    while (cursor < c->end) {
+        while (s < c->sync_count && c->sync[s] < cursor) s++;
+
+        if (s < c->sync_count && c->sync[s] == cursor) {
+            uint32_t next = 0;
+            while (next < hits->count && hits->addresses[next] - c->vaddr_base < cursor) {
+                next++;
+            }
+            if (gadget_list_extend(results, hits, next)) {
+                *gadget_count += hits->count - next;
+            }
+            return c->stop;
+        }
+
+        if (match < cursor) match = next_match(&pf, cursor, limit);
+        cursor += scan_insn(set, c->mem, c->size, cursor, match, c->vaddr_base,
+                            c->file_offset_base, results, gadget_count);
+    }
+
+    return cursor;
+}
+
+uint32_t gadget_scan_window(const uint8_t *mem, size_t size, size_t end,
+                            uint64_t vaddr_base, uint64_t file_offset_base,
+                            uint32_t requested_threads, gadget_list_t *results, size_t *stop) {
     uint32_t gadget_count = 0;
+    size_t cursor = 0;
 
-    for (size_t offset = 0; offset < size - MAX_GADGET_LENGTH; offset++) {
-        if (gadget_is_lvi_susceptible(&mem[offset], MAX_GADGET_LENGTH)) {
-            gadget_t gadget = {0};
-            gadget.address = start_addr + offset;
-            gadget.length = 16;
-            gadget.type = GADGET_LOAD_FAULTING;
-            gadget.exploitability_score = 0.5;
+    if (end > size) end = size;
+    if (end == 0 || !signature_set_builtin()) {
+        if (stop) *stop = end;
+        return 0;
+    }
 
-            memcpy(gadget.instructions, &mem[offset],
-                   gadget.length > MAX_GADGET_LENGTH ? MAX_GADGET_LENGTH : gadget.length);
+    uint32_t threads = scan_thread_count(requested_threads, end);
+    scan_chunk_t *chunks = (threads > 1) ? calloc(threads, sizeof(scan_chunk_t)) : NULL;
 
-            snprintf(gadget.disassembly, sizeof(gadget.disassembly),
-                     "mov rax, [rbx+rcx*8] @ 0x%lx", gadget.address);
+    if (!chunks) {
+        cursor = scan_range(mem, size, 0, end, vaddr_base, file_offset_base, results,
+                            &gadget_count, NULL, NULL);
+        if (stop) *stop = cursor;
+        return gadget_count;
+    }
 
-            if (gadget_list_add(results, &gadget)) {
-                gadget_count++;
-            }
+    pthread_t tids[GADGET_SCAN_MAX_THREADS];
+    bool launched[GADGET_SCAN_MAX_THREADS] = {false};
+
+    for (uint32_t t = 0; t < threads; t++) {
+        chunks[t] = (scan_chunk_t){
+            .mem = mem,
+            .size = size,
+            .begin = end * t / threads,
+            .end = end * (t + 1) / threads,
+            .vaddr_base = vaddr_base,
+            .file_offset_base = file_offset_base,
+            .hits = (t == 0) ? results : gadget_list_create(),
+            .hit_count = 0
+        };
+    }
 
-            offset += 8;
+    // Chunk 0 starts where a serial scan would and writes straight into
+    // results; a chunk whose list could not be allocated is walked during
+    // the merge.
+    for (uint32_t t = 1; t < threads; t++) {
+        if (chunks[t].hits) {
+            launched[t] = (pthread_create(&tids[t], NULL, scan_chunk_worker, &chunks[t]) == 0);
         }
     }
 
+    cursor = scan_range(mem, size, 0, chunks[0].end, vaddr_base, file_offset_base,
+                        results, &gadget_count, NULL, NULL);
+
+    for (uint32_t t = 1; t < threads; t++) {
+        if (launched[t]) {
+            pthread_join(tids[t], NULL);
+            cursor = merge_chunk(&chunks[t], cursor, results, &gadget_count);
+        } else {
+            cursor = scan_range(mem, size, cursor, chunks[t].end, vaddr_base,
+                                file_offset_base, results, &gadget_count, NULL, NULL);
+        }
+        gadget_list_destroy(chunks[t].hits);
+    }
+
+    free(chunks);
+    if (stop) *stop = cursor;
+    return gadget_count;
+}
+
+static uint32_t scan_buffer(const uint8_t *mem, size_t size, uint64_t vaddr_base,
+                            uint64_t file_offset_base, uint32_t requested_threads,
+                            gadget_list_t *results) {
+    return gadget_scan_window(mem, size, size, vaddr_base, file_offset_base,
+                              requested_threads, results, NULL);
+}
+
+bool gadget_scan_memory_region_opts(uint64_t start_addr, size_t size,
+                                    const gadget_scan_options_t *opts,
+                                    gadget_list_t *results) {
+
+    printf("[*] Scanning memory region 0x%lx - 0x%lx\n",
+           start_addr, start_addr + size);
+
+    uint32_t gadget_count = scan_buffer((const uint8_t *)start_addr, size, start_addr, 0,
+                                        opts->threads, results);
+
     printf("[+] Found %u potential LVI gadgets\n", gadget_count);
     return gadget_count > 0;
 }
 
-bool gadget_scan_binary(const char *binary_path, gadget_list_t *results) {
-    FILE *f = fopen(binary_path, "rb");
-    if (!f) {
-        fprintf(stderr, "[-] Failed to open binary: %s\n", binary_path);
-        return false;
+bool gadget_scan_memory_region(uint64_t start_addr, size_t size,
+                                gadget_list_t *results) {
+    gadget_scan_options_t opts = {0};
+    return gadget_scan_memory_region_opts(start_addr, size, &opts, results);
+}
+
+bool gadget_scan_image(const binary_image_t *image, const char *label,
+                       const gadget_scan_options_t *opts, gadget_list_t *results) {
+    uint32_t first = results->count;
+    gadget_index_key_t key;
+    char index_path[1024];
+
+    exec_region_t regions[MAX_EXEC_REGIONS];
+    uint32_t region_count = opts->raw ? 0 :
+        elf_exec_regions(image->data, image->size, regions, MAX_EXEC_REGIONS);
+    if (region_count == 0 && opts->elf_only) return false;
+
+    bool use_index = !opts->no_index && gadget_index_key(image, opts->raw, &key) &&
+                     gadget_index_path(opts->index_dir, &key, index_path, sizeof(index_path));
+
+    if (use_index && gadget_index_load(index_path, &key, results)) {
+        uint32_t loaded = results->count - first;
+        if (!opts->quiet) {
+            printf("[+] Loaded %u gadgets from index %s\n", loaded, index_path);
+        }
+        return loaded > 0;
     }
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    // Non-ELF input (raw dumps, firmware) is scanned whole; addresses are then
+    // file offsets.
+    if (region_count == 0) {
+        regions[0].file_offset = 0;
+        regions[0].vaddr = 0;
+        regions[0].size = image->size;
+        region_count = 1;
+    }
 
-    uint8_t *buffer = malloc(size);
-    if (!buffer) {
-        fclose(f);
+    uint32_t gadget_count = 0;
+    uint64_t scanned = 0;
+    for (uint32_t i = 0; i < region_count; i++) {
+        gadget_count += scan_buffer(image->data + regions[i].file_offset, regions[i].size,
+                                    regions[i].vaddr, regions[i].file_offset, opts->threads,
+                                    results);
+        scanned += regions[i].size;
+    }
+
+    if (!opts->quiet) {
+        printf("[+] Scanned %lu of %zu bytes in %u region%s\n", scanned, image->size,
+               region_count, region_count == 1 ? "" : "s");
+        printf("[+] Found %u potential LVI gadgets\n", gadget_count);
+    }
+
+    if (use_index && !gadget_index_store(index_path, &key, results, first)) {
+        fprintf(stderr, "[-] Could not write gadget index %s for %s\n", index_path, label);
+    }
+
+    return gadget_count > 0;
+}
+
+bool gadget_scan_binary_opts(const char *binary_path, const gadget_scan_options_t *opts,
+                            gadget_list_t *results) {
+    struct stat st;
+    if (opts->stream_window > 0 ||
+        (stat(binary_path, &st) == 0 && S_ISREG(st.st_mode) &&
+         (uint64_t)st.st_size >= GADGET_STREAM_AUTO_SIZE)) {
+        return gadget_scan_stream(binary_path, opts, results);
+    }
+
+    binary_image_t image;
+    if (!binary_image_open(binary_path, opts->map_flags, &image)) {
+        fprintf(stderr, "[-] Failed to open binary: %s\n", binary_path);
         return false;
     }
 
-    fread(buffer, 1, size, f);
-    fclose(f);
+    if (!opts->quiet) {
+        printf("[*] Scanning binary: %s (%zu bytes, %s)\n", binary_path, image.size,
+               image.mapped ? "mmap" : "read");
+    }
 
-    printf("[*] Scanning binary: %s (%zu bytes)\n", binary_path, size);
+    bool found = gadget_scan_image(&image, binary_path, opts, results);
 
-    bool result = gadget_scan_memory_region((uint64_t)buffer, size, results);
+    binary_image_close(&image);
+    return found;
+}
 
-    free(buffer);
-    return result;
+bool gadget_scan_binary(const char *binary_path, gadget_list_t *results) {
+    gadget_scan_options_t opts = {0};
+    return gadget_scan_binary_opts(binary_path, &opts, results);
 }
 
-void gadget_print(gadget_t *gadget) {
-    const char *type_str[] = {
+const char* gadget_type_name(gadget_type_t type) {
+    static const char *const type_str[] = {
         "LOAD_FAULTING",
         "LOAD_ASSIST",
         "SPECULATIVE_STORE",
@@ -147,8 +715,14 @@ void gadget_print(gadget_t *gadget) {
         "UNKNOWN"
     };
 
-    printf("[Gadget @ 0x%016lx] Type: %s, Score: %.2f\n",
-           gadget->address, type_str[gadget->type], gadget->exploitability_score);
+    return (type <= GADGET_UNKNOWN) ? type_str[type] : type_str[GADGET_UNKNOWN];
+}
+
+void gadget_print(const gadget_t *gadget) {
+
+    printf("[Gadget @ 0x%016lx, file+0x%lx] Type: %s, Score: %.2f\n",
+           gadget->address, gadget->file_offset, gadget_type_name(gadget->type),
+           gadget->exploitability_score);
     printf("  Bytes: ");
     for (uint32_t i = 0; i < gadget->length && i < 16; i++) {
         printf("%02x ", gadget->instructions[i]);
@@ -162,7 +736,9 @@ void gadget_list_print(gadget_list_t *list) {
     printf("====================================\n");
 
     for (uint32_t i = 0; i < list->count && i < 10; i++) {
-        gadget_print(&list->gadgets[i]);
+        gadget_t gadget;
+        gadget_list_get(list, i, &gadget);
+        gadget_print(&gadget);
         printf("\n");
     }
 
@@ -0,0 +1,56 @@
+#include "gadgets.h"
+
+// Heuristic exploitability in (0, 1]: pattern class x load width x how much
+// of the address an injected register value controls.
+
+static double class_weight(gadget_type_t type) {
+    switch (type) {
+        case GADGET_LOAD_FAULTING:     return 1.0;
+        case GADGET_BRANCH_MISTRAIN:   return 0.9;   // injected value becomes a branch target
+        case GADGET_LOAD_ASSIST:       return 0.7;
+        case GADGET_SPECULATIVE_STORE: return 0.5;
+        default:                       return 0.2;
+    }
+}
+
+static double width_weight(uint32_t bits) {
+    if (bits >= 64) return 1.0;
+    if (bits == 32) return 0.85;
+    if (bits == 16) return 0.7;
+    if (bits == 8)  return 0.6;
+    return 0.75;
+}
+
+static double addressing_weight(const x86_insn_t *insn) {
+    uint8_t mod = insn->modrm >> 6;
+    uint8_t rm = insn->modrm & 7;
+
+    // rip-relative and absolute operands have no register to inject into.
+    if (!insn->has_sib && mod == 0 && rm == 5) return 0.35;
+
+    bool has_base = true;
+    bool has_index = false;
+    uint32_t scale = 1;
+    if (insn->has_sib) {
+        has_base = !(mod == 0 && (insn->sib & 7) == 5);
+        has_index = (((insn->sib >> 3) & 7) | ((insn->rex & 0x02) << 2)) != 4;
+        scale = 1u << (insn->sib >> 6);
+    }
+    if (!has_base && !has_index) return 0.3;
+
+    double w = 0.6;
+    if (has_index) w += 0.25;
+    if (scale > 1) w += 0.05;
+    if (has_base) w += 0.05;
+    if (insn->disp_size) w += 0.05;
+
+    // fs:/gs: operands are mostly TLS and stack-protector reads.
+    if (insn->segment) w *= 0.8;
+    return w;
+}
+
+double gadget_score(const x86_insn_t *insn, gadget_type_t type) {
+    double score = class_weight(type) * width_weight(x86_memory_bits(insn)) *
+                   addressing_weight(insn);
+    return score > 1.0 ? 1.0 : score;
+}
@@ -0,0 +1,426 @@
+#include "signatures.h"
+#include "hash.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const gadget_signature_t builtin_signatures[] = {
+    // Loads the scanner has always matched.
+    { "rex.w op&0xc7=0x87", GADGET_LOAD_FAULTING, 2, {0x48, 0x87}, {0xF8, 0xC7} },
+    { "rex.w alu r, r/m",   GADGET_LOAD_FAULTING, 2, {0x48, 0x03}, {0xF8, 0xC7} },
+    { "movzx/movsx",        GADGET_LOAD_FAULTING, 2, {0x0F, 0xB6}, {0xFF, 0xF6} },
+    { "rex mov r, r/m",     GADGET_LOAD_FAULTING, 3, {0x40, 0x8A, 0x00}, {0xF0, 0xFE, 0x00} },
+
+    // SSE loads: denormal and line-split operands take microcode assists.
+    { "movups/movss xmm, m", GADGET_LOAD_ASSIST, 3, {0x0F, 0x10, 0x00}, {0xFF, 0xFF, 0xC0} },
+    { "movups/movss xmm, m", GADGET_LOAD_ASSIST, 3, {0x0F, 0x10, 0x40}, {0xFF, 0xFF, 0xC0} },
+    { "movups/movss xmm, m", GADGET_LOAD_ASSIST, 3, {0x0F, 0x10, 0x80}, {0xFF, 0xFF, 0xC0} },
+    { "movaps xmm, m",       GADGET_LOAD_ASSIST, 3, {0x0F, 0x28, 0x00}, {0xFF, 0xFF, 0xC0} },
+    { "movaps xmm, m",       GADGET_LOAD_ASSIST, 3, {0x0F, 0x28, 0x40}, {0xFF, 0xFF, 0xC0} },
+    { "movaps xmm, m",       GADGET_LOAD_ASSIST, 3, {0x0F, 0x28, 0x80}, {0xFF, 0xFF, 0xC0} },
+
+    // 64-bit stores whose data a later load may forward.
+    { "rex.w mov m, r", GADGET_SPECULATIVE_STORE, 3, {0x48, 0x89, 0x00}, {0xF8, 0xFF, 0xC0} },
+    { "rex.w mov m, r", GADGET_SPECULATIVE_STORE, 3, {0x48, 0x89, 0x40}, {0xF8, 0xFF, 0xC0} },
+    { "rex.w mov m, r", GADGET_SPECULATIVE_STORE, 3, {0x48, 0x89, 0x80}, {0xF8, 0xFF, 0xC0} },
+
+    // Indirect call/jmp through memory: the target is an injectable load.
+    { "call [m]", GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0x10}, {0xFF, 0xF8} },
+    { "call [m]", GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0x50}, {0xFF, 0xF8} },
+    { "call [m]", GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0x90}, {0xFF, 0xF8} },
+    { "jmp [m]",  GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0x20}, {0xFF, 0xF8} },
+    { "jmp [m]",  GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0x60}, {0xFF, 0xF8} },
+    { "jmp [m]",  GADGET_BRANCH_MISTRAIN, 2, {0xFF, 0xA0}, {0xFF, 0xF8} },
+};
+
+#define BUILTIN_COUNT (sizeof(builtin_signatures) / sizeof(builtin_signatures[0]))
+
+static signature_set_t g_builtin;
+static bool g_builtin_ok;
+static pthread_once_t g_builtin_once = PTHREAD_ONCE_INIT;
+
+static uint32_t core_length(const gadget_signature_t *sig) {
+    uint32_t core = sig->length;
+    while (core > 0 && sig->mask[core - 1] == 0) core--;
+    return core;
+}
+
+// Groups the 256 byte values by which (mask, value) predicates they satisfy;
+// the automaton then only needs one column per group.
+static bool build_byte_classes(const gadget_signature_t *sigs, uint32_t count,
+                               signature_set_t *set, uint8_t pred_mask[],
+                               uint8_t pred_value[], uint32_t *pred_count,
+                               uint8_t *pred_of[]) {
+    uint32_t preds = 0;
+
+    for (uint32_t s = 0; s < count; s++) {
+        uint32_t core = core_length(&sigs[s]);
+        for (uint32_t i = 0; i < core; i++) {
+            uint8_t m = sigs[s].mask[i];
+            uint8_t v = sigs[s].value[i] & m;
+            uint32_t p = 0;
+            while (p < preds && (pred_mask[p] != m || pred_value[p] != v)) p++;
+            if (p == preds) {
+                if (preds == SIGNATURE_MAX_PREDICATES) return false;
+                pred_mask[preds] = m;
+                pred_value[preds] = v;
+                preds++;
+            }
+            pred_of[s][i] = (uint8_t)p;
+        }
+    }
+
+    uint64_t keys[256];
+    set->alphabet = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+        uint64_t key = 0;
+        for (uint32_t p = 0; p < preds; p++) {
+            if ((b & pred_mask[p]) == pred_value[p]) key |= 1ULL << p;
+        }
+
+        uint32_t c = 0;
+        while (c < set->alphabet && keys[c] != key) c++;
+        if (c == set->alphabet) keys[set->alphabet++] = key;
+        set->byte_class[b] = (uint8_t)c;
+    }
+
+    *pred_count = preds;
+    return true;
+}
+
+static void byte_set_add(signature_byte_set_t *set, uint8_t b) {
+    uint8_t *row = (b < 0x80) ? set->low : set->high;
+    row[b & 15] |= (uint8_t)(1u << ((b >> 4) & 7));
+}
+
+static bool predicate_has(const gadget_signature_t *sig, uint32_t i, uint32_t b) {
+    return (b & sig->mask[i]) == (sig->value[i] & sig->mask[i]);
+}
+
+// first comes from the root row of the finished automaton: a byte starts a
+// match exactly when it leaves the root. second is the union of the
+// signatures' second-byte predicates, or every byte if one has no second.
+// pairs holds each signature's (first, second) predicate pairs.
+static void build_lead_sets(const gadget_signature_t *sigs, uint32_t count,
+                            signature_set_t *set) {
+    memset(&set->first, 0, sizeof(set->first));
+    memset(&set->second, 0, sizeof(set->second));
+    memset(&set->pairs, 0, sizeof(set->pairs));
+
+    for (uint32_t s = 0; s < count; s++) {
+        bool any_second = core_length(&sigs[s]) < 2;
+        for (uint32_t a = 0; a < 256; a++) {
+            if (!predicate_has(&sigs[s], 0, a)) continue;
+            for (uint32_t b = 0; b < 256; b++) {
+                if (any_second || predicate_has(&sigs[s], 1, b)) {
+                    uint32_t pair = (a << 8) | b;
+                    set->pairs.bits[pair >> 6] |= 1ULL << (pair & 63);
+                }
+            }
+        }
+    }
+
+    for (uint32_t b = 0; b < 256; b++) {
+        if (set->next[set->byte_class[b]] != 0) byte_set_add(&set->first, (uint8_t)b);
+
+        for (uint32_t s = 0; s < count; s++) {
+            if (core_length(&sigs[s]) < 2 || predicate_has(&sigs[s], 1, b)) {
+                byte_set_add(&set->second, (uint8_t)b);
+                break;
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint32_t *child;        // trie edges, then the full transition table
+    uint32_t *fail;
+    uint32_t *order;        // non-root states in breadth-first order
+    uint32_t *own_state;    // (state, signature) for matches ending at a node
+    uint32_t *own_sig;
+    uint32_t *out_count;
+    uint32_t *renum;
+    uint32_t own_total;
+    uint32_t states;
+} automaton_build_t;
+
+static void build_free(automaton_build_t *b) {
+    free(b->child);
+    free(b->fail);
+    free(b->order);
+    free(b->own_state);
+    free(b->own_sig);
+    free(b->out_count);
+    free(b->renum);
+}
+
+// Trie over byte classes; a masked position fans out to every class that
+// satisfies its predicate.
+static bool build_trie(const gadget_signature_t *sigs, uint32_t count,
+                       const signature_set_t *set, const uint8_t pred_mask[],
+                       const uint8_t pred_value[], uint8_t *pred_of[],
+                       automaton_build_t *b) {
+    uint32_t a = set->alphabet;
+    uint8_t rep[256];
+    for (int v = 255; v >= 0; v--) rep[set->byte_class[v]] = (uint8_t)v;
+
+    uint32_t frontier[2][SIGNATURE_MAX_STATES];
+    b->states = 1;
+
+    for (uint32_t s = 0; s < count; s++) {
+        uint32_t *cur = frontier[0];
+        uint32_t *nxt = frontier[1];
+        uint32_t cur_count = 1;
+        cur[0] = 0;
+
+        for (uint32_t i = 0; i < core_length(&sigs[s]); i++) {
+            uint32_t p = pred_of[s][i];
+            uint32_t nxt_count = 0;
+            for (uint32_t f = 0; f < cur_count; f++) {
+                for (uint32_t c = 0; c < a; c++) {
+                    if ((rep[c] & pred_mask[p]) != pred_value[p]) continue;
+                    uint32_t *slot = &b->child[(size_t)cur[f] * a + c];
+                    if (*slot == 0) {
+                        if (b->states == SIGNATURE_MAX_STATES) return false;
+                        *slot = b->states++;
+                    }
+                    if (nxt_count == SIGNATURE_MAX_STATES) return false;
+                    nxt[nxt_count++] = *slot;
+                }
+            }
+            uint32_t *tmp = cur;
+            cur = nxt;
+            nxt = tmp;
+            cur_count = nxt_count;
+        }
+
+        for (uint32_t f = 0; f < cur_count; f++) {
+            if (b->own_total == SIGNATURE_MAX_STATES) return false;
+            b->own_state[b->own_total] = cur[f];
+            b->own_sig[b->own_total] = s;
+            b->own_total++;
+        }
+    }
+
+    return true;
+}
+
+// Breadth-first fail links; missing edges are filled in from the fail
+// state, whose row is already complete. Returns the number of non-root states.
+static uint32_t build_links(uint32_t a, automaton_build_t *b) {
+    uint32_t head = 0, tail = 0;
+
+    for (uint32_t c = 0; c < a; c++) {
+        uint32_t v = b->child[c];
+        if (v) {
+            b->fail[v] = 0;
+            b->order[tail++] = v;
+        }
+    }
+    while (head < tail) {
+        uint32_t u = b->order[head++];
+        for (uint32_t c = 0; c < a; c++) {
+            uint32_t *slot = &b->child[(size_t)u * a + c];
+            if (*slot) {
+                b->fail[*slot] = b->child[(size_t)b->fail[u] * a + c];
+                b->order[tail++] = *slot;
+            } else {
+                *slot = b->child[(size_t)b->fail[u] * a + c];
+            }
+        }
+    }
+
+    return tail;
+}
+
+bool signature_set_compile(const gadget_signature_t *sigs, uint32_t count,
+                           signature_set_t *set) {
+    memset(set, 0, sizeof(*set));
+    if (count == 0) return false;
+
+    automaton_build_t b = {0};
+    uint8_t pred_mask[SIGNATURE_MAX_PREDICATES];
+    uint8_t pred_value[SIGNATURE_MAX_PREDICATES];
+    uint32_t pred_count = 0;
+    uint8_t (*pred_rows)[SIGNATURE_MAX_LENGTH] = calloc(count, SIGNATURE_MAX_LENGTH);
+    uint8_t **pred_of = calloc(count, sizeof(uint8_t*));
+    uint8_t *sig_class = calloc(count, 1);
+    bool ok = false;
+
+    if (!pred_rows || !pred_of || !sig_class) goto out;
+
+    for (uint32_t s = 0; s < count; s++) {
+        uint32_t core = core_length(&sigs[s]);
+        if (sigs[s].length > SIGNATURE_MAX_LENGTH || core == 0) {
+            fprintf(stderr, "[-] Invalid signature: %s\n", sigs[s].name);
+            goto out;
+        }
+        pred_of[s] = pred_rows[s];
+
+        uint32_t c = 0;
+        while (c < set->class_count && (set->classes[c].span != sigs[s].length ||
+                                        set->classes[c].type != sigs[s].type)) {
+            c++;
+        }
+        if (c == set->class_count) {
+            if (c == SIGNATURE_MAX_CLASSES) {
+                fprintf(stderr, "[-] Too many signature classes\n");
+                goto out;
+            }
+            set->classes[c].span = sigs[s].length;
+            set->classes[c].type = sigs[s].type;
+            set->class_count++;
+        }
+        sig_class[s] = (uint8_t)c;
+    }
+
+    if (!build_byte_classes(sigs, count, set, pred_mask, pred_value, &pred_count, pred_of)) {
+        fprintf(stderr, "[-] Too many distinct signature byte predicates\n");
+        goto out;
+    }
+
+    uint32_t a = set->alphabet;
+    b.child = calloc((size_t)SIGNATURE_MAX_STATES * a, sizeof(uint32_t));
+    b.fail = calloc(SIGNATURE_MAX_STATES, sizeof(uint32_t));
+    b.order = malloc(SIGNATURE_MAX_STATES * sizeof(uint32_t));
+    b.own_state = malloc(SIGNATURE_MAX_STATES * sizeof(uint32_t));
+    b.own_sig = malloc(SIGNATURE_MAX_STATES * sizeof(uint32_t));
+    if (!b.child || !b.fail || !b.order || !b.own_state || !b.own_sig) goto out;
+
+    if (!build_trie(sigs, count, set, pred_mask, pred_value, pred_of, &b)) {
+        fprintf(stderr, "[-] Signature automaton exceeds %u states\n", SIGNATURE_MAX_STATES);
+        goto out;
+    }
+    uint32_t reachable = build_links(a, &b);
+    uint32_t states = b.states;
+
+    // Output lists: own matches plus everything the fail state reports.
+    b.out_count = calloc(states, sizeof(uint32_t));
+    b.renum = malloc(states * sizeof(uint32_t));
+    if (!b.out_count || !b.renum) goto out;
+    for (uint32_t o = 0; o < b.own_total; o++) b.out_count[b.own_state[o]]++;
+    for (uint32_t i = 0; i < reachable; i++) {
+        uint32_t v = b.order[i];
+        b.out_count[v] += b.out_count[b.fail[v]];
+    }
+
+    // Renumber so accepting states come last and the scan loop tests for
+    // output with one compare.
+    uint32_t next_id = 0;
+    for (uint32_t v = 0; v < states; v++) {
+        if (b.out_count[v] == 0) b.renum[v] = next_id++;
+    }
+    set->accept_row = next_id * a;
+    for (uint32_t v = 0; v < states; v++) {
+        if (b.out_count[v] != 0) b.renum[v] = next_id++;
+    }
+
+    set->states = states;
+    set->next = malloc((size_t)states * a * sizeof(uint32_t));
+    set->out_begin = calloc(states + 1, sizeof(uint32_t));
+    if (!set->next || !set->out_begin) goto out;
+
+    for (uint32_t v = 0; v < states; v++) {
+        for (uint32_t c = 0; c < a; c++) {
+            set->next[(size_t)b.renum[v] * a + c] = b.renum[b.child[(size_t)v * a + c]] * a;
+        }
+        set->out_begin[b.renum[v] + 1] = b.out_count[v];
+    }
+    for (uint32_t n = 0; n < states; n++) set->out_begin[n + 1] += set->out_begin[n];
+
+    set->outputs = malloc((set->out_begin[states] + 1) * sizeof(signature_output_t));
+    if (!set->outputs) goto out;
+
+    // Breadth-first, so a fail state's list is final before it is copied.
+    for (uint32_t i = 0; i < reachable; i++) {
+        uint32_t v = b.order[i];
+        signature_output_t *dst = &set->outputs[set->out_begin[b.renum[v]]];
+        uint32_t n = 0;
+        for (uint32_t o = 0; o < b.own_total; o++) {
+            if (b.own_state[o] != v) continue;
+            dst[n].core = (uint8_t)core_length(&sigs[b.own_sig[o]]);
+            dst[n].class_id = sig_class[b.own_sig[o]];
+            n++;
+        }
+        memcpy(&dst[n], &set->outputs[set->out_begin[b.renum[b.fail[v]]]],
+               b.out_count[b.fail[v]] * sizeof(signature_output_t));
+    }
+
+    build_lead_sets(sigs, count, set);
+    ok = true;
+
+out:
+    build_free(&b);
+    free(pred_rows);
+    free(pred_of);
+    free(sig_class);
+    if (!ok) signature_set_destroy(set);
+    return ok;
+}
+
+void signature_set_destroy(signature_set_t *set) {
+    free(set->next);
+    free(set->out_begin);
+    free(set->outputs);
+    set->next = NULL;
+    set->out_begin = NULL;
+    set->outputs = NULL;
+}
+
+static void compile_builtin(void) {
+    g_builtin_ok = signature_set_compile(builtin_signatures, BUILTIN_COUNT, &g_builtin);
+}
+
+const signature_set_t* signature_set_builtin(void) {
+    pthread_once(&g_builtin_once, compile_builtin);
+    return g_builtin_ok ? &g_builtin : NULL;
+}
+
+const gadget_signature_t* signature_builtin_table(uint32_t *count) {
+    *count = BUILTIN_COUNT;
+    return builtin_signatures;
+}
+
+uint64_t signature_table_fingerprint(const gadget_signature_t *sigs, uint32_t count) {
+    uint64_t h = hash_mix64(count);
+
+    // Names are cosmetic; only what changes matching is hashed.
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t entry[2 + 2 * SIGNATURE_MAX_LENGTH];
+        entry[0] = (uint8_t)sigs[i].type;
+        entry[1] = sigs[i].length;
+        memcpy(&entry[2], sigs[i].value, SIGNATURE_MAX_LENGTH);
+        memcpy(&entry[2 + SIGNATURE_MAX_LENGTH], sigs[i].mask, SIGNATURE_MAX_LENGTH);
+        h = hash_bytes(entry, sizeof(entry), h);
+    }
+
+    return h;
+}
+
+bool signature_match_at(const signature_set_t *set, const uint8_t *code, size_t length,
+                        size_t max_start, gadget_type_t *type) {
+    size_t best_start = SIZE_MAX;
+    uint32_t best_class = 0;
+    uint32_t row = 0;
+
+    for (size_t e = 0; e < length; e++) {
+        row = set->next[row + set->byte_class[code[e]]];
+        if (row < set->accept_row) continue;
+
+        uint32_t state = row / set->alphabet;
+        for (uint32_t o = set->out_begin[state]; o < set->out_begin[state + 1]; o++) {
+            const signature_output_t *out = &set->outputs[o];
+            size_t start = e + 1 - out->core;
+            if (start > max_start || start + set->classes[out->class_id].span > length) continue;
+            if (start < best_start || (start == best_start && out->class_id < best_class)) {
+                best_start = start;
+                best_class = out->class_id;
+            }
+        }
+    }
+
+    if (best_start == SIZE_MAX) return false;
+    *type = set->classes[best_class].type;
+    return true;
+}
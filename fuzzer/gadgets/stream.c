@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+#include "gadgets.h"
+#include "gadget_index.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Room in front of each window for the bytes carried over from the previous
+// one; a carried instruction is at most X86_MAX_INSN_LENGTH - 1 bytes.
+#define STREAM_CARRY MAX_GADGET_LENGTH
+#define STREAM_MIN_WINDOW 4096
+
+typedef struct {
+    uint8_t *buf;               // STREAM_CARRY + window bytes
+    size_t length;              // bytes read after the carry room
+    bool full;
+    bool last;
+    bool error;
+} stream_slot_t;
+
+typedef struct {
+    int fd;
+    uint64_t offset;            // region start in the file
+    uint64_t length;
+    size_t window;
+    stream_slot_t slots[2];
+    bool stop;                  // consumer gave up
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_t;
+
+static bool read_full(int fd, uint8_t *buf, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, buf, size, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        buf += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+// Reads window k into slot k % 2 while the consumer scans the other slot.
+static void* stream_reader(void *arg) {
+    stream_t *st = arg;
+
+    for (uint64_t pos = 0, k = 0; pos < st->length; pos += st->window, k++) {
+        stream_slot_t *slot = &st->slots[k & 1];
+
+        pthread_mutex_lock(&st->lock);
+        while (slot->full && !st->stop) pthread_cond_wait(&st->cond, &st->lock);
+        bool stop = st->stop;
+        pthread_mutex_unlock(&st->lock);
+        if (stop) break;
+
+        size_t n = (st->length - pos < st->window) ? (size_t)(st->length - pos) : st->window;
+        bool ok = read_full(st->fd, slot->buf + STREAM_CARRY, n, st->offset + pos);
+
+        pthread_mutex_lock(&st->lock);
+        slot->length = n;
+        slot->last = (pos + n >= st->length);
+        slot->error = !ok;
+        slot->full = true;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        if (!ok) break;
+    }
+
+    return NULL;
+}
+
+static bool stream_region(int fd, const exec_region_t *region, const gadget_scan_options_t *opts,
+                          size_t window, gadget_list_t *results, uint32_t *gadget_count) {
+    stream_t st = {
+        .fd = fd,
+        .offset = region->file_offset,
+        .length = region->size,
+        .window = window
+    };
+    if (st.length == 0) return true;
+
+    for (int i = 0; i < 2; i++) {
+        st.slots[i].buf = malloc(STREAM_CARRY + window);
+        if (!st.slots[i].buf) {
+            free(st.slots[0].buf);
+            return false;
+        }
+    }
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    posix_fadvise(fd, (off_t)st.offset, (off_t)st.length, POSIX_FADV_SEQUENTIAL);
+
+    pthread_t reader;
+    bool threaded = (pthread_create(&reader, NULL, stream_reader, &st) == 0);
+    if (!threaded) {
+        fprintf(stderr, "[-] Stream reader thread failed; reading inline\n");
+    }
+
+    uint8_t carry[STREAM_CARRY];
+    size_t carry_length = 0;
+    uint64_t window_start = 0;      // region offset of the slot's first read byte
+    bool ok = true;
+
+    for (uint64_t k = 0; ; k++) {
+        stream_slot_t *slot = &st.slots[k & 1];
+
+        if (threaded) {
+            pthread_mutex_lock(&st.lock);
+            while (!slot->full) pthread_cond_wait(&st.cond, &st.lock);
+            pthread_mutex_unlock(&st.lock);
+        } else {
+            size_t n = (st.length - window_start < window) ? (size_t)(st.length - window_start)
+                                                           : window;
+            slot->error = !read_full(fd, slot->buf + STREAM_CARRY, n, st.offset + window_start);
+            slot->length = n;
+            slot->last = (window_start + n >= st.length);
+        }
+
+        if (slot->error) {
+            ok = false;
+            break;
+        }
+
+        uint8_t *base = slot->buf + STREAM_CARRY - carry_length;
+        memcpy(base, carry, carry_length);
+        size_t size = carry_length + slot->length;
+        uint64_t origin = window_start - carry_length;
+
+        // Until the last window, only start instructions that have all
+        // X86_MAX_INSN_LENGTH bytes in the buffer, so every decode sees the
+        // same bytes a whole-file scan would.
+        size_t end = slot->last ? size : size - (X86_MAX_INSN_LENGTH - 1);
+        size_t stop = 0;
+        *gadget_count += gadget_scan_window(base, size, end, region->vaddr + origin,
+                                            region->file_offset + origin, opts->threads,
+                                            results, &stop);
+
+        bool last = slot->last;
+        carry_length = last ? 0 : size - stop;
+        memcpy(carry, base + stop, carry_length);
+        posix_fadvise(fd, (off_t)(st.offset + window_start), (off_t)slot->length,
+                      POSIX_FADV_DONTNEED);
+        window_start += slot->length;
+
+        pthread_mutex_lock(&st.lock);
+        slot->full = false;
+        pthread_cond_broadcast(&st.cond);
+        pthread_mutex_unlock(&st.lock);
+
+        if (last) break;
+    }
+
+    if (threaded) {
+        pthread_mutex_lock(&st.lock);
+        st.stop = true;
+        pthread_cond_broadcast(&st.cond);
+        pthread_mutex_unlock(&st.lock);
+        pthread_join(reader, NULL);
+    }
+
+    pthread_cond_destroy(&st.cond);
+    pthread_mutex_destroy(&st.lock);
+    free(st.slots[0].buf);
+    free(st.slots[1].buf);
+    return ok;
+}
+
+static uint64_t fd_size(int fd, const struct stat *sb) {
+    if (S_ISREG(sb->st_mode)) return (uint64_t)sb->st_size;
+
+    // Block devices report their size through lseek.
+    off_t end = lseek(fd, 0, SEEK_END);
+    return (end > 0) ? (uint64_t)end : 0;
+}
+
+bool gadget_scan_stream(const char *path, const gadget_scan_options_t *opts,
+                        gadget_list_t *results) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[-] Failed to open binary: %s\n", path);
+        return false;
+    }
+
+    struct stat sb;
+    uint64_t size = (fstat(fd, &sb) == 0) ? fd_size(fd, &sb) : 0;
+    if (size == 0) {
+        fprintf(stderr, "[-] Cannot stream %s: not a regular file or block device\n", path);
+        close(fd);
+        return false;
+    }
+
+    size_t window = opts->stream_window ? opts->stream_window : GADGET_STREAM_WINDOW;
+    if (window < STREAM_MIN_WINDOW) window = STREAM_MIN_WINDOW;
+
+    if (!opts->quiet) {
+        printf("[*] Streaming binary: %s (%lu bytes, %zu KiB windows)\n", path, size,
+               window >> 10);
+    }
+
+    // ELF headers are parsed through a mapping that is never read in full;
+    // only the pages holding headers and notes are faulted in.
+    exec_region_t regions[MAX_EXEC_REGIONS];
+    uint32_t region_count = 0;
+    gadget_index_key_t key;
+    char index_path[1024];
+    bool use_index = false;
+    uint32_t first = results->count;
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        if (!opts->raw) region_count = elf_exec_regions(map, size, regions, MAX_EXEC_REGIONS);
+
+        // Only build-id keys are cheap enough here; a content hash would
+        // read the whole input a second time.
+        uint8_t id[GADGET_INDEX_MAX_ID];
+        if (!opts->no_index && elf_build_id(map, size, id, sizeof(id)) > 0) {
+            binary_image_t image = { .data = map, .size = size, .mapped = true };
+            use_index = gadget_index_key(&image, opts->raw, &key) &&
+                        gadget_index_path(opts->index_dir, &key, index_path, sizeof(index_path));
+        }
+        munmap(map, size);
+    }
+
+    if (use_index && gadget_index_load(index_path, &key, results)) {
+        uint32_t loaded = results->count - first;
+        if (!opts->quiet) printf("[+] Loaded %u gadgets from index %s\n", loaded, index_path);
+        close(fd);
+        return loaded > 0;
+    }
+
+    if (region_count == 0) {
+        regions[0].file_offset = 0;
+        regions[0].vaddr = 0;
+        regions[0].size = size;
+        region_count = 1;
+    }
+
+    uint32_t gadget_count = 0;
+    uint64_t scanned = 0;
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < region_count; i++) {
+        ok = stream_region(fd, &regions[i], opts, window, results, &gadget_count);
+        scanned += regions[i].size;
+    }
+    close(fd);
+
+    if (!ok) {
+        fprintf(stderr, "[-] Read error while streaming %s\n", path);
+        return false;
+    }
+
+    if (!opts->quiet) {
+        printf("[+] Scanned %lu of %lu bytes in %u region%s\n", scanned, size,
+               region_count, region_count == 1 ? "" : "s");
+        printf("[+] Found %u potential LVI gadgets\n", gadget_count);
+    }
+
+    if (use_index && !gadget_index_store(index_path, &key, results, first)) {
+        fprintf(stderr, "[-] Could not write gadget index %s for %s\n", index_path, path);
+    }
+
+    return gadget_count > 0;
+}
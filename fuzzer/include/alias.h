@@ -0,0 +1,26 @@
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rng.h"
+
+// Walker/Vose alias table: O(n) build, O(1) weighted draws.
+typedef struct {
+    uint32_t n;
+    uint32_t *threshold;    // accept column i if a 32-bit draw is below this
+    uint32_t *alias;
+} alias_table_t;
+
+// Weights must be finite and non-negative with a positive sum.
+bool alias_table_build(alias_table_t *table, const double *weights, uint32_t n);
+void alias_table_destroy(alias_table_t *table);
+
+static inline uint32_t alias_table_sample(const alias_table_t *table, rng_t *rng) {
+    uint64_t r = rng_next(rng);
+    // High bits pick the column, low bits decide between it and its alias.
+    uint32_t column = (uint32_t)(((r >> 32) * table->n) >> 32);
+    return ((uint32_t)r < table->threshold[column]) ? column : table->alias[column];
+}
+
+#endif
@@ -3,22 +3,35 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "rng.h"
+#include "sketch.h"
 
 #define MAX_SAMPLES 100000
 #define DEFAULT_BOOTSTRAP_ROUNDS 10000
 #define DEFAULT_ALPHA 0.05
 #define DEFAULT_NEGLIGIBLE_THRESHOLD 50
+#define BOOTSTRAP_MAX_THREADS 64
+#define BOOTSTRAP_HISTOGRAM_MAX_RANGE 65536
+#define DEFAULT_OUTLIER_FENCE 1.5
+#define SEQUENTIAL_MAX_ROUND_FACTOR 10  // an interim look may cost this many full tests
 
+// With a sketch, data is a fixed-size uniform reservoir of everything added
+// and the sketch summarizes all total_seen samples; without one, data holds
+// every sample up to MAX_SAMPLES.
 typedef struct {
     uint64_t *data;
     uint32_t count;
     uint32_t capacity;
+    uint64_t total_seen;
+    quantile_sketch_t *sketch;
+    rng_t reservoir_rng;
 } sample_population_t;
 
 sample_population_t* population_create(uint32_t initial_capacity);
+sample_population_t* population_create_sketch(uint32_t reservoir_capacity, uint64_t seed);
 void population_destroy(sample_population_t *pop);
 bool population_add(sample_population_t *pop, uint64_t value);
-void population_clean_outliers(sample_population_t *pop);
+uint64_t population_median(sample_population_t *pop);
 
 typedef struct {
     double median_diff;
@@ -34,12 +47,43 @@ typedef struct {
     uint32_t bootstrap_rounds;
     double alpha;
     uint64_t negligible_threshold_cycles;
+    uint32_t num_threads;           // 0 = one per online CPU
+    uint64_t seed;                  // same seed -> same CI/p-value for any num_threads
+    uint64_t histogram_max_range;   // resample from a value histogram when max-min fits; 0 = exact only
+    bool quiet;                     // suppress progress and result output
+    double outlier_lower_fence;     // IQR multipliers for outlier removal; 0 = DEFAULT_OUTLIER_FENCE
+    double outlier_upper_fence;
 } bootstrap_config_t;
 
+void population_clean_outliers(sample_population_t *pop, bootstrap_config_t *config);
+
 bool bootstrap_test(sample_population_t *leak, sample_population_t *no_leak,
                     bootstrap_config_t *config, bootstrap_result_t *result);
 
+typedef enum {
+    SEQUENTIAL_CONTINUE,
+    SEQUENTIAL_REJECT,      // significant and above threshold: stop, exploitable
+    SEQUENTIAL_ACCEPT       // CI inside negligible band: stop, not exploitable
+} sequential_decision_t;
+
+typedef struct {
+    uint32_t looks_done;
+    double alpha_spent;
+    double last_nominal_alpha;
+    uint32_t last_rounds;           // bootstrap rounds the last look ran, 0 if it was skipped
+} sequential_state_t;
+
+void sequential_init(sequential_state_t *seq);
+double sequential_alpha_spent(double alpha, double information_fraction);
+sequential_decision_t bootstrap_sequential_look(sample_population_t *leak,
+                                                sample_population_t *no_leak,
+                                                bootstrap_config_t *config,
+                                                sequential_state_t *seq,
+                                                double information_fraction,
+                                                bootstrap_result_t *result);
+
 uint64_t stats_median(uint64_t *data, uint32_t count);
+uint64_t stats_median_inplace(uint64_t *data, uint32_t count);
 double stats_mean(uint64_t *data, uint32_t count);
 double stats_stddev(uint64_t *data, uint32_t count, double mean);
 
@@ -0,0 +1,55 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "db.h"
+#include "bootstrap.h"
+#include "rng.h"
+
+#define CHECKPOINT_MAGIC "LVIXCKP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_DEFAULT_SECONDS 60
+
+// State of a fuzzing run at an iteration boundary, saved next to its log.
+// The log is flushed durably before each write, so it holds every record
+// the checkpoint counts; records logged after it are dropped on resume
+// with db_rewind.
+typedef struct {
+    // Run parameters; a resumed run takes these over the command line.
+    uint64_t seed;
+    uint32_t num_campaigns;
+    uint32_t iterations_per_campaign;
+    uint32_t sequential_looks;
+    uint32_t adapt_interval;
+    bool uniform_gadgets;
+    uint64_t gadget_hash;           // over the gadget addresses; resume needs the same list
+    uint32_t campaigns_done;
+    bool found_exploitable;
+
+    // The campaign in progress, when in_campaign is set.
+    bool in_campaign;
+    campaign_t campaign;
+    uint32_t iteration;             // next iteration to run
+    uint32_t next_look;
+    sequential_state_t seq;
+    rng_t sampler_rng;
+    uint32_t since_rebuild;
+    uint32_t gadget_count;
+    double *weights;                // gadget_count entries
+    uint32_t *attempts;             // gadget_count entries, NULL unless adapting
+    uint32_t *leaks;
+    sample_population_t *leak;
+    sample_population_t *no_leak;
+} checkpoint_t;
+
+// <log_path>.ckpt, with any trailing slash of a segmented log removed.
+void checkpoint_path(const char *log_path, char *path, size_t size);
+// Writes a temporary file, syncs it and renames it over path.
+bool checkpoint_write(const char *path, const checkpoint_t *ckpt);
+// Allocates the campaign arrays and populations; release with checkpoint_free.
+bool checkpoint_read(const char *path, checkpoint_t *ckpt);
+void checkpoint_free(checkpoint_t *ckpt);
+
+#endif
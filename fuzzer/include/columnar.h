@@ -0,0 +1,108 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "db.h"
+
+#define COLUMNAR_MAGIC "LVIXLOG"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_HEADER_SIZE 64
+#define COLUMNAR_BLOCK_HEADER_SIZE 64
+#define COLUMNAR_BLOCK_RECORDS 4096
+
+// One column per experiment_t field, 8-byte columns first so every column
+// in a block stays naturally aligned.
+typedef enum {
+    COLUMN_TIMESTAMP,
+    COLUMN_CAMPAIGN_ID,
+    COLUMN_EXPERIMENT_ID,
+    COLUMN_GADGET_ADDR,
+    COLUMN_LEAK_LATENCY,
+    COLUMN_WINDOW_ESTIMATE,
+    COLUMN_P_VALUE,
+    COLUMN_OUTCOME,
+    COLUMN_LEAK_DETECTED,
+    COLUMN_SIGNIFICANT,
+    COLUMNAR_COLUMNS
+} columnar_column_t;
+
+// File layout: this header, then fixed-size blocks of block_records slots.
+// A block is a COLUMNAR_BLOCK_HEADER_SIZE header holding the record count,
+// followed by each column as a contiguous array of block_records values.
+// Only the last block may be partially filled.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t block_records;
+    uint32_t column_count;
+    uint8_t column_widths[16];  // schema check: byte width of each column
+    int64_t created;
+    uint8_t reserved[16];
+} columnar_header_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t reserved;
+} columnar_block_header_t;
+
+// Column pointers into one mapped block; valid for [0, count).
+typedef struct {
+    uint32_t count;
+    const int64_t *timestamp;
+    const uint64_t *campaign_id;
+    const uint64_t *experiment_id;
+    const uint64_t *gadget_addr;
+    const uint64_t *leak_latency;
+    const uint64_t *window_estimate;
+    const double *p_value;
+    const uint8_t *outcome;
+    const uint8_t *leak_detected;
+    const uint8_t *significant;
+} columnar_block_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    const columnar_header_t *header;
+    uint64_t block_count;
+    size_t block_bytes;
+    uint64_t records;
+} columnar_view_t;
+
+typedef struct columnar_writer columnar_writer_t;
+
+uint32_t columnar_column_width(columnar_column_t column);
+// Bytes one block occupies on disk.
+size_t columnar_block_size(void);
+
+// Creates the file or appends to an existing columnar log.
+columnar_writer_t* columnar_writer_open(const char *path);
+void columnar_writer_close(columnar_writer_t *writer);
+// Records in the file, including ones not yet flushed.
+uint64_t columnar_writer_records(const columnar_writer_t *writer);
+bool columnar_writer_append(columnar_writer_t *writer, const experiment_t *records, uint32_t count);
+// Writes the records appended since the last flush; durable also fdatasyncs.
+bool columnar_writer_flush(columnar_writer_t *writer, bool durable);
+
+// Maps a log read-only after checking the header and every block count.
+bool columnar_map(const char *path, columnar_view_t *view);
+void columnar_unmap(columnar_view_t *view);
+void columnar_block(const columnar_view_t *view, uint64_t index, columnar_block_t *block);
+void columnar_record(const columnar_block_t *block, uint32_t i, experiment_t *exp);
+// Points block at per-column arrays laid out like a block's columns.
+void columnar_block_from_columns(columnar_block_t *block, uint32_t count,
+                                 const uint8_t *columns[COLUMNAR_COLUMNS]);
+
+// Records at the end of block that belong to campaign_id and come after
+// experiment_id.
+uint32_t columnar_block_tail(const columnar_block_t *block, uint64_t campaign_id,
+                             uint64_t experiment_id);
+// Truncates the log before the records at its end that belong to
+// campaign_id and come after experiment_id. Close any writer first.
+bool columnar_rewind(const char *path, uint64_t campaign_id, uint64_t experiment_id,
+                     uint64_t *kept, uint64_t *dropped);
+
+#endif
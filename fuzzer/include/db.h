@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <time.h>
 #include "race.h"
 #include "bootstrap.h"
@@ -31,13 +32,74 @@ typedef struct {
     bool statistically_significant;
 } experiment_t;
 
+// Record filter for exports and scans; db_query_all matches everything.
+typedef struct {
+    uint64_t campaign_min;
+    uint64_t campaign_max;
+    int64_t time_min;
+    int64_t time_max;
+} db_query_t;
+
+static inline bool db_query_match(const db_query_t *query, uint64_t campaign_id,
+                                  int64_t timestamp) {
+    return campaign_id >= query->campaign_min && campaign_id <= query->campaign_max &&
+           timestamp >= query->time_min && timestamp <= query->time_max;
+}
+
+struct log_ring;
+struct columnar_writer;
+struct db_sqlite;
+struct segment_log;
+
+#define DB_DEFAULT_TXN_RECORDS 16384
+
+typedef enum {
+    DB_FORMAT_CSV,
+    DB_FORMAT_COLUMNAR,         // fixed-width binary blocks, see columnar.h
+    DB_FORMAT_SQLITE,           // campaigns and experiments tables, WAL mode
+    DB_FORMAT_SEGMENTED         // directory of rotated columnar segments, see segment.h
+} db_format_t;
+
+// Experiment records go through an in-memory ring to a background writer
+// unless synchronous is set; see log_ring.h.
+typedef struct {
+    db_format_t format;         // for new files; existing logs keep theirs
+    uint32_t ring_capacity;
+    uint32_t flush_interval_ms;
+    int writer_cpu;             // -1 = unpinned
+    bool drop_when_full;
+    bool synchronous;           // format and write on the caller's thread
+    uint32_t txn_records;       // SQLite: commit after this many inserts
+    uint64_t segment_bytes;     // segmented: rotate after this much data (0 = no limit)
+    uint32_t segment_seconds;   // segmented: rotate after this long (0 = no limit)
+} db_options_t;
+
 typedef struct {
     char filepath[512];
-    FILE *fp;
+    db_format_t format;
+    FILE *fp;                   // CSV
+    struct columnar_writer *columnar;
+    struct db_sqlite *sqlite;
+    struct segment_log *segments;
+    struct log_ring *ring;
+    bool synchronous;
+    uint64_t last_campaign_id;
+    char *buf;                  // writer-side formatting buffer
+    size_t buf_length;
 } db_handle_t;
 
+void db_default_options(db_options_t *opts);
+void db_query_all(db_query_t *query);
+// Format of an existing log: a directory is segmented, files are told
+// apart by their first bytes; CSV when unrecognised.
+db_format_t db_detect_format(const char *path);
+const char* db_format_name(db_format_t format);
 db_handle_t* db_open(const char *filepath);
+db_handle_t* db_open_opts(const char *filepath, const db_options_t *opts);
+// Drains queued records and flushes durably before closing.
 void db_close(db_handle_t *db);
+// Returns once every record logged so far is written (durable: fsynced).
+bool db_flush(db_handle_t *db, bool durable);
 
 bool db_campaign_create(db_handle_t *db, campaign_t *campaign);
 bool db_campaign_update(db_handle_t *db, campaign_t *campaign);
@@ -45,6 +107,13 @@ bool db_campaign_finalize(db_handle_t *db, uint64_t campaign_id);
 
 bool db_experiment_log(db_handle_t *db, experiment_t *exp);
 
+// Writes the log as CSV in the db_open schema, converting columnar logs.
 bool db_export_csv(db_handle_t *db, const char *output_path);
+// query NULL converts everything. Records outside the query are skipped
+// and segmented logs only read the segments the query can touch.
+bool db_convert_csv(const char *log_path, const char *output_path, const db_query_t *query);
+// Drops the records logged for campaign_id after experiment_id: what an
+// interrupted run wrote past its last checkpoint. Call before db_open.
+bool db_rewind(const char *log_path, uint64_t campaign_id, uint64_t experiment_id);
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define X86_MAX_INSN_LENGTH 15
+
+typedef enum {
+    X86_MAP_PRIMARY,
+    X86_MAP_0F,
+    X86_MAP_0F38,
+    X86_MAP_0F3A
+} x86_opcode_map_t;
+
+typedef struct {
+    uint8_t length;
+    uint8_t opcode_offset;      // first opcode byte, escapes included
+    x86_opcode_map_t map;
+    uint8_t opcode;
+    uint8_t rex;
+    bool vex;                   // VEX or EVEX encoded
+    bool opsize;                // 0x66
+    bool addrsize;              // 0x67
+    uint8_t rep;                // 0xF2 / 0xF3, or 0
+    uint8_t segment;            // 0x64 / 0x65, or 0
+
+    bool has_modrm;
+    uint8_t modrm;
+    bool has_sib;
+    uint8_t sib;
+    uint8_t disp_size;
+    int32_t disp;
+    uint8_t imm_size;
+    uint64_t imm;
+} x86_insn_t;
+
+// Decodes one 64-bit mode instruction from code[0, avail). Returns its length,
+// or 0 for invalid encodings and instructions that run past avail.
+uint32_t x86_decode(const uint8_t *code, size_t avail, x86_insn_t *insn);
+
+// x86_decode's length and opcode offset, and whether x86_accesses_memory
+// holds, without filling an x86_insn_t. Common encodings are sized from
+// tables; the rest go through x86_decode.
+uint32_t x86_length(const uint8_t *code, size_t avail, uint32_t *opcode_offset, bool *memory);
+
+// True for the legacy and REX prefix bytes x86_decode skips before the
+// opcode.
+bool x86_is_prefix(uint8_t byte);
+
+// True if the instruction reads or writes memory through its ModRM operand
+// (lea only computes the address).
+bool x86_accesses_memory(const x86_insn_t *insn);
+
+// Width in bits of the ModRM memory operand, or 0 when it is unknown
+// (no mnemonic) or sizeless (e.g. prefetch, clflush).
+uint32_t x86_memory_bits(const x86_insn_t *insn);
+
+// Compact Intel-syntax rendering, e.g. "mov rax, qword [rbx+rcx*8+0x10]".
+// Opcodes without a mnemonic are shown by map and opcode.
+void x86_format(const x86_insn_t *insn, uint64_t address, char *buf, size_t size);
+
+#endif
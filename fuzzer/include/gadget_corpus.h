@@ -0,0 +1,50 @@
+#ifndef GADGET_CORPUS_H
+#define GADGET_CORPUS_H
+
+#include "gadgets.h"
+
+#define CORPUS_NOT_DUPLICATE UINT32_MAX
+
+typedef struct {
+    char *path;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t content_hash;
+    uint32_t duplicate_of;      // file whose scan stands in for this one
+    bool scanned;
+    bool skipped;               // unreadable, or not ELF code in elf_only mode
+    uint32_t first_gadget;      // range in gadget_corpus_t.gadgets; duplicates
+    uint32_t gadget_count;      // share the range of the file they duplicate
+} gadget_corpus_file_t;
+
+// A set of files scanned as one batch. Files are kept sorted by path;
+// gadgets holds each scanned file's gadgets contiguously in file order.
+typedef struct {
+    gadget_corpus_file_t *files;
+    uint32_t file_count;
+    uint32_t capacity;
+    gadget_list_t *gadgets;
+
+    uint32_t scanned;
+    uint32_t duplicates;
+    uint32_t skipped;
+    uint64_t bytes_scanned;
+} gadget_corpus_t;
+
+gadget_corpus_t* gadget_corpus_create(void);
+void gadget_corpus_destroy(gadget_corpus_t *corpus);
+
+// Adds a file, every regular file below a directory, or every match of a
+// glob pattern. Symlinks are resolved; loops and repeats are dropped.
+bool gadget_corpus_add_path(gadget_corpus_t *corpus, const char *pattern);
+
+// Scans every file once per distinct inode and content with a pool of
+// opts->threads workers (0 = all CPUs). Each file is scanned by a single
+// thread.
+bool gadget_corpus_scan(gadget_corpus_t *corpus, const gadget_scan_options_t *opts);
+
+// One CSV row per gadget per file, duplicates included.
+bool gadget_corpus_write_csv(const gadget_corpus_t *corpus, const char *path);
+
+#endif
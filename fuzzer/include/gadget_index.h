@@ -0,0 +1,58 @@
+#ifndef GADGET_INDEX_H
+#define GADGET_INDEX_H
+
+#include "gadgets.h"
+
+// Bump whenever the decoder, scanner or scoring would produce different
+// gadgets for the same input; signature table changes are picked up
+// automatically.
+#define GADGET_INDEX_VERSION 2
+#define GADGET_INDEX_MAGIC "LVIGIDX"
+#define GADGET_INDEX_MAX_ID 64
+
+// Identity of one scan. ELF input with a build-id is keyed by it; anything
+// else by a content hash plus size and mtime.
+typedef struct {
+    uint8_t id[GADGET_INDEX_MAX_ID];
+    uint32_t id_length;
+    bool build_id;
+    bool raw;
+    uint64_t file_size;
+    uint64_t mtime_ns;      // 0 for build-id keys
+    uint64_t signatures;    // fingerprint of the builtin signature table
+} gadget_index_key_t;
+
+// On-disk layout: this header followed by the gadget_list_t arrays
+// (addresses, scores, code, types), so a mapped index is copied in with
+// gadget_list_extend.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint8_t id[GADGET_INDEX_MAX_ID];
+    uint32_t id_length;
+    uint32_t flags;
+    uint64_t file_size;
+    uint64_t mtime_ns;
+    uint64_t signatures;
+    uint64_t checksum;      // hash_bytes over the arrays
+} gadget_index_header_t;
+
+#define GADGET_INDEX_BUILD_ID (1u << 0)
+#define GADGET_INDEX_RAW      (1u << 1)
+
+bool gadget_index_key(const binary_image_t *image, bool raw, gadget_index_key_t *key);
+
+// $XDG_CACHE_HOME/lvi-dma-fuzzer/gadgets, falling back to ~/.cache.
+bool gadget_index_default_dir(char *buf, size_t size);
+// dir NULL selects the default directory.
+bool gadget_index_path(const char *dir, const gadget_index_key_t *key, char *path, size_t size);
+
+// Appends the indexed gadgets to results; false if the file is missing,
+// stale or damaged, leaving results untouched.
+bool gadget_index_load(const char *path, const gadget_index_key_t *key, gadget_list_t *results);
+// Writes list[first, count) atomically, creating the directory if needed.
+bool gadget_index_store(const char *path, const gadget_index_key_t *key,
+                        const gadget_list_t *list, uint32_t first);
+
+#endif
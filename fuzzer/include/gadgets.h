@@ -2,10 +2,21 @@
 #define GADGETS_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include "decoder.h"
 
 #define MAX_GADGET_LENGTH 32
 #define MAX_GADGETS 1024
+#define MAX_EXEC_REGIONS 64
+#define GADGET_SCAN_MAX_THREADS 64
+#define GADGET_SCAN_MIN_CHUNK (256 * 1024)  // smallest region share worth a thread
+#define GADGET_SCAN_SYNC_POINTS 64          // instruction starts kept per chunk for the merge
+#define GADGET_STREAM_WINDOW (8u << 20)     // default streaming read size
+#define GADGET_STREAM_AUTO_SIZE (4ULL << 30) // larger inputs are streamed, not mapped
+
+#define GADGET_MAP_POPULATE (1u << 0)   // prefault the whole mapping
+#define GADGET_MAP_HUGEPAGE (1u << 1)   // request transparent hugepages
 
 typedef enum {
     GADGET_LOAD_FAULTING,
@@ -15,8 +26,12 @@ typedef enum {
     GADGET_UNKNOWN
 } gadget_type_t;
 
+// A materialised gadget, as returned by gadget_list_get. address is the
+// link-time virtual address for ELF input (the file offset for raw input,
+// the live address for gadget_scan_memory_region).
 typedef struct {
     uint64_t address;
+    uint64_t file_offset;
     uint32_t length;
     gadget_type_t type;
     uint8_t instructions[MAX_GADGET_LENGTH];
@@ -24,24 +39,103 @@ typedef struct {
     double exploitability_score;
 } gadget_t;
 
+// Per-gadget data only needed for reporting; disassembly is not stored but
+// rendered from the bytes on demand.
+typedef struct {
+    uint64_t file_offset;
+    uint8_t length;
+    uint8_t bytes[X86_MAX_INSN_LENGTH];
+} gadget_code_t;
+
+// Structure of arrays: the campaign loop touches only the addresses, types
+// and scores, so those are kept dense and separate from the code records.
 typedef struct {
-    gadget_t *gadgets;
+    uint64_t *addresses;
+    uint8_t *types;                 // gadget_type_t
+    double *scores;
+    gadget_code_t *code;
     uint32_t count;
     uint32_t capacity;
 } gadget_list_t;
 
 gadget_list_t* gadget_list_create(void);
 void gadget_list_destroy(gadget_list_t *list);
-bool gadget_list_add(gadget_list_t *list, gadget_t *gadget);
+bool gadget_list_append(gadget_list_t *list, uint64_t address, gadget_type_t type,
+                        double score, uint64_t file_offset,
+                        const uint8_t *bytes, uint32_t length);
+bool gadget_list_add(gadget_list_t *list, const gadget_t *gadget);
+// Appends src's gadgets from index first onwards.
+bool gadget_list_extend(gadget_list_t *list, const gadget_list_t *src, uint32_t first);
+void gadget_list_get(const gadget_list_t *list, uint32_t index, gadget_t *gadget);
+void gadget_list_disassemble(const gadget_list_t *list, uint32_t index,
+                             char *buf, size_t size);
+
+// A scanned file: a read-only private mapping for regular files, or a heap
+// copy for pipes, devices and anything mmap rejects.
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    uint64_t mtime_ns;      // 0 unless the image is a regular file
+} binary_image_t;
+
+bool binary_image_open(const char *path, uint32_t flags, binary_image_t *image);
+void binary_image_close(binary_image_t *image);
+
+typedef struct {
+    uint64_t file_offset;
+    uint64_t vaddr;
+    uint64_t size;
+} exec_region_t;
+
+uint32_t elf_exec_regions(const uint8_t *data, size_t size,
+                          exec_region_t *regions, uint32_t max_regions);
+// Copies the NT_GNU_BUILD_ID note into id and returns its length, or 0.
+uint32_t elf_build_id(const uint8_t *data, size_t size, uint8_t *id, uint32_t max_length);
+
+typedef struct {
+    uint32_t map_flags;
+    bool raw;               // scan every byte instead of ELF executable sections
+    uint32_t threads;       // scan threads per region, 0 = all CPUs
+    const char *index_dir;  // gadget index cache, NULL = gadget_index_default_dir()
+    bool no_index;          // always rescan and do not write the index
+    bool elf_only;          // skip input without executable ELF code instead of scanning it raw
+    bool quiet;             // no per-binary progress lines
+    size_t stream_window;   // > 0 forces a streaming scan with this read size
+} gadget_scan_options_t;
+
+// Scans instructions that start in mem[0, end), decoding with all of
+// mem[0, size) available; *stop receives the first instruction start at or
+// past end. Returns the number of gadgets added.
+uint32_t gadget_scan_window(const uint8_t *mem, size_t size, size_t end,
+                            uint64_t vaddr_base, uint64_t file_offset_base,
+                            uint32_t threads, gadget_list_t *results, size_t *stop);
 
 bool gadget_scan_memory_region(uint64_t start_addr, size_t size,
                                 gadget_list_t *results);
+bool gadget_scan_memory_region_opts(uint64_t start_addr, size_t size,
+                                    const gadget_scan_options_t *opts,
+                                    gadget_list_t *results);
 
+// Scans an already opened image; label names it in diagnostics.
+bool gadget_scan_image(const binary_image_t *image, const char *label,
+                       const gadget_scan_options_t *opts, gadget_list_t *results);
 bool gadget_scan_binary(const char *binary_path, gadget_list_t *results);
+// Reads the input in fixed windows through a double-buffered pread pipeline,
+// so memory use does not depend on its size; results match a whole-file scan.
+bool gadget_scan_stream(const char *path, const gadget_scan_options_t *opts,
+                        gadget_list_t *results);
+bool gadget_scan_binary_opts(const char *binary_path, const gadget_scan_options_t *opts,
+                            gadget_list_t *results);
 
 bool gadget_is_lvi_susceptible(const uint8_t *code, uint32_t length);
 
-void gadget_print(gadget_t *gadget);
+// Exploitability heuristic in (0, 1] from the pattern class, load width and
+// addressing mode; stored as the gadget's score.
+double gadget_score(const x86_insn_t *insn, gadget_type_t type);
+
+const char* gadget_type_name(gadget_type_t type);
+void gadget_print(const gadget_t *gadget);
 void gadget_list_print(gadget_list_t *list);
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HASH_K1 0x9E3779B97F4A7C15ULL
+#define HASH_K2 0xC2B2AE3D27D4EB4FULL
+
+static inline uint64_t hash_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Non-cryptographic 64-bit hash for cache keys and dedupe; four independent
+// lanes keep the multiplies pipelined on large inputs.
+static inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = (const uint8_t*)data;
+    uint64_t lane[4] = { seed ^ HASH_K1, seed ^ HASH_K2, ~seed, seed + HASH_K1 };
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t w;
+            memcpy(&w, p + i + 8 * l, 8);
+            lane[l] = (lane[l] ^ (w * HASH_K2)) * HASH_K1;
+            lane[l] = (lane[l] << 31) | (lane[l] >> 33);
+        }
+    }
+
+    uint64_t h = hash_mix64(lane[0]) ^ hash_mix64(lane[1] + HASH_K1) ^
+                 hash_mix64(lane[2] + HASH_K2) ^ hash_mix64(lane[3] ^ (uint64_t)size);
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = hash_mix64(h ^ (w * HASH_K2)) * HASH_K1;
+    }
+
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < size; j++) {
+        tail |= (uint64_t)p[i + j] << (8 * j);
+    }
+    return hash_mix64(h ^ tail ^ ((uint64_t)size << 56));
+}
+
+#endif
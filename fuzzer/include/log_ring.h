@@ -0,0 +1,84 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "db.h"
+
+#define LOG_RING_DEFAULT_CAPACITY 65536
+#define LOG_RING_DEFAULT_BATCH 4096
+#define LOG_RING_DEFAULT_FLUSH_MS 100
+#define LOG_RING_CACHE_LINE 64
+
+// Called on the writer thread only. write gets a contiguous run of records;
+// flush makes everything written so far visible (durable: on stable storage).
+typedef bool (*log_sink_write_fn)(void *ctx, const experiment_t *records, uint32_t count);
+typedef bool (*log_sink_flush_fn)(void *ctx, bool durable);
+
+typedef struct {
+    uint32_t capacity;          // slots, rounded up to a power of two
+    uint32_t batch_size;        // most records handed to one write call
+    uint32_t flush_interval_ms; // 0 = flush after every batch
+    int writer_cpu;             // -1 = leave the writer unpinned
+    bool drop_when_full;        // drop and count instead of waiting
+} log_ring_config_t;
+
+typedef struct {
+    uint64_t logged;            // accepted by log_ring_push
+    uint64_t written;           // handed to the sink
+    uint64_t dropped;
+    uint64_t full_waits;        // pushes that found the ring full (backpressure)
+    uint64_t batches;
+    uint64_t flushes;
+    uint64_t write_errors;
+} log_ring_stats_t;
+
+// Single-producer single-consumer ring: the fuzzing loop pushes, one
+// writer thread drains. head and tail sit on their own cache lines so the
+// producer only touches the consumer's line when the ring looks full.
+typedef struct log_ring {
+    _Alignas(LOG_RING_CACHE_LINE) uint64_t head;   // producer-owned
+    uint64_t cached_tail;
+    uint64_t logged;
+    uint64_t dropped;
+    uint64_t full_waits;
+
+    _Alignas(LOG_RING_CACHE_LINE) uint64_t tail;   // writer-owned
+    uint64_t batches;
+    uint64_t flushes;
+    uint64_t write_errors;
+    uint64_t flush_done;        // last flush request served
+
+    _Alignas(LOG_RING_CACHE_LINE) uint64_t flush_target;   // flush request sequence
+    uint64_t flush_head;        // head at the time of the request
+    bool flush_durable;
+    bool stop;
+
+    experiment_t *slots;
+    uint64_t mask;
+    log_ring_config_t config;
+    log_sink_write_fn write;
+    log_sink_flush_fn flush;
+    void *sink;
+    pthread_t writer;
+} log_ring_t;
+
+void log_ring_default_config(log_ring_config_t *config);
+
+log_ring_t* log_ring_create(const log_ring_config_t *config, log_sink_write_fn write,
+                            log_sink_flush_fn flush, void *sink);
+// Drains every pushed record, flushes durably and joins the writer. Final
+// counters are stored in stats when it is not NULL.
+void log_ring_destroy(log_ring_t *ring, log_ring_stats_t *stats);
+
+// Copies the record into the ring and returns without any I/O. False only
+// when the ring is full and drop_when_full is set.
+bool log_ring_push(log_ring_t *ring, const experiment_t *record);
+
+// Blocks until everything pushed so far has been written and flushed.
+bool log_ring_flush(log_ring_t *ring, bool durable);
+
+void log_ring_get_stats(log_ring_t *ring, log_ring_stats_t *stats);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "columnar.h"
+
+#define SEGMENT_MAGIC "LVIXSEG"
+#define SEGMENT_FOOTER_MAGIC "LVIXSGF"
+#define SEGMENT_VERSION 1
+#define SEGMENT_DEFAULT_BYTES (64ull << 20)
+#define SEGMENT_MAX_PATH 1024
+
+// A segmented log is a directory of numbered segments. The newest one is a
+// columnar log (segment-NNNNNN.xlog) that is appended to; once it reaches
+// the size or age limit it is sealed into a compressed segment-NNNNNN.xseg
+// and a new one is started.
+//
+// Sealed layout: a 16-byte header, each column's encoded bytes, then a
+// footer holding the segment's campaign and time ranges and where each
+// column starts, so a reader decides from the footer alone whether to read
+// the rest.
+typedef enum {
+    SEGMENT_RAW,                // values copied as-is
+    SEGMENT_VARINT,             // LEB128
+    SEGMENT_DELTA_VARINT        // zigzag delta from the previous value, LEB128
+} segment_encoding_t;
+
+typedef struct {
+    uint64_t campaign_min;
+    uint64_t campaign_max;
+    int64_t time_min;
+    int64_t time_max;
+    uint64_t records;
+    uint64_t column_offset[COLUMNAR_COLUMNS];
+    uint64_t column_length[COLUMNAR_COLUMNS];
+    uint8_t column_encoding[16];
+    uint64_t checksum;          // hash_bytes over the column data
+    uint32_t version;
+    uint32_t footer_size;
+    char magic[8];
+} segment_footer_t;
+
+typedef struct {
+    uint64_t segments;          // in the directory
+    uint64_t segments_read;     // not skipped by their index
+    uint64_t records_read;
+} segment_scan_stats_t;
+
+typedef struct segment_log segment_log_t;
+
+// max_bytes and max_seconds bound the active segment; 0 disables a limit.
+segment_log_t* segment_log_open(const char *dir, uint64_t max_bytes, uint32_t max_seconds);
+void segment_log_close(segment_log_t *log);
+bool segment_log_append(segment_log_t *log, const experiment_t *records, uint32_t count);
+bool segment_log_flush(segment_log_t *log, bool durable);
+
+// Compresses a finished columnar log into a sealed segment.
+bool segment_seal(const char *log_path, const char *segment_path);
+
+// Calls fn with every block that can hold records matching query, oldest
+// segment first. Segments whose index excludes the query are not read.
+// Blocks may contain non-matching records; use db_query_match.
+typedef bool (*segment_block_fn)(void *ctx, const columnar_block_t *block);
+bool segment_log_scan(const char *dir, const db_query_t *query, segment_block_fn fn, void *ctx,
+                      segment_scan_stats_t *stats);
+
+// Segments in the directory, sealed and active.
+uint32_t segment_log_count(const char *dir);
+// segment_log_scan over segments [first, first + count) in scan order, so
+// several threads can each scan a slice of one log.
+bool segment_log_scan_range(const char *dir, uint32_t first, uint32_t count,
+                            const db_query_t *query, segment_block_fn fn, void *ctx,
+                            segment_scan_stats_t *stats);
+
+// Drops the records at the end of the log that belong to campaign_id and
+// come after experiment_id, removing segments that hold nothing else. Call
+// before segment_log_open.
+bool segment_log_rewind(const char *dir, uint64_t campaign_id, uint64_t experiment_id,
+                        uint64_t *dropped);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include "gadgets.h"
+
+#define SIGNATURE_MAX_LENGTH 8
+#define SIGNATURE_MAX_PREDICATES 64
+#define SIGNATURE_MAX_STATES 4096
+#define SIGNATURE_MAX_CLASSES 16
+
+// Byte i of a match satisfies (byte & mask[i]) == value[i]. Trailing mask-0
+// bytes are not matched, but the instruction must have room for them.
+typedef struct {
+    const char *name;
+    gadget_type_t type;
+    uint8_t length;
+    uint8_t value[SIGNATURE_MAX_LENGTH];
+    uint8_t mask[SIGNATURE_MAX_LENGTH];
+} gadget_signature_t;
+
+typedef struct {
+    uint8_t core;       // bytes consumed by the automaton
+    uint8_t class_id;
+} signature_output_t;
+
+// Signatures with the same span and type are indistinguishable to the
+// scanner and share one match class.
+typedef struct {
+    uint8_t span;
+    gadget_type_t type;
+} signature_class_t;
+
+// A byte set as nibble lookup tables, the layout a byte shuffle can test 32
+// bytes at a time with: byte b is in the set when bit (b >> 4) & 7 of
+// low[b & 15] (b < 0x80) or of high[b & 15] (b >= 0x80) is set.
+typedef struct {
+    uint8_t low[16];
+    uint8_t high[16];
+} signature_byte_set_t;
+
+static inline bool signature_byte_set_has(const signature_byte_set_t *set, uint8_t b) {
+    const uint8_t *row = (b < 0x80) ? set->low : set->high;
+    return (row[b & 15] >> ((b >> 4) & 7)) & 1;
+}
+
+// Bit (a << 8 | b) is set when a match can start with bytes a, b.
+typedef struct {
+    uint64_t bits[1024];
+} signature_pair_set_t;
+
+static inline bool signature_pair_set_has(const signature_pair_set_t *set, uint8_t a, uint8_t b) {
+    uint32_t pair = ((uint32_t)a << 8) | b;
+    return (set->bits[pair >> 6] >> (pair & 63)) & 1;
+}
+
+// Aho-Corasick automaton over byte equivalence classes. next[] holds row
+// offsets (state * alphabet); rows >= accept_row have outputs.
+typedef struct {
+    uint8_t byte_class[256];
+    uint32_t alphabet;
+    uint32_t states;
+    uint32_t accept_row;
+    uint32_t *next;
+    uint32_t *out_begin;            // indexed by state, states + 1 entries
+    signature_output_t *outputs;
+    signature_class_t classes[SIGNATURE_MAX_CLASSES];
+    uint32_t class_count;
+    // Every match starts with a byte in first followed by one in second;
+    // the scanner's prefilter skips everything else. pairs is exact for the
+    // first two bytes and weeds out the prefilter's candidates before the
+    // automaton runs.
+    signature_byte_set_t first;
+    signature_byte_set_t second;
+    signature_pair_set_t pairs;
+} signature_set_t;
+
+bool signature_set_compile(const gadget_signature_t *sigs, uint32_t count,
+                           signature_set_t *set);
+void signature_set_destroy(signature_set_t *set);
+
+// Built-in signature table, compiled on first use.
+const signature_set_t* signature_set_builtin(void);
+const gadget_signature_t* signature_builtin_table(uint32_t *count);
+
+// Stable hash of the matching-relevant fields, used to invalidate cached
+// scan results when the table changes.
+uint64_t signature_table_fingerprint(const gadget_signature_t *sigs, uint32_t count);
+
+// First match (by start offset, then table order) that starts at or before
+// max_start and ends inside code[0, length).
+bool signature_match_at(const signature_set_t *set, const uint8_t *code, size_t length,
+                        size_t max_start, gadget_type_t *type);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Log-linear (HDR-style) buckets: values below 2^SKETCH_SUB_BITS are
+// exact, larger values keep SKETCH_SUB_BITS significant bits (< 0.4% error).
+#define SKETCH_SUB_BITS 8
+#define SKETCH_SUB_COUNT (1u << SKETCH_SUB_BITS)
+#define SKETCH_HALF_COUNT (SKETCH_SUB_COUNT / 2)
+#define SKETCH_BUCKETS (SKETCH_SUB_COUNT + (64 - SKETCH_SUB_BITS) * SKETCH_HALF_COUNT)
+
+typedef struct {
+    uint64_t counts[SKETCH_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} quantile_sketch_t;
+
+quantile_sketch_t* sketch_create(void);
+void sketch_destroy(quantile_sketch_t *sketch);
+void sketch_reset(quantile_sketch_t *sketch);
+
+void sketch_add(quantile_sketch_t *sketch, uint64_t value);
+void sketch_merge(quantile_sketch_t *dst, const quantile_sketch_t *src);
+
+uint64_t sketch_value_at_rank(const quantile_sketch_t *sketch, uint64_t rank);
+uint64_t sketch_median(const quantile_sketch_t *sketch);
+uint64_t sketch_remove_outside(quantile_sketch_t *sketch, uint64_t lower, uint64_t upper);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One-pass summary of an unsigned array. Sums are taken around the first
+// element (shifted data), so variance stays accurate for large offsets and
+// cannot overflow the way an integer sum of squares does.
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t above;         // elements strictly greater than the threshold
+    double mean;
+    double m2;              // sum of squared deviations from the mean
+} summary_t;
+
+void summary_u64(const uint64_t *data, size_t count, uint64_t threshold, summary_t *out);
+void summary_u32(const uint32_t *data, size_t count, uint32_t threshold, summary_t *out);
+
+double summary_variance(const summary_t *s);
+double summary_sample_variance(const summary_t *s);
+
+#endif
@@ -16,11 +16,18 @@
 #include "race.h"
 #include "bootstrap.h"
 #include "gadgets.h"
+#include "gadget_corpus.h"
+#include "alias.h"
 #include "db.h"
+#include "log_ring.h"
+#include "segment.h"
+#include "checkpoint.h"
+#include "hash.h"
 
 #define DEFAULT_CAMPAIGNS 1
 #define DEFAULT_ITERATIONS 10000
 #define DEFAULT_TARGET_BINARY "/usr/bin/ls"
+#define MAX_BATCH_PATHS 64
 
 typedef struct {
     char target_binary[512];
@@ -29,6 +36,35 @@ typedef struct {
     uint32_t bootstrap_rounds;
     double alpha;
     uint64_t negligible_threshold;
+    uint32_t bootstrap_threads;
+    uint64_t seed;
+    bool exact_bootstrap;
+    uint32_t sequential_looks;
+    double outlier_lower_fence;
+    double outlier_upper_fence;
+    uint32_t map_flags;
+    bool raw_scan;
+    uint32_t scan_threads;
+    uint32_t stream_window_mib;
+    char gadget_index_dir[512];
+    bool no_gadget_index;
+    const char *batch_paths[MAX_BATCH_PATHS];
+    uint32_t batch_path_count;
+    char batch_output[512];
+    uint32_t adapt_interval;
+    bool uniform_gadgets;
+    uint32_t log_flush_ms;
+    uint32_t log_ring_size;
+    bool log_drop;
+    bool sync_log;
+    db_format_t log_format;
+    uint32_t db_txn_records;
+    uint32_t segment_mib;
+    uint32_t segment_seconds;
+    db_query_t export_query;
+    char export_csv[512];
+    uint32_t checkpoint_seconds;
+    bool resume;
     bool verbose;
     bool scan_only;
     char output_db[512];
@@ -63,7 +99,36 @@ static void print_usage(const char *prog) {
     printf("  -r, --bootstrap N        Bootstrap test rounds (default: 10000)\n");
     printf("  -a, --alpha FLOAT        Statistical significance level (default: 0.05)\n");
     printf("  -t, --threshold N        Negligible leak threshold in cycles (default: 50)\n");
+    printf("  -j, --bootstrap-threads N  Bootstrap worker threads (default: 0 = all CPUs)\n");
+    printf("  -S, --seed N             RNG seed (default: current time)\n");
+    printf("      --exact-bootstrap    Always resample raw samples, never value histograms\n");
+    printf("  -L, --looks N            Interim sequential tests per campaign (default: 0 = final test only)\n");
+    printf("  -F, --fence K[:K]        IQR fence multipliers for outlier removal, lower[:upper] (default: 1.5)\n");
+    printf("      --raw-scan           Scan every byte of the target, not just ELF code sections\n");
+    printf("      --map-populate       Prefault the whole target mapping before scanning\n");
+    printf("      --map-hugepages      Request transparent hugepages for the target mapping\n");
+    printf("      --scan-threads N     Gadget scan threads (default: 0 = all CPUs)\n");
+    printf("      --stream-window MIB  Stream the target through MIB-sized reads instead of mapping it\n");
+    printf("      --gadget-index DIR   Gadget index cache directory (default: ~/.cache/lvi-dma-fuzzer/gadgets)\n");
+    printf("      --no-gadget-index    Always rescan the target and do not update the index\n");
+    printf("      --uniform-gadgets    Pick gadgets uniformly instead of by exploitability score\n");
+    printf("      --adapt N            Re-weight gadgets by observed leak rate every N iterations (default: 0 = off)\n");
+    printf("      --batch PATH         Scan a file, directory tree or glob instead of fuzzing (repeatable)\n");
+    printf("      --batch-output PATH  Write the batch gadget set as CSV\n");
     printf("  -o, --output PATH        Output database path (default: lvi-dma-results.csv)\n");
+    printf("      --log-flush-ms N     Flush the experiment log every N ms (default: 100, 0 = every batch)\n");
+    printf("      --log-ring N         Experiment log queue size in records (default: 65536)\n");
+    printf("      --log-drop           Drop records when the log queue is full instead of waiting\n");
+    printf("      --sync-log           Write each record from the fuzzing loop, no background writer\n");
+    printf("      --log-format FMT     Format for a new output database: csv, columnar, sqlite or segmented (default: csv)\n");
+    printf("      --segment-mb N       Segmented log: start a new segment every N MiB (default: 64, 0 = no limit)\n");
+    printf("      --segment-sec N      Segmented log: start a new segment every N seconds (default: 0 = no limit)\n");
+    printf("      --db-txn N           SQLite: commit experiment inserts every N records (default: 16384)\n");
+    printf("      --export-csv PATH    Convert the output database to CSV at PATH and exit\n");
+    printf("      --export-campaign ID Only export records of campaign ID\n");
+    printf("      --export-time T0:T1  Only export records with T0 <= timestamp <= T1 (Unix seconds)\n");
+    printf("      --checkpoint-sec N   Save campaign state next to the output every N seconds (default: 60, 0 = off)\n");
+    printf("      --resume             Continue the run saved in the output's checkpoint\n");
     printf("  -s, --scan-only          Only scan for gadgets, don't fuzz\n");
     printf("  -v, --verbose            Verbose output\n");
     printf("  -h, --help               Show this help message\n\n");
@@ -80,7 +145,17 @@ static bool parse_args(int argc, char **argv, fuzzer_config_t *config) {
     config->bootstrap_rounds = DEFAULT_BOOTSTRAP_ROUNDS;
     config->alpha = DEFAULT_ALPHA;
     config->negligible_threshold = DEFAULT_NEGLIGIBLE_THRESHOLD;
+    config->bootstrap_threads = 0;
+    config->outlier_lower_fence = DEFAULT_OUTLIER_FENCE;
+    config->outlier_upper_fence = DEFAULT_OUTLIER_FENCE;
+    config->seed = (uint64_t)time(NULL);
     strncpy(config->output_db, "lvi-dma-results.csv", sizeof(config->output_db) - 1);
+    config->log_flush_ms = LOG_RING_DEFAULT_FLUSH_MS;
+    config->log_ring_size = LOG_RING_DEFAULT_CAPACITY;
+    config->db_txn_records = DB_DEFAULT_TXN_RECORDS;
+    config->segment_mib = SEGMENT_DEFAULT_BYTES >> 20;
+    db_query_all(&config->export_query);
+    config->checkpoint_seconds = CHECKPOINT_DEFAULT_SECONDS;
     config->verbose = false;
     config->scan_only = false;
 
@@ -91,7 +166,36 @@ static bool parse_args(int argc, char **argv, fuzzer_config_t *config) {
         {"bootstrap",  required_argument, 0, 'r'},
         {"alpha",      required_argument, 0, 'a'},
         {"threshold",  required_argument, 0, 't'},
+        {"bootstrap-threads", required_argument, 0, 'j'},
+        {"seed",       required_argument, 0, 'S'},
+        {"exact-bootstrap", no_argument,  0, 'E'},
+        {"looks",      required_argument, 0, 'L'},
+        {"fence",      required_argument, 0, 'F'},
+        {"raw-scan",   no_argument,       0, 'R'},
+        {"map-populate",  no_argument,    0, 'P'},
+        {"map-hugepages", no_argument,    0, 'H'},
+        {"scan-threads",  required_argument, 0, 'T'},
+        {"stream-window", required_argument, 0, 'W'},
+        {"gadget-index",  required_argument, 0, 'I'},
+        {"no-gadget-index", no_argument,  0, 'N'},
+        {"uniform-gadgets", no_argument,  0, 'U'},
+        {"adapt",         required_argument, 0, 'A'},
+        {"batch",         required_argument, 0, 'B'},
+        {"batch-output",  required_argument, 0, 'O'},
         {"output",     required_argument, 0, 'o'},
+        {"log-flush-ms",  required_argument, 0, 'K'},
+        {"log-ring",      required_argument, 0, 'G'},
+        {"log-drop",      no_argument,    0, 'D'},
+        {"sync-log",      no_argument,    0, 'Y'},
+        {"log-format",    required_argument, 0, 'X'},
+        {"export-csv",    required_argument, 0, 'V'},
+        {"db-txn",        required_argument, 0, 'Q'},
+        {"segment-mb",    required_argument, 0, 'Z'},
+        {"segment-sec",   required_argument, 0, 'J'},
+        {"export-campaign", required_argument, 0, 'C'},
+        {"export-time",   required_argument, 0, 'M'},
+        {"checkpoint-sec", required_argument, 0, 'k'},
+        {"resume",        no_argument,    0, 'e'},
         {"scan-only",  no_argument,       0, 's'},
         {"verbose",    no_argument,       0, 'v'},
         {"help",       no_argument,       0, 'h'},
@@ -101,7 +205,7 @@ static bool parse_args(int argc, char **argv, fuzzer_config_t *config) {
     int opt;
     int option_index = 0;
 
-    while ((opt = getopt_long(argc, argv, "b:c:i:r:a:t:o:svh", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "b:c:i:r:a:t:j:S:L:F:o:svh", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'b':
                 strncpy(config->target_binary, optarg, sizeof(config->target_binary) - 1);
@@ -121,9 +225,120 @@ static bool parse_args(int argc, char **argv, fuzzer_config_t *config) {
             case 't':
                 config->negligible_threshold = atoll(optarg);
                 break;
+            case 'j':
+                config->bootstrap_threads = atoi(optarg);
+                break;
+            case 'S':
+                config->seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'E':
+                config->exact_bootstrap = true;
+                break;
+            case 'L':
+                config->sequential_looks = atoi(optarg);
+                break;
+            case 'R':
+                config->raw_scan = true;
+                break;
+            case 'P':
+                config->map_flags |= GADGET_MAP_POPULATE;
+                break;
+            case 'H':
+                config->map_flags |= GADGET_MAP_HUGEPAGE;
+                break;
+            case 'T':
+                config->scan_threads = atoi(optarg);
+                break;
+            case 'W':
+                config->stream_window_mib = atoi(optarg);
+                break;
+            case 'I':
+                strncpy(config->gadget_index_dir, optarg, sizeof(config->gadget_index_dir) - 1);
+                break;
+            case 'N':
+                config->no_gadget_index = true;
+                break;
+            case 'U':
+                config->uniform_gadgets = true;
+                break;
+            case 'A':
+                config->adapt_interval = atoi(optarg);
+                break;
+            case 'B':
+                if (config->batch_path_count >= MAX_BATCH_PATHS) {
+                    fprintf(stderr, "[-] At most %d --batch paths\n", MAX_BATCH_PATHS);
+                    return false;
+                }
+                config->batch_paths[config->batch_path_count++] = optarg;
+                break;
+            case 'O':
+                strncpy(config->batch_output, optarg, sizeof(config->batch_output) - 1);
+                break;
+            case 'F': {
+                char *end;
+                config->outlier_lower_fence = strtod(optarg, &end);
+                config->outlier_upper_fence = (*end == ':') ? atof(end + 1)
+                                                            : config->outlier_lower_fence;
+                break;
+            }
             case 'o':
                 strncpy(config->output_db, optarg, sizeof(config->output_db) - 1);
                 break;
+            case 'K':
+                config->log_flush_ms = atoi(optarg);
+                break;
+            case 'G':
+                config->log_ring_size = atoi(optarg);
+                break;
+            case 'D':
+                config->log_drop = true;
+                break;
+            case 'Y':
+                config->sync_log = true;
+                break;
+            case 'X':
+                if (strcmp(optarg, "csv") == 0) {
+                    config->log_format = DB_FORMAT_CSV;
+                } else if (strcmp(optarg, "columnar") == 0 || strcmp(optarg, "binary") == 0) {
+                    config->log_format = DB_FORMAT_COLUMNAR;
+                } else if (strcmp(optarg, "sqlite") == 0) {
+                    config->log_format = DB_FORMAT_SQLITE;
+                } else if (strcmp(optarg, "segmented") == 0) {
+                    config->log_format = DB_FORMAT_SEGMENTED;
+                } else {
+                    fprintf(stderr, "[-] Unknown log format: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'Q':
+                config->db_txn_records = atoi(optarg);
+                break;
+            case 'Z':
+                config->segment_mib = atoi(optarg);
+                break;
+            case 'J':
+                config->segment_seconds = atoi(optarg);
+                break;
+            case 'C':
+                config->export_query.campaign_min = strtoull(optarg, NULL, 0);
+                config->export_query.campaign_max = config->export_query.campaign_min;
+                break;
+            case 'M': {
+                char *end;
+                config->export_query.time_min = strtoll(optarg, &end, 0);
+                config->export_query.time_max = (*end == ':') ? strtoll(end + 1, NULL, 0)
+                                                              : config->export_query.time_min;
+                break;
+            }
+            case 'V':
+                strncpy(config->export_csv, optarg, sizeof(config->export_csv) - 1);
+                break;
+            case 'k':
+                config->checkpoint_seconds = atoi(optarg);
+                break;
+            case 'e':
+                config->resume = true;
+                break;
             case 's':
                 config->scan_only = true;
                 break;
@@ -150,28 +365,210 @@ static void print_config(fuzzer_config_t *config) {
     printf("    Bootstrap rounds:    %u\n", config->bootstrap_rounds);
     printf("    Alpha (p-value):     %.4f\n", config->alpha);
     printf("    Negligible threshold:%lu cycles\n", config->negligible_threshold);
-    printf("    Output database:     %s\n", config->output_db);
+    printf("    Bootstrap threads:   %u%s\n", config->bootstrap_threads,
+           config->bootstrap_threads == 0 ? " (auto)" : "");
+    printf("    Seed:                %lu\n", config->seed);
+    printf("    Bootstrap mode:      %s\n", config->exact_bootstrap ? "exact" : "histogram when range fits");
+    printf("    Sequential looks:    %u\n", config->sequential_looks);
+    printf("    Gadget sampling:     %s", config->uniform_gadgets ? "uniform" : "score-weighted");
+    if (config->adapt_interval > 0) printf(", adapted every %u", config->adapt_interval);
+    printf("\n");
+    printf("    Outlier fences:      %.2f / %.2f x IQR\n",
+           config->outlier_lower_fence, config->outlier_upper_fence);
+    printf("    Output database:     %s (%s for new files)\n", config->output_db,
+           db_format_name(config->log_format));
+    if (config->sync_log) {
+        printf("    Experiment log:      synchronous\n");
+    } else {
+        printf("    Experiment log:      %u-record queue, flush every %u ms%s\n",
+               config->log_ring_size, config->log_flush_ms,
+               config->log_drop ? ", drop when full" : "");
+    }
+    if (config->checkpoint_seconds > 0) {
+        printf("    Checkpoints:         every %u s%s\n", config->checkpoint_seconds,
+               config->resume ? ", resuming" : "");
+    } else {
+        printf("    Checkpoints:         off%s\n", config->resume ? ", resuming" : "");
+    }
     printf("    Scan only:           %s\n", config->scan_only ? "YES" : "NO");
     printf("    Verbose:             %s\n", config->verbose ? "YES" : "NO");
     printf("\n");
 }
 
+// Draws gadgets in proportion to their weights through an alias table.
+// Weights start as the exploitability scores (or all equal) and, when
+// adapting, are periodically re-derived from each gadget's leak record.
+typedef struct {
+    alias_table_t table;
+    rng_t rng;
+    const double *scores;       // NULL for uniform sampling
+    double *weights;
+    uint32_t *attempts;         // per gadget, only when adapting
+    uint32_t *leaks;
+    uint32_t count;
+    uint32_t adapt_interval;
+    uint32_t since_rebuild;
+} gadget_sampler_t;
+
+#define ADAPT_EXPLORE_FLOOR 0.05   // share of the prior kept however often a gadget misses
+
+static void gadget_sampler_destroy(gadget_sampler_t *s) {
+    alias_table_destroy(&s->table);
+    free(s->weights);
+    free(s->attempts);
+    free(s->leaks);
+}
+
+static bool gadget_sampler_init(gadget_sampler_t *s, const gadget_list_t *gadgets,
+                                const fuzzer_config_t *config, uint64_t stream) {
+    memset(s, 0, sizeof(*s));
+    s->count = gadgets->count;
+    s->scores = config->uniform_gadgets ? NULL : gadgets->scores;
+    s->adapt_interval = config->adapt_interval;
+    rng_seed(&s->rng, config->seed, stream);
+
+    s->weights = malloc(s->count * sizeof(double));
+    if (s->adapt_interval > 0) {
+        s->attempts = calloc(s->count, sizeof(uint32_t));
+        s->leaks = calloc(s->count, sizeof(uint32_t));
+    }
+    if (!s->weights || (s->adapt_interval > 0 && (!s->attempts || !s->leaks))) {
+        gadget_sampler_destroy(s);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < s->count; i++) {
+        s->weights[i] = s->scores ? s->scores[i] : 1.0;
+    }
+    if (!alias_table_build(&s->table, s->weights, s->count)) {
+        gadget_sampler_destroy(s);
+        return false;
+    }
+    return true;
+}
+
+static uint32_t gadget_sampler_next(gadget_sampler_t *s) {
+    return alias_table_sample(&s->table, &s->rng);
+}
+
+// Laplace-smoothed leak rate times the prior. A rebuild is O(gadgets), so
+// adapt intervals of at least the gadget count keep draws amortised O(1).
+static void gadget_sampler_record(gadget_sampler_t *s, uint32_t index, bool leaked) {
+    if (s->adapt_interval == 0) return;
+
+    s->attempts[index]++;
+    s->leaks[index] += leaked;
+    if (++s->since_rebuild < s->adapt_interval) return;
+    s->since_rebuild = 0;
+
+    for (uint32_t i = 0; i < s->count; i++) {
+        double prior = s->scores ? s->scores[i] : 1.0;
+        double rate = (s->leaks[i] + 1.0) / (s->attempts[i] + 2.0);
+        double w = prior * rate;
+        s->weights[i] = (w > prior * ADAPT_EXPLORE_FLOOR) ? w : prior * ADAPT_EXPLORE_FLOOR;
+    }
+
+    alias_table_t rebuilt;
+    if (alias_table_build(&rebuilt, s->weights, s->count)) {
+        alias_table_destroy(&s->table);
+        s->table = rebuilt;
+    }
+}
+
+// Takes over the sampler state and populations saved in ckpt. The alias
+// table is rebuilt from the saved weights, which is what it was built from.
+static bool gadget_sampler_restore(gadget_sampler_t *s, checkpoint_t *ckpt,
+                                   sample_population_t **leak_pop,
+                                   sample_population_t **no_leak_pop) {
+    if (ckpt->gadget_count != s->count || (s->adapt_interval > 0) != (ckpt->attempts != NULL)) {
+        return false;
+    }
+
+    alias_table_t table;
+    if (!alias_table_build(&table, ckpt->weights, s->count)) return false;
+    alias_table_destroy(&s->table);
+    s->table = table;
+
+    free(s->weights);
+    free(s->attempts);
+    free(s->leaks);
+    s->weights = ckpt->weights;
+    s->attempts = ckpt->attempts;
+    s->leaks = ckpt->leaks;
+    s->rng = ckpt->sampler_rng;
+    s->since_rebuild = ckpt->since_rebuild;
+
+    population_destroy(*leak_pop);
+    population_destroy(*no_leak_pop);
+    *leak_pop = ckpt->leak;
+    *no_leak_pop = ckpt->no_leak;
+
+    ckpt->weights = NULL;
+    ckpt->attempts = NULL;
+    ckpt->leaks = NULL;
+    ckpt->leak = NULL;
+    ckpt->no_leak = NULL;
+    return true;
+}
+
+// The log is flushed durably first, so it holds every record the
+// checkpoint counts.
+static bool save_checkpoint(checkpoint_t *ckpt, const char *path, db_handle_t *db) {
+    bool ok = db_flush(db, true) && checkpoint_write(path, ckpt);
+    if (!ok) fprintf(stderr, "[-] Failed to write checkpoint %s\n", path);
+    return ok;
+}
+
+// ckpt already points at the sampler arrays and populations.
+static bool save_campaign_checkpoint(checkpoint_t *ckpt, const char *path, db_handle_t *db,
+                                     const campaign_t *campaign, const gadget_sampler_t *s,
+                                     uint32_t iteration, uint32_t next_look,
+                                     const sequential_state_t *seq) {
+    ckpt->in_campaign = true;
+    ckpt->campaign = *campaign;
+    ckpt->iteration = iteration;
+    ckpt->next_look = next_look;
+    ckpt->seq = *seq;
+    ckpt->sampler_rng = s->rng;
+    ckpt->since_rebuild = s->since_rebuild;
+    bool ok = save_checkpoint(ckpt, path, db);
+    ckpt->in_campaign = false;
+    return ok;
+}
+
+// ckpt carries the run state; when it holds a campaign in progress, that
+// campaign continues from its saved iteration. checkpoint_path NULL
+// disables checkpoints. completed is false when the run was interrupted.
 static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
                                   gadget_list_t *gadgets, db_handle_t *db,
-                                  timing_calibration_t *cal, iotlb_profile_t *profile) {
+                                  timing_calibration_t *cal, iotlb_profile_t *profile,
+                                  checkpoint_t *ckpt, const char *checkpoint_path,
+                                  bool *completed) {
 
-    printf("\n[*] Starting campaign: %s\n", campaign->name);
+    bool resume = ckpt->in_campaign;
+    ckpt->in_campaign = false;
+    *completed = false;
 
-    sample_population_t *leak_pop = population_create(10000);
-    sample_population_t *no_leak_pop = population_create(10000);
+    printf("\n[*] %s campaign: %s\n", resume ? "Resuming" : "Starting", campaign->name);
+
+    gadget_sampler_t sampler;
+    if (!gadget_sampler_init(&sampler, gadgets, config, campaign->campaign_id)) {
+        printf("[-] Failed to build gadget sampler\n");
+        return false;
+    }
+
+    sample_population_t *leak_pop = population_create_sketch(MAX_SAMPLES, config->seed + 1);
+    sample_population_t *no_leak_pop = population_create_sketch(MAX_SAMPLES, config->seed + 2);
 
     if (!leak_pop || !no_leak_pop) {
+        gadget_sampler_destroy(&sampler);
         return false;
     }
 
     virtqueue_t *vq = virtio_queue_create(256);
     if (!vq) {
         printf("[-] Failed to create VirtIO queue\n");
+        gadget_sampler_destroy(&sampler);
         return false;
     }
 
@@ -181,9 +578,61 @@ static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
     memset((void*)probe_memory, 0x00, 4096);
     memset((void*)target_memory, 0xAA, 4096);
 
-    for (uint32_t iter = 0; iter < config->iterations_per_campaign && g_running; iter++) {
-        uint32_t gadget_idx = rand() % gadgets->count;
-        gadget_t *gadget = &gadgets->gadgets[gadget_idx];
+    bootstrap_config_t boot_config = {
+        .bootstrap_rounds = config->bootstrap_rounds,
+        .alpha = config->alpha,
+        .negligible_threshold_cycles = config->negligible_threshold,
+        .num_threads = config->bootstrap_threads,
+        .seed = config->seed,
+        .histogram_max_range = config->exact_bootstrap ? 0 : BOOTSTRAP_HISTOGRAM_MAX_RANGE,
+        .outlier_lower_fence = config->outlier_lower_fence,
+        .outlier_upper_fence = config->outlier_upper_fence
+    };
+
+    sequential_state_t seq;
+    sequential_init(&seq);
+    sequential_decision_t decision = SEQUENTIAL_CONTINUE;
+    bootstrap_result_t boot_result = {0};
+    uint32_t next_look = 1;
+    uint32_t iter = 0;
+
+    if (resume) {
+        if (!gadget_sampler_restore(&sampler, ckpt, &leak_pop, &no_leak_pop)) {
+            printf("[-] Checkpoint does not match the gadget sampler\n");
+            gadget_sampler_destroy(&sampler);
+            population_destroy(leak_pop);
+            population_destroy(no_leak_pop);
+            virtio_queue_destroy(vq);
+            free((void*)probe_memory);
+            free((void*)target_memory);
+            return false;
+        }
+        iter = ckpt->iteration;
+        next_look = ckpt->next_look;
+        seq = ckpt->seq;
+        printf("[*] Continuing at iteration %u/%u (%u attempts, %u leaks so far)\n",
+               iter, config->iterations_per_campaign,
+               campaign->total_attempts, campaign->successful_leaks);
+    }
+
+    // Checkpoints borrow the live sampler arrays and populations.
+    ckpt->gadget_count = sampler.count;
+    ckpt->weights = sampler.weights;
+    ckpt->attempts = sampler.attempts;
+    ckpt->leaks = sampler.leaks;
+    ckpt->leak = leak_pop;
+    ckpt->no_leak = no_leak_pop;
+    time_t next_checkpoint = time(NULL) + config->checkpoint_seconds;
+
+    // Record the new campaign right away, so a resume can drop what it
+    // logs before the first periodic checkpoint.
+    if (!resume && checkpoint_path) {
+        save_campaign_checkpoint(ckpt, checkpoint_path, db, campaign, &sampler, 0, next_look, &seq);
+    }
+
+    for (; iter < config->iterations_per_campaign && g_running; iter++) {
+        uint32_t gadget_idx = gadget_sampler_next(&sampler);
+        uint64_t gadget_addr = gadgets->addresses[gadget_idx];
 
         uint16_t desc_idx;
         if (!virtio_descriptor_prepare_race(vq, (uint64_t)target_memory,
@@ -205,6 +654,7 @@ static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
         }
 
         campaign->total_attempts++;
+        gadget_sampler_record(&sampler, gadget_idx, attempt.leak_detected);
 
         if (config->verbose && iter % 1000 == 0) {
             printf("    [%u/%u] Success rate: %.2f%%\r",
@@ -217,7 +667,7 @@ static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
             .experiment_id = campaign->total_attempts,
             .campaign_id = campaign->campaign_id,
             .timestamp = time(NULL),
-            .gadget_addr = gadget->address,
+            .gadget_addr = gadget_addr,
             .outcome = outcome,
             .leak_detected = attempt.leak_detected,
             .leak_latency = attempt.leak_latency,
@@ -227,23 +677,95 @@ static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
         };
 
         db_experiment_log(db, &exp);
+
+        if (next_look <= config->sequential_looks &&
+            (uint64_t)(iter + 1) * (config->sequential_looks + 1) >=
+            (uint64_t)next_look * config->iterations_per_campaign) {
+            double fraction = (double)(iter + 1) / config->iterations_per_campaign;
+            decision = bootstrap_sequential_look(leak_pop, no_leak_pop, &boot_config,
+                                                 &seq, fraction, &boot_result);
+            next_look++;
+
+            if (config->verbose && seq.last_rounds == 0) {
+                if (leak_pop->count < 10 || no_leak_pop->count < 10) {
+                    printf("\n    [look %u/%u @ %u] skipped: fewer than 10 samples\n",
+                           seq.looks_done, config->sequential_looks, iter + 1);
+                } else {
+                    printf("\n    [look %u/%u @ %u] skipped: nominal alpha=%.3g needs more "
+                           "than %.0f bootstrap rounds\n",
+                           seq.looks_done, config->sequential_looks, iter + 1,
+                           seq.last_nominal_alpha,
+                           (double)config->bootstrap_rounds * SEQUENTIAL_MAX_ROUND_FACTOR);
+                }
+            } else if (config->verbose) {
+                printf("\n    [look %u/%u @ %u] p=%.6f nominal alpha=%.6f (%u rounds) "
+                       "CI [%.2f, %.2f]\n",
+                       seq.looks_done, config->sequential_looks, iter + 1,
+                       boot_result.p_value, seq.last_nominal_alpha, seq.last_rounds,
+                       boot_result.ci_lower, boot_result.ci_upper);
+            }
+
+            if (decision != SEQUENTIAL_CONTINUE) {
+                printf("\n[*] Sequential test stopped campaign after %u/%u iterations (%s)\n",
+                       iter + 1, config->iterations_per_campaign,
+                       decision == SEQUENTIAL_REJECT ? "significant" : "negligible");
+                break;
+            }
+        }
+
+        if (checkpoint_path && exp.timestamp >= next_checkpoint) {
+            save_campaign_checkpoint(ckpt, checkpoint_path, db, campaign, &sampler,
+                                     iter + 1, next_look, &seq);
+            next_checkpoint = exp.timestamp + config->checkpoint_seconds;
+        }
     }
 
     printf("\n");
 
-    printf("[*] Running statistical validation...\n");
+    *completed = decision != SEQUENTIAL_CONTINUE || iter >= config->iterations_per_campaign;
+    if (!*completed && checkpoint_path &&
+        save_campaign_checkpoint(ckpt, checkpoint_path, db, campaign, &sampler,
+                                 iter, next_look, &seq)) {
+        printf("[*] Saved campaign state at iteration %u to %s; continue with --resume\n",
+               iter, checkpoint_path);
+    }
+    ckpt->weights = NULL;
+    ckpt->attempts = NULL;
+    ckpt->leaks = NULL;
+    ckpt->leak = NULL;
+    ckpt->no_leak = NULL;
+
+    // An interrupted campaign is neither tested nor finalized: testing the
+    // partial populations would add a look the sequential design never
+    // budgeted for, on top of the one the resumed run makes.
+    bool exploitable = false;
+    if (!*completed) goto out;
+
+    // The level the decision was made at: the stopping look's nominal
+    // alpha, what the looks left over, or the whole alpha.
+    double decision_alpha = config->alpha;
+    if (decision == SEQUENTIAL_REJECT) {
+        exploitable = true;
+        decision_alpha = seq.last_nominal_alpha;
+    } else if (decision == SEQUENTIAL_ACCEPT) {
+        exploitable = false;
+    } else {
+        printf("[*] Running statistical validation...\n");
 
-    population_clean_outliers(leak_pop);
-    population_clean_outliers(no_leak_pop);
+        population_clean_outliers(leak_pop, &boot_config);
+        population_clean_outliers(no_leak_pop, &boot_config);
 
-    bootstrap_config_t boot_config = {
-        .bootstrap_rounds = config->bootstrap_rounds,
-        .alpha = config->alpha,
-        .negligible_threshold_cycles = config->negligible_threshold
-    };
+        exploitable = bootstrap_test(leak_pop, no_leak_pop, &boot_config, &boot_result);
 
-    bootstrap_result_t boot_result = {0};
-    bool exploitable = bootstrap_test(leak_pop, no_leak_pop, &boot_config, &boot_result);
+        if (config->sequential_looks > 0) {
+            double final_alpha = config->alpha - seq.alpha_spent;
+            decision_alpha = final_alpha;
+            boot_result.is_significant = (boot_result.p_value < final_alpha);
+            exploitable = boot_result.is_significant && boot_result.exceeds_threshold;
+            printf("    Sequential final look: nominal alpha %.6f -> %s\n",
+                   final_alpha, boot_result.is_significant ? "significant" : "not significant");
+        }
+    }
 
     if (exploitable) {
         printf("\n");
@@ -256,24 +778,56 @@ static bool run_fuzzing_campaign(fuzzer_config_t *config, campaign_t *campaign,
         printf("    Median timing difference: %.2f cycles\n", boot_result.median_diff);
         printf("    95%% Confidence Interval: [%.2f, %.2f]\n",
                boot_result.ci_lower, boot_result.ci_upper);
-        printf("    p-value: %.6f (significant at α=%.4f)\n",
-               boot_result.p_value, config->alpha);
+        printf("    p-value: %.6f (significant at α=%.6f)\n",
+               boot_result.p_value, decision_alpha);
         printf("\n");
     } else {
         printf("[-] No exploitable leak detected in this campaign\n");
     }
 
+    db_campaign_update(db, campaign);
+
+out:
+    gadget_sampler_destroy(&sampler);
     population_destroy(leak_pop);
     population_destroy(no_leak_pop);
     virtio_queue_destroy(vq);
     free((void*)probe_memory);
     free((void*)target_memory);
 
-    db_campaign_update(db, campaign);
-
     return exploitable;
 }
 
+// Batch mode scans a corpus and exits; it needs none of the fuzzing setup.
+static int run_batch_scan(fuzzer_config_t *config) {
+    gadget_corpus_t *corpus = gadget_corpus_create();
+    if (!corpus) return 1;
+
+    for (uint32_t i = 0; i < config->batch_path_count; i++) {
+        if (!gadget_corpus_add_path(corpus, config->batch_paths[i])) {
+            gadget_corpus_destroy(corpus);
+            return 1;
+        }
+    }
+
+    gadget_scan_options_t scan_opts = {
+        .map_flags = config->map_flags,
+        .raw = config->raw_scan,
+        .threads = config->scan_threads,
+        .index_dir = config->gadget_index_dir[0] ? config->gadget_index_dir : NULL,
+        .no_index = config->no_gadget_index
+    };
+    bool ok = gadget_corpus_scan(corpus, &scan_opts);
+
+    if (ok && config->batch_output[0]) {
+        ok = gadget_corpus_write_csv(corpus, config->batch_output);
+        if (ok) printf("[+] Batch results written to %s\n", config->batch_output);
+    }
+
+    gadget_corpus_destroy(corpus);
+    return ok ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
     fuzzer_config_t config;
 
@@ -285,6 +839,14 @@ int main(int argc, char **argv) {
 
     print_config(&config);
 
+    if (config.batch_path_count > 0) {
+        return run_batch_scan(&config);
+    }
+
+    if (config.export_csv[0]) {
+        return db_convert_csv(config.output_db, config.export_csv, &config.export_query) ? 0 : 1;
+    }
+
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
@@ -306,7 +868,15 @@ int main(int argc, char **argv) {
 
     printf("\n[*] Scanning for LVI gadgets...\n");
     gadget_list_t *gadgets = gadget_list_create();
-    if (!gadget_scan_binary(config.target_binary, gadgets)) {
+    gadget_scan_options_t scan_opts = {
+        .map_flags = config.map_flags,
+        .raw = config.raw_scan,
+        .threads = config.scan_threads,
+        .stream_window = (size_t)config.stream_window_mib << 20,
+        .index_dir = config.gadget_index_dir[0] ? config.gadget_index_dir : NULL,
+        .no_index = config.no_gadget_index
+    };
+    if (!gadget_scan_binary_opts(config.target_binary, &scan_opts, gadgets)) {
         printf("[-] No gadgets found in target binary\n");
         gadget_list_destroy(gadgets);
         topology_free(topo);
@@ -322,6 +892,54 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    // A resumed run takes its parameters from the checkpoint and first
+    // drops whatever was logged after it.
+    char ckpt_path[sizeof(config.output_db) + 8];
+    checkpoint_path(config.output_db, ckpt_path, sizeof(ckpt_path));
+    checkpoint_t ckpt = {0};
+    uint64_t gadget_hash = hash_bytes(gadgets->addresses, gadgets->count * sizeof(uint64_t),
+                                      gadgets->count);
+
+    if (config.resume) {
+        bool ok = checkpoint_read(ckpt_path, &ckpt);
+        if (!ok) {
+            printf("[-] No checkpoint to resume at %s\n", ckpt_path);
+        } else if (ckpt.gadget_hash != gadget_hash) {
+            printf("[-] Gadgets differ from the checkpointed run; scan the same target to resume\n");
+            ok = false;
+        } else if (ckpt.in_campaign) {
+            ok = db_rewind(config.output_db, ckpt.campaign.campaign_id,
+                           ckpt.campaign.total_attempts);
+        }
+        if (!ok) {
+            checkpoint_free(&ckpt);
+            gadget_list_destroy(gadgets);
+            topology_free(topo);
+            return 1;
+        }
+
+        config.seed = ckpt.seed;
+        config.num_campaigns = ckpt.num_campaigns;
+        config.iterations_per_campaign = ckpt.iterations_per_campaign;
+        config.sequential_looks = ckpt.sequential_looks;
+        config.adapt_interval = ckpt.adapt_interval;
+        config.uniform_gadgets = ckpt.uniform_gadgets;
+        printf("\n[*] Resuming from %s: %u/%u campaigns done, seed %lu\n", ckpt_path,
+               ckpt.campaigns_done, ckpt.num_campaigns, ckpt.seed);
+    } else if (config.checkpoint_seconds > 0 && access(ckpt_path, F_OK) == 0) {
+        printf("\n[!] %s holds an earlier run and will be replaced (use --resume to continue it)\n",
+               ckpt_path);
+    }
+
+    ckpt.seed = config.seed;
+    ckpt.num_campaigns = config.num_campaigns;
+    ckpt.iterations_per_campaign = config.iterations_per_campaign;
+    ckpt.sequential_looks = config.sequential_looks;
+    ckpt.adapt_interval = config.adapt_interval;
+    ckpt.uniform_gadgets = config.uniform_gadgets;
+    ckpt.gadget_hash = gadget_hash;
+    const char *ckpt_file = config.checkpoint_seconds > 0 ? ckpt_path : NULL;
+
     printf("\n[*] Estimating IOTLB invalidation window...\n");
     iotlb_profile_t profile;
     race_estimate_iotlb_window(&profile, 1000);
@@ -333,9 +951,30 @@ int main(int argc, char **argv) {
         printf("[!] Consider targeting a system with asynchronous IOMMU.\n\n");
     }
 
-    db_handle_t *db = db_open(config.output_db);
+    // Keep the log writer off the attacker and victim cores.
+    db_options_t db_opts = {
+        .format = config.log_format,
+        .ring_capacity = config.log_ring_size,
+        .flush_interval_ms = config.log_flush_ms,
+        .writer_cpu = -1,
+        .drop_when_full = config.log_drop,
+        .synchronous = config.sync_log,
+        .txn_records = config.db_txn_records,
+        .segment_bytes = (uint64_t)config.segment_mib << 20,
+        .segment_seconds = config.segment_seconds
+    };
+    for (int cpu = 0; cpu < topo->num_cpus; cpu++) {
+        int logical = topo->cpus[cpu].logical_cpu;
+        if (logical != coresidency.attacker_cpu && logical != coresidency.victim_cpu) {
+            db_opts.writer_cpu = logical;
+            break;
+        }
+    }
+
+    db_handle_t *db = db_open_opts(config.output_db, &db_opts);
     if (!db) {
         printf("[-] Failed to open database\n");
+        checkpoint_free(&ckpt);
         gadget_list_destroy(gadgets);
         topology_free(topo);
         return 1;
@@ -347,17 +986,32 @@ int main(int argc, char **argv) {
     printf("╚═══════════════════════════════════════════════════════════════╝\n");
     printf("\n");
 
-    srand(time(NULL));
+    srand((unsigned int)config.seed);
 
-    bool found_exploitable = false;
+    bool found_exploitable = ckpt.found_exploitable;
+    bool interrupted = false;
 
-    for (uint32_t c = 0; c < config.num_campaigns && g_running; c++) {
+    for (uint32_t c = ckpt.campaigns_done; c < config.num_campaigns && g_running; c++) {
         campaign_t campaign = {0};
-        snprintf(campaign.name, sizeof(campaign.name), "Campaign_%u", c + 1);
-        db_campaign_create(db, &campaign);
+        if (ckpt.in_campaign) {
+            campaign = ckpt.campaign;
+        } else {
+            snprintf(campaign.name, sizeof(campaign.name), "Campaign_%u", c + 1);
+            db_campaign_create(db, &campaign);
+        }
+        ckpt.campaigns_done = c;
+        ckpt.found_exploitable = found_exploitable;
 
+        bool completed;
         bool exploitable = run_fuzzing_campaign(&config, &campaign, gadgets, db,
-                                                  &cal, &profile);
+                                                  &cal, &profile, &ckpt, ckpt_file, &completed);
+
+        // The checkpoint already holds an interrupted campaign; --resume
+        // finishes and finalizes it.
+        if (!completed) {
+            interrupted = true;
+            break;
+        }
 
         if (exploitable) {
             found_exploitable = true;
@@ -365,6 +1019,10 @@ int main(int argc, char **argv) {
 
         db_campaign_finalize(db, campaign.campaign_id);
 
+        ckpt.campaigns_done = c + 1;
+        ckpt.found_exploitable = found_exploitable;
+        if (ckpt_file) save_checkpoint(&ckpt, ckpt_file, db);
+
         printf("\n[*] Campaign %u/%u complete\n", c + 1, config.num_campaigns);
         printf("    Total attempts: %u\n", campaign.total_attempts);
         printf("    Successful leaks: %u\n", campaign.successful_leaks);
@@ -373,7 +1031,11 @@ int main(int argc, char **argv) {
 
     printf("\n");
     printf("╔═══════════════════════════════════════════════════════════════╗\n");
-    printf("║                  FUZZING CAMPAIGN COMPLETE                    ║\n");
+    if (interrupted) {
+        printf("║                 FUZZING CAMPAIGN INTERRUPTED                  ║\n");
+    } else {
+        printf("║                  FUZZING CAMPAIGN COMPLETE                    ║\n");
+    }
     printf("╚═══════════════════════════════════════════════════════════════╝\n");
     printf("\n");
 
@@ -386,6 +1048,12 @@ int main(int argc, char **argv) {
     }
 
     db_close(db);
+
+    // A finished run has nothing left to resume.
+    if (ckpt.campaigns_done == config.num_campaigns && (ckpt_file || config.resume)) {
+        unlink(ckpt_path);
+    }
+    checkpoint_free(&ckpt);
     gadget_list_destroy(gadgets);
     topology_free(topo);
 
@@ -0,0 +1,83 @@
+#include "alias.h"
+#include <math.h>
+#include <stdlib.h>
+
+static uint32_t probability_to_threshold(double p) {
+    if (p >= 1.0) return UINT32_MAX;
+    if (p <= 0.0) return 0;
+    return (uint32_t)(p * 4294967296.0);
+}
+
+bool alias_table_build(alias_table_t *table, const double *weights, uint32_t n) {
+    table->n = 0;
+    table->threshold = NULL;
+    table->alias = NULL;
+    if (n == 0) return false;
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (!(weights[i] >= 0.0) || !isfinite(weights[i])) return false;
+        sum += weights[i];
+    }
+    if (!(sum > 0.0)) return false;
+
+    double *scaled = malloc(n * sizeof(double));
+    uint32_t *work = malloc(n * sizeof(uint32_t));
+    table->threshold = malloc(n * sizeof(uint32_t));
+    table->alias = malloc(n * sizeof(uint32_t));
+    if (!scaled || !work || !table->threshold || !table->alias) {
+        free(scaled);
+        free(work);
+        alias_table_destroy(table);
+        return false;
+    }
+
+    // Vose's method: small columns fill from the front of work, large ones
+    // from the back, and each small column is topped up by one large one.
+    uint32_t small = 0, large = n;
+    for (uint32_t i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / sum;
+        if (scaled[i] < 1.0) work[small++] = i;
+        else work[--large] = i;
+    }
+
+    while (small > 0 && large < n) {
+        uint32_t s = work[--small];
+        uint32_t l = work[large];
+
+        table->threshold[s] = probability_to_threshold(scaled[s]);
+        table->alias[s] = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large++;
+            work[small++] = l;
+        }
+    }
+
+    // Whatever is left is full up to rounding error; the alias points back
+    // at the column so the 2^-32 miss of UINT32_MAX is harmless.
+    while (large < n) {
+        uint32_t l = work[large++];
+        table->threshold[l] = UINT32_MAX;
+        table->alias[l] = l;
+    }
+    while (small > 0) {
+        uint32_t s = work[--small];
+        table->threshold[s] = UINT32_MAX;
+        table->alias[s] = s;
+    }
+
+    free(scaled);
+    free(work);
+    table->n = n;
+    return true;
+}
+
+void alias_table_destroy(alias_table_t *table) {
+    free(table->threshold);
+    free(table->alias);
+    table->threshold = NULL;
+    table->alias = NULL;
+    table->n = 0;
+}
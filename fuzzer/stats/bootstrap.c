@@ -1,13 +1,21 @@
+#define _GNU_SOURCE
 #include "bootstrap.h"
+#include "rng.h"
+#include "summary.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
 
 sample_population_t* population_create(uint32_t initial_capacity) {
     sample_population_t *pop = calloc(1, sizeof(sample_population_t));
     if (!pop) return NULL;
 
+    if (initial_capacity == 0) initial_capacity = 1;
+    if (initial_capacity > MAX_SAMPLES) initial_capacity = MAX_SAMPLES;
+
     pop->capacity = initial_capacity;
     pop->data = calloc(initial_capacity, sizeof(uint64_t));
     pop->count = 0;
@@ -20,16 +28,87 @@ sample_population_t* population_create(uint32_t initial_capacity) {
     return pop;
 }
 
+sample_population_t* population_create_sketch(uint32_t reservoir_capacity, uint64_t seed) {
+    sample_population_t *pop = calloc(1, sizeof(sample_population_t));
+    if (!pop) return NULL;
+
+    pop->sketch = sketch_create();
+    pop->capacity = reservoir_capacity;
+    if (reservoir_capacity > 0) {
+        pop->data = calloc(reservoir_capacity, sizeof(uint64_t));
+    }
+
+    if (!pop->sketch || (reservoir_capacity > 0 && !pop->data)) {
+        sketch_destroy(pop->sketch);
+        free(pop->data);
+        free(pop);
+        return NULL;
+    }
+
+    rng_seed(&pop->reservoir_rng, seed, 0);
+    return pop;
+}
+
+// Deep copy holding only the samples pop currently has.
+static sample_population_t* population_clone(const sample_population_t *pop) {
+    sample_population_t *copy = calloc(1, sizeof(sample_population_t));
+    if (!copy) return NULL;
+
+    *copy = *pop;
+    copy->data = NULL;
+    copy->sketch = NULL;
+    copy->capacity = pop->count;
+
+    if (pop->sketch) {
+        copy->sketch = malloc(sizeof(quantile_sketch_t));
+        if (copy->sketch) memcpy(copy->sketch, pop->sketch, sizeof(quantile_sketch_t));
+    }
+    if (pop->count > 0) {
+        copy->data = malloc(pop->count * sizeof(uint64_t));
+        if (copy->data) memcpy(copy->data, pop->data, pop->count * sizeof(uint64_t));
+    }
+
+    if ((pop->sketch && !copy->sketch) || (pop->count > 0 && !copy->data)) {
+        sketch_destroy(copy->sketch);
+        free(copy->data);
+        free(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
 void population_destroy(sample_population_t *pop) {
     if (pop) {
+        sketch_destroy(pop->sketch);
         free(pop->data);
         free(pop);
     }
 }
 
 bool population_add(sample_population_t *pop, uint64_t value) {
+    pop->total_seen++;
+
+    if (pop->sketch) {
+        sketch_add(pop->sketch, value);
+
+        if (pop->count < pop->capacity) {
+            pop->data[pop->count++] = value;
+        } else if (pop->capacity > 0) {
+            uint64_t slot = rng_bounded64(&pop->reservoir_rng, pop->total_seen);
+            if (slot < pop->capacity) {
+                pop->data[slot] = value;
+            }
+        }
+        return true;
+    }
+
     if (pop->count >= pop->capacity) {
+        if (pop->capacity >= MAX_SAMPLES) return false;
+
         uint32_t new_capacity = pop->capacity * 2;
+        if (new_capacity > MAX_SAMPLES) new_capacity = MAX_SAMPLES;
+
         uint64_t *new_data = realloc(pop->data, new_capacity * sizeof(uint64_t));
         if (!new_data) return false;
 
@@ -41,96 +120,543 @@ bool population_add(sample_population_t *pop, uint64_t value) {
     return true;
 }
 
-static int compare_uint64(const void *a, const void *b) {
-    uint64_t va = *(const uint64_t*)a;
-    uint64_t vb = *(const uint64_t*)b;
-    return (va > vb) - (va < vb);
+static void swap_uint64(uint64_t *a, uint64_t *b) {
+    uint64_t t = *a;
+    *a = *b;
+    *b = t;
 }
 
-uint64_t stats_median(uint64_t *data, uint32_t count) {
+static uint64_t select_uint64(uint64_t *data, uint32_t count, uint32_t k) {
+    uint32_t lo = 0;
+    uint32_t hi = count - 1;
+
+    while (hi > lo) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (data[mid] < data[lo]) swap_uint64(&data[mid], &data[lo]);
+        if (data[hi] < data[lo]) swap_uint64(&data[hi], &data[lo]);
+        if (data[hi] < data[mid]) swap_uint64(&data[hi], &data[mid]);
+
+        uint64_t pivot = data[mid];
+        uint32_t i = lo;
+        uint32_t j = hi;
+
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                swap_uint64(&data[i], &data[j]);
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+
+    return data[k];
+}
+
+uint64_t stats_median_inplace(uint64_t *data, uint32_t count) {
     if (count == 0) return 0;
 
-    uint64_t *sorted = malloc(count * sizeof(uint64_t));
-    memcpy(sorted, data, count * sizeof(uint64_t));
-    qsort(sorted, count, sizeof(uint64_t), compare_uint64);
+    uint64_t upper = select_uint64(data, count, count / 2);
+    if (count % 2 != 0) {
+        return upper;
+    }
 
-    uint64_t result;
-    if (count % 2 == 0) {
-        result = (sorted[count/2 - 1] + sorted[count/2]) / 2;
-    } else {
-        result = sorted[count/2];
+    uint64_t lower = data[0];
+    for (uint32_t i = 1; i < count / 2; i++) {
+        if (data[i] > lower) lower = data[i];
     }
 
-    free(sorted);
+    return (lower + upper) / 2;
+}
+
+uint64_t stats_median(uint64_t *data, uint32_t count) {
+    if (count == 0) return 0;
+
+    uint64_t *scratch = malloc(count * sizeof(uint64_t));
+    if (!scratch) return 0;
+
+    memcpy(scratch, data, count * sizeof(uint64_t));
+    uint64_t result = stats_median_inplace(scratch, count);
+
+    free(scratch);
     return result;
 }
 
 double stats_mean(uint64_t *data, uint32_t count) {
     if (count == 0) return 0.0;
 
-    uint64_t sum = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        sum += data[i];
-    }
-
-    return (double)sum / count;
+    summary_t summary;
+    summary_u64(data, count, UINT64_MAX, &summary);
+    return summary.mean;
 }
 
 double stats_stddev(uint64_t *data, uint32_t count, double mean) {
     if (count < 2) return 0.0;
 
-    double var_sum = 0.0;
+    summary_t summary;
+    summary_u64(data, count, UINT64_MAX, &summary);
+
+    // Deviations are taken around the caller's mean, as before.
+    double offset = summary.mean - mean;
+    double var_sum = summary.m2 + count * offset * offset;
+    return sqrt(var_sum / (count - 1));
+}
+
+uint64_t population_median(sample_population_t *pop) {
+    if (pop->sketch) {
+        return sketch_median(pop->sketch);
+    }
+
+    return stats_median(pop->data, pop->count);
+}
+
+static uint32_t compact_within(uint64_t *data, uint32_t count, uint64_t lower_bound,
+                               uint64_t upper_bound) {
+    // Branch-free: always store, only advance on keep. Subtracting the lower
+    // bound turns the range test into one unsigned compare.
+    uint64_t span = upper_bound - lower_bound;
+    uint32_t new_count = 0;
     for (uint32_t i = 0; i < count; i++) {
-        double diff = data[i] - mean;
-        var_sum += diff * diff;
+        uint64_t v = data[i];
+        data[new_count] = v;
+        new_count += (v - lower_bound <= span);
     }
 
-    return sqrt(var_sum / (count - 1));
+    return new_count;
 }
 
-void population_clean_outliers(sample_population_t *pop) {
-    if (pop->count < 4) return;
+static void outlier_fences(bootstrap_config_t *config, double *lower_k, double *upper_k) {
+    *lower_k = DEFAULT_OUTLIER_FENCE;
+    *upper_k = DEFAULT_OUTLIER_FENCE;
 
-    uint64_t *sorted = malloc(pop->count * sizeof(uint64_t));
-    memcpy(sorted, pop->data, pop->count * sizeof(uint64_t));
-    qsort(sorted, pop->count, sizeof(uint64_t), compare_uint64);
+    if (config && config->outlier_lower_fence > 0.0) *lower_k = config->outlier_lower_fence;
+    if (config && config->outlier_upper_fence > 0.0) *upper_k = config->outlier_upper_fence;
+}
 
-    uint32_t q1_idx = pop->count / 4;
-    uint32_t q3_idx = (3 * pop->count) / 4;
+static void outlier_bounds(uint64_t q1, uint64_t q3, bootstrap_config_t *config,
+                           uint64_t *lower_bound, uint64_t *upper_bound) {
+    double lower_k, upper_k;
+    outlier_fences(config, &lower_k, &upper_k);
 
-    uint64_t q1 = sorted[q1_idx];
-    uint64_t q3 = sorted[q3_idx];
     uint64_t iqr = q3 - q1;
+    *lower_bound = (q1 > iqr * lower_k) ? (q1 - iqr * lower_k) : 0;
+    *upper_bound = q3 + iqr * upper_k;
+}
 
-    uint64_t lower_bound = (q1 > iqr * 1.5) ? (q1 - iqr * 1.5) : 0;
-    uint64_t upper_bound = q3 + iqr * 1.5;
+static void sketch_clean_outliers(sample_population_t *pop, bootstrap_config_t *config) {
+    quantile_sketch_t *sketch = pop->sketch;
+    if (sketch->total < 4) return;
 
-    free(sorted);
+    uint64_t q1 = sketch_value_at_rank(sketch, sketch->total / 4);
+    uint64_t q3 = sketch_value_at_rank(sketch, (3 * sketch->total) / 4);
 
-    uint32_t new_count = 0;
-    for (uint32_t i = 0; i < pop->count; i++) {
-        if (pop->data[i] >= lower_bound && pop->data[i] <= upper_bound) {
-            pop->data[new_count++] = pop->data[i];
-        }
+    uint64_t lower_bound, upper_bound;
+    outlier_bounds(q1, q3, config, &lower_bound, &upper_bound);
+
+    uint64_t removed = sketch_remove_outside(sketch, lower_bound, upper_bound);
+    pop->count = compact_within(pop->data, pop->count, lower_bound, upper_bound);
+
+    if (removed > 0 && !(config && config->quiet)) {
+        printf("[*] Removed %lu outliers from population\n", removed);
+    }
+}
+
+void population_clean_outliers(sample_population_t *pop, bootstrap_config_t *config) {
+    if (pop->sketch) {
+        sketch_clean_outliers(pop, config);
+        return;
     }
 
+    if (pop->count < 4) return;
+
+    // Selection permutes data in place; sample order carries no meaning for
+    // resampling, so no copy is needed.
+    uint32_t q1_idx = pop->count / 4;
+    uint32_t q3_idx = (3 * pop->count) / 4;
+
+    uint64_t q1 = select_uint64(pop->data, pop->count, q1_idx);
+    uint64_t q3 = (q3_idx == q1_idx) ? q1 :
+        select_uint64(pop->data + q1_idx + 1, pop->count - q1_idx - 1,
+                      q3_idx - q1_idx - 1);
+
+    uint64_t lower_bound, upper_bound;
+    outlier_bounds(q1, q3, config, &lower_bound, &upper_bound);
+
+    uint32_t new_count = compact_within(pop->data, pop->count, lower_bound, upper_bound);
+
     uint32_t removed = pop->count - new_count;
     pop->count = new_count;
 
-    if (removed > 0) {
+    if (removed > 0 && !(config && config->quiet)) {
         printf("[*] Removed %u outliers from population\n", removed);
     }
 }
 
-static uint64_t* bootstrap_sample(uint64_t *data, uint32_t count) {
-    uint64_t *sample = malloc(count * sizeof(uint64_t));
+static void swap_double(double *a, double *b) {
+    double t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static double select_double(double *data, uint32_t count, uint32_t k) {
+    uint32_t lo = 0;
+    uint32_t hi = count - 1;
+
+    while (hi > lo) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (data[mid] < data[lo]) swap_double(&data[mid], &data[lo]);
+        if (data[hi] < data[lo]) swap_double(&data[hi], &data[lo]);
+        if (data[hi] < data[mid]) swap_double(&data[hi], &data[mid]);
+
+        double pivot = data[mid];
+        uint32_t i = lo;
+        uint32_t j = hi;
+
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                swap_double(&data[i], &data[j]);
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+
+    return data[k];
+}
+
+typedef struct {
+    uint64_t *values;
+    uint32_t *counts;
+    uint32_t bins;
+    uint32_t total;
+} value_histogram_t;
+
+static value_histogram_t* histogram_build(const sample_population_t *pop,
+                                          uint64_t max_range) {
+    if (max_range == 0 || pop->count == 0) return NULL;
+
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    for (uint32_t i = 0; i < pop->count; i++) {
+        if (pop->data[i] < min) min = pop->data[i];
+        if (pop->data[i] > max) max = pop->data[i];
+    }
+
+    if (max - min > max_range) return NULL;
+
+    uint32_t span = (uint32_t)(max - min) + 1;
+    uint32_t *dense = calloc(span, sizeof(uint32_t));
+    if (!dense) return NULL;
+
+    for (uint32_t i = 0; i < pop->count; i++) {
+        dense[pop->data[i] - min]++;
+    }
+
+    uint32_t bins = 0;
+    for (uint32_t v = 0; v < span; v++) {
+        if (dense[v]) bins++;
+    }
+
+    value_histogram_t *hist = calloc(1, sizeof(value_histogram_t));
+    if (hist) {
+        hist->values = malloc(bins * sizeof(uint64_t));
+        hist->counts = malloc(bins * sizeof(uint32_t));
+    }
+    if (!hist || !hist->values || !hist->counts) {
+        if (hist) {
+            free(hist->values);
+            free(hist->counts);
+        }
+        free(hist);
+        free(dense);
+        return NULL;
+    }
+
+    for (uint32_t v = 0; v < span; v++) {
+        if (dense[v]) {
+            hist->values[hist->bins] = min + v;
+            hist->counts[hist->bins] = dense[v];
+            hist->bins++;
+        }
+    }
+    hist->total = pop->count;
+
+    free(dense);
+    return hist;
+}
+
+static void histogram_destroy(value_histogram_t *hist) {
+    if (hist) {
+        free(hist->values);
+        free(hist->counts);
+        free(hist);
+    }
+}
+
+static double binomial_tail_correction(double k) {
+    static const double tail[] = {
+        0.0810614667953272, 0.0413406959554092, 0.0276779256849983,
+        0.02079067210376509, 0.0166446911898211, 0.0138761288230707,
+        0.0118967099458917, 0.0104112652619720, 0.00925546218271273,
+        0.00833056343336287
+    };
+
+    if (k <= 9) return tail[(int)k];
+
+    double kp1sq = (k + 1) * (k + 1);
+    return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 / kp1sq) / kp1sq) / (k + 1);
+}
+
+// Hormann's BTRS transformed rejection, valid for n * p >= 10 and p <= 0.5.
+static uint32_t binomial_btrs(rng_t *rng, uint32_t n, double p) {
+    double count = n;
+    double stddev = sqrt(count * p * (1 - p));
+    double b = 1.15 + 2.53 * stddev;
+    double a = -0.0873 + 0.0248 * b + 0.01 * p;
+    double c = count * p + 0.5;
+    double v_r = 0.92 - 4.2 / b;
+    double r = p / (1 - p);
+    double alpha = (2.83 + 5.1 / b) * stddev;
+    double m = floor((count + 1) * p);
+
+    while (true) {
+        double u = rng_uniform(rng) - 0.5;
+        double v = rng_uniform(rng);
+        double us = 0.5 - fabs(u);
+        double k = floor((2 * a / us + b) * u + c);
+
+        if (us >= 0.07 && v <= v_r) return (uint32_t)k;
+        if (k < 0 || k > count) continue;
+
+        v = log(v * alpha / (a / (us * us) + b));
+        double bound = (m + 0.5) * log((m + 1) / (r * (count - m + 1))) +
+                       (count + 1) * log((count - m + 1) / (count - k + 1)) +
+                       (k + 0.5) * log(r * (count - k + 1) / (k + 1)) +
+                       binomial_tail_correction(m) +
+                       binomial_tail_correction(count - m) -
+                       binomial_tail_correction(k) -
+                       binomial_tail_correction(count - k);
+        if (v <= bound) return (uint32_t)k;
+    }
+}
+
+// Geometric waiting-time inversion, used when n * p < 10.
+static uint32_t binomial_inversion(rng_t *rng, uint32_t n, double p) {
+    double log_q = log1p(-p);
+    double geom_sum = 0;
+    uint32_t k = 0;
+
+    while (true) {
+        geom_sum += ceil(log(1.0 - rng_uniform(rng)) / log_q);
+        if (geom_sum > n) break;
+        k++;
+    }
+
+    return k;
+}
+
+static uint32_t binomial_draw(rng_t *rng, uint32_t n, double p) {
+    if (n == 0 || p <= 0.0) return 0;
+    if (p >= 1.0) return n;
+
+    if (p > 0.5) {
+        return n - binomial_draw(rng, n, 1.0 - p);
+    }
+
+    return (n * p < 10.0) ? binomial_inversion(rng, n, p) : binomial_btrs(rng, n, p);
+}
+
+// Draws the bin counts of a size-total resample one bin at a time as
+// conditional binomials, stopping once the median rank is covered.
+static uint64_t histogram_resample_median(rng_t *rng, const value_histogram_t *hist) {
+    uint32_t n = hist->total;
+    uint32_t upper_rank = n / 2;
+    uint32_t lower_rank = (n % 2 == 0) ? upper_rank - 1 : upper_rank;
+
+    uint32_t remaining_draws = n;
+    uint32_t remaining_mass = n;
+    uint32_t cumulative = 0;
+    uint64_t lower = 0;
+    bool have_lower = false;
+
+    for (uint32_t j = 0; j < hist->bins; j++) {
+        uint32_t drawn = (j == hist->bins - 1) ? remaining_draws :
+            binomial_draw(rng, remaining_draws,
+                          (double)hist->counts[j] / remaining_mass);
+
+        cumulative += drawn;
+        remaining_draws -= drawn;
+        remaining_mass -= hist->counts[j];
+
+        if (!have_lower && cumulative > lower_rank) {
+            lower = hist->values[j];
+            have_lower = true;
+        }
+        if (cumulative > upper_rank) {
+            return (lower + hist->values[j]) / 2;
+        }
+    }
 
+    return hist->values[hist->bins - 1];
+}
+
+static void bootstrap_resample(rng_t *rng, const uint64_t *data, uint32_t count,
+                               uint64_t *out) {
     for (uint32_t i = 0; i < count; i++) {
-        uint32_t idx = rand() % count;
-        sample[i] = data[idx];
+        out[i] = data[rng_bounded(rng, count)];
+    }
+}
+
+static uint64_t bootstrap_round_median(rng_t *rng, const sample_population_t *pop,
+                                       const value_histogram_t *hist,
+                                       uint64_t *scratch) {
+    if (hist) {
+        return histogram_resample_median(rng, hist);
+    }
+
+    bootstrap_resample(rng, pop->data, pop->count, scratch);
+    return stats_median_inplace(scratch, pop->count);
+}
+
+typedef struct {
+    const sample_population_t *leak;
+    const sample_population_t *no_leak;
+    const value_histogram_t *leak_hist;
+    const value_histogram_t *no_leak_hist;
+    double *test_stats;
+    uint32_t round_begin;
+    uint32_t round_end;
+    uint32_t total_rounds;
+    uint64_t seed;
+    uint32_t *rounds_done;
+    bool report_progress;
+    bool ok;
+} bootstrap_worker_t;
+
+static void* bootstrap_worker(void *arg) {
+    bootstrap_worker_t *w = (bootstrap_worker_t*)arg;
+
+    // Exact resampling needs one scratch buffer per population; histogram
+    // mode needs none.
+    uint64_t *scratch_leak = NULL;
+    uint64_t *scratch_no_leak = NULL;
+    if (!w->leak_hist) scratch_leak = malloc(w->leak->count * sizeof(uint64_t));
+    if (!w->no_leak_hist) scratch_no_leak = malloc(w->no_leak->count * sizeof(uint64_t));
+
+    if ((!w->leak_hist && !scratch_leak) || (!w->no_leak_hist && !scratch_no_leak)) {
+        free(scratch_leak);
+        free(scratch_no_leak);
+        w->ok = false;
+        return NULL;
+    }
+
+    for (uint32_t i = w->round_begin; i < w->round_end; i++) {
+        // One stream per round, so results do not depend on how rounds are
+        // split across workers.
+        rng_t rng;
+        rng_seed(&rng, w->seed, i);
+
+        uint64_t median_leak = bootstrap_round_median(&rng, w->leak, w->leak_hist,
+                                                      scratch_leak);
+        uint64_t median_no_leak = bootstrap_round_median(&rng, w->no_leak, w->no_leak_hist,
+                                                         scratch_no_leak);
+
+        w->test_stats[i] = (double)median_leak - (double)median_no_leak;
+
+        uint32_t done = __atomic_add_fetch(w->rounds_done, 1, __ATOMIC_RELAXED);
+        if (w->report_progress && done % 1000 == 0) {
+            printf("    Progress: %u/%u\r", done, w->total_rounds);
+            fflush(stdout);
+        }
+    }
+
+    free(scratch_leak);
+    free(scratch_no_leak);
+    w->ok = true;
+    return NULL;
+}
+
+static uint32_t bootstrap_thread_count(bootstrap_config_t *config) {
+    uint32_t threads = config->num_threads;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (uint32_t)online : 1;
+    }
+    if (threads > BOOTSTRAP_MAX_THREADS) threads = BOOTSTRAP_MAX_THREADS;
+    if (threads > config->bootstrap_rounds) threads = config->bootstrap_rounds;
+
+    return threads;
+}
+
+static bool bootstrap_run_rounds(sample_population_t *leak, sample_population_t *no_leak,
+                                 const value_histogram_t *leak_hist,
+                                 const value_histogram_t *no_leak_hist,
+                                 bootstrap_config_t *config, double *test_stats) {
+    uint32_t threads = bootstrap_thread_count(config);
+    uint32_t rounds = config->bootstrap_rounds;
+    uint32_t rounds_done = 0;
+
+    bootstrap_worker_t workers[BOOTSTRAP_MAX_THREADS];
+    pthread_t tids[BOOTSTRAP_MAX_THREADS];
+    bool launched[BOOTSTRAP_MAX_THREADS] = {false};
+
+    for (uint32_t t = 0; t < threads; t++) {
+        workers[t] = (bootstrap_worker_t){
+            .leak = leak,
+            .no_leak = no_leak,
+            .leak_hist = leak_hist,
+            .no_leak_hist = no_leak_hist,
+            .test_stats = test_stats,
+            .round_begin = (uint32_t)((uint64_t)rounds * t / threads),
+            .round_end = (uint32_t)((uint64_t)rounds * (t + 1) / threads),
+            .total_rounds = rounds,
+            .seed = config->seed,
+            .rounds_done = &rounds_done,
+            .report_progress = (t == 0 && !config->quiet),
+            .ok = false
+        };
     }
 
-    return sample;
+    for (uint32_t t = 1; t < threads; t++) {
+        launched[t] = (pthread_create(&tids[t], NULL, bootstrap_worker, &workers[t]) == 0);
+    }
+
+    bootstrap_worker(&workers[0]);
+
+    bool ok = workers[0].ok;
+    for (uint32_t t = 1; t < threads; t++) {
+        if (launched[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            bootstrap_worker(&workers[t]);
+        }
+        ok = ok && workers[t].ok;
+    }
+    if (!config->quiet) printf("\n");
+
+    return ok;
 }
 
 bool bootstrap_test(sample_population_t *leak, sample_population_t *no_leak,
@@ -141,64 +667,188 @@ bool bootstrap_test(sample_population_t *leak, sample_population_t *no_leak,
         return false;
     }
 
-    printf("[*] Running bootstrap test (%u rounds)...\n", config->bootstrap_rounds);
+    if (config->bootstrap_rounds == 0) {
+        fprintf(stderr, "[-] Bootstrap test requires at least one round\n");
+        return false;
+    }
+
+    if (!config->quiet) {
+        printf("[*] Running bootstrap test (%u rounds, %u threads)...\n",
+               config->bootstrap_rounds, bootstrap_thread_count(config));
+    }
 
     double *test_stats = calloc(config->bootstrap_rounds, sizeof(double));
     if (!test_stats) return false;
 
+    // Taken from the samples the replicates resample, with the same median
+    // rule: the sketch's bucket midpoint would offset the replicates' center
+    // from observed_diff and bias the p-value.
     uint64_t observed_median_leak = stats_median(leak->data, leak->count);
     uint64_t observed_median_no_leak = stats_median(no_leak->data, no_leak->count);
     double observed_diff = (double)observed_median_leak - (double)observed_median_no_leak;
 
-    for (uint32_t i = 0; i < config->bootstrap_rounds; i++) {
-        uint64_t *sample_leak = bootstrap_sample(leak->data, leak->count);
-        uint64_t *sample_no_leak = bootstrap_sample(no_leak->data, no_leak->count);
+    value_histogram_t *leak_hist = histogram_build(leak, config->histogram_max_range);
+    value_histogram_t *no_leak_hist = histogram_build(no_leak, config->histogram_max_range);
 
-        uint64_t median_leak = stats_median(sample_leak, leak->count);
-        uint64_t median_no_leak = stats_median(sample_no_leak, no_leak->count);
+    if ((leak_hist || no_leak_hist) && !config->quiet) {
+        printf("    Histogram resampling: leak %s (%u bins), no_leak %s (%u bins)\n",
+               leak_hist ? "yes" : "no", leak_hist ? leak_hist->bins : 0,
+               no_leak_hist ? "yes" : "no", no_leak_hist ? no_leak_hist->bins : 0);
+    }
 
-        test_stats[i] = (double)median_leak - (double)median_no_leak;
+    bool rounds_ok = bootstrap_run_rounds(leak, no_leak, leak_hist, no_leak_hist,
+                                          config, test_stats);
 
-        free(sample_leak);
-        free(sample_no_leak);
+    histogram_destroy(leak_hist);
+    histogram_destroy(no_leak_hist);
 
-        if (i % 1000 == 0 && i > 0) {
-            printf("    Progress: %u/%u\r", i, config->bootstrap_rounds);
-            fflush(stdout);
-        }
+    if (!rounds_ok) {
+        fprintf(stderr, "[-] Bootstrap workers failed to allocate scratch buffers\n");
+        free(test_stats);
+        return false;
     }
-    printf("\n");
 
-    qsort(test_stats, config->bootstrap_rounds, sizeof(double),
-          (int(*)(const void*, const void*))compare_uint64);
+    // The replicates are spread around observed_diff; shifted to center on
+    // zero they approximate the statistic's null distribution.
+    uint32_t count_extreme = 0;
+    for (uint32_t i = 0; i < config->bootstrap_rounds; i++) {
+        if (fabs(test_stats[i] - observed_diff) >= fabs(observed_diff)) {
+            count_extreme++;
+        }
+    }
 
     uint32_t lower_idx = (uint32_t)(config->alpha / 2.0 * config->bootstrap_rounds);
     uint32_t upper_idx = (uint32_t)((1.0 - config->alpha / 2.0) * config->bootstrap_rounds);
+    if (upper_idx >= config->bootstrap_rounds) upper_idx = config->bootstrap_rounds - 1;
+    if (lower_idx > upper_idx) lower_idx = upper_idx;
 
     result->median_diff = observed_diff;
-    result->ci_lower = test_stats[lower_idx];
-    result->ci_upper = test_stats[upper_idx];
+    result->ci_lower = select_double(test_stats, config->bootstrap_rounds, lower_idx);
+    result->ci_upper = (upper_idx == lower_idx) ? result->ci_lower :
+        select_double(test_stats + lower_idx + 1,
+                      config->bootstrap_rounds - lower_idx - 1,
+                      upper_idx - lower_idx - 1);
     result->bootstrap_rounds = config->bootstrap_rounds;
 
-    uint32_t count_extreme = 0;
-    for (uint32_t i = 0; i < config->bootstrap_rounds; i++) {
-        if (fabs(test_stats[i]) >= fabs(observed_diff)) {
-            count_extreme++;
-        }
-    }
-    result->p_value = (double)count_extreme / config->bootstrap_rounds;
+    result->p_value = (double)(count_extreme + 1) / (config->bootstrap_rounds + 1);
 
     result->is_significant = (result->p_value < config->alpha);
     result->exceeds_threshold = (fabs(observed_diff) > config->negligible_threshold_cycles);
 
-    printf("[+] Bootstrap Results:\n");
-    printf("    Median difference: %.2f cycles\n", result->median_diff);
-    printf("    95%% CI: [%.2f, %.2f]\n", result->ci_lower, result->ci_upper);
-    printf("    p-value: %.6f\n", result->p_value);
-    printf("    Significant: %s\n", result->is_significant ? "YES" : "NO");
-    printf("    Exceeds threshold: %s\n", result->exceeds_threshold ? "YES" : "NO");
+    if (!config->quiet) {
+        printf("[+] Bootstrap Results:\n");
+        printf("    Median difference: %.2f cycles\n", result->median_diff);
+        printf("    95%% CI: [%.2f, %.2f]\n", result->ci_lower, result->ci_upper);
+        printf("    p-value: %.6f\n", result->p_value);
+        printf("    Significant: %s\n", result->is_significant ? "YES" : "NO");
+        printf("    Exceeds threshold: %s\n", result->exceeds_threshold ? "YES" : "NO");
+    }
 
     free(test_stats);
 
     return (result->is_significant && result->exceeds_threshold);
 }
+
+static double normal_cdf(double x) {
+    return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+static double normal_quantile(double p) {
+    double lo = -40.0;
+    double hi = 40.0;
+
+    for (int i = 0; i < 200; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (normal_cdf(mid) < p) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return 0.5 * (lo + hi);
+}
+
+double sequential_alpha_spent(double alpha, double information_fraction) {
+    if (information_fraction <= 0.0) return 0.0;
+    if (information_fraction >= 1.0) return alpha;
+
+    // Lan-DeMets O'Brien-Fleming-type spending function (two-sided).
+    double z = normal_quantile(1.0 - alpha / 2.0);
+    return 2.0 * (1.0 - normal_cdf(z / sqrt(information_fraction)));
+}
+
+void sequential_init(sequential_state_t *seq) {
+    seq->looks_done = 0;
+    seq->alpha_spent = 0.0;
+    seq->last_nominal_alpha = 0.0;
+    seq->last_rounds = 0;
+}
+
+sequential_decision_t bootstrap_sequential_look(sample_population_t *leak,
+                                                sample_population_t *no_leak,
+                                                bootstrap_config_t *config,
+                                                sequential_state_t *seq,
+                                                double information_fraction,
+                                                bootstrap_result_t *result) {
+    double cumulative = sequential_alpha_spent(config->alpha, information_fraction);
+    double nominal_alpha = cumulative - seq->alpha_spent;
+    if (nominal_alpha < 0.0) nominal_alpha = 0.0;
+
+    seq->alpha_spent = cumulative;
+    seq->last_nominal_alpha = nominal_alpha;
+    seq->last_rounds = 0;
+    seq->looks_done++;
+
+    if (leak->count < 10 || no_leak->count < 10) {
+        return SEQUENTIAL_CONTINUE;
+    }
+
+    // The p-value is at least 1/(rounds + 1), so the look needs more than
+    // 1/nominal_alpha - 1 rounds to reject at all. Early O'Brien-Fleming
+    // looks can need far more than that; a look costing over
+    // SEQUENTIAL_MAX_ROUND_FACTOR full tests is skipped, its alpha still spent.
+    double needed = (nominal_alpha > 0.0) ? ceil(1.0 / nominal_alpha) : INFINITY;
+    if (needed > (double)config->bootstrap_rounds * SEQUENTIAL_MAX_ROUND_FACTOR) {
+        return SEQUENTIAL_CONTINUE;
+    }
+
+    // The final look tests outlier-cleaned populations, so every look does:
+    // alpha is spent on one statistic. The campaign keeps the raw samples.
+    sample_population_t *clean_leak = population_clone(leak);
+    sample_population_t *clean_no_leak = population_clone(no_leak);
+    if (!clean_leak || !clean_no_leak) {
+        population_destroy(clean_leak);
+        population_destroy(clean_no_leak);
+        return SEQUENTIAL_CONTINUE;
+    }
+
+    bootstrap_config_t look_config = *config;
+    look_config.quiet = true;
+    if (needed > look_config.bootstrap_rounds) look_config.bootstrap_rounds = (uint32_t)needed;
+
+    population_clean_outliers(clean_leak, &look_config);
+    population_clean_outliers(clean_no_leak, &look_config);
+
+    bool enough = clean_leak->count >= 10 && clean_no_leak->count >= 10;
+    if (enough) bootstrap_test(clean_leak, clean_no_leak, &look_config, result);
+    population_destroy(clean_leak);
+    population_destroy(clean_no_leak);
+    if (!enough) return SEQUENTIAL_CONTINUE;
+    seq->last_rounds = look_config.bootstrap_rounds;
+
+    // Efficacy is judged at the spent nominal level so the campaign-wide
+    // Type-I error stays within config->alpha across all looks.
+    result->is_significant = (result->p_value < nominal_alpha);
+    if (result->is_significant && result->exceeds_threshold) {
+        return SEQUENTIAL_REJECT;
+    }
+
+    // Non-binding futility: the whole CI sits inside the negligible band.
+    double threshold = (double)config->negligible_threshold_cycles;
+    if (result->ci_lower > -threshold && result->ci_upper < threshold) {
+        return SEQUENTIAL_ACCEPT;
+    }
+
+    return SEQUENTIAL_CONTINUE;
+}
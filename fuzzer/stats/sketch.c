@@ -0,0 +1,134 @@
+#include "sketch.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t bucket_index(uint64_t value) {
+    if (value < SKETCH_SUB_COUNT) {
+        return (uint32_t)value;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - SKETCH_SUB_BITS + 1;
+    uint32_t top = (uint32_t)(value >> shift);
+
+    return SKETCH_SUB_COUNT + (shift - 1) * SKETCH_HALF_COUNT + (top - SKETCH_HALF_COUNT);
+}
+
+static uint64_t bucket_lower(uint32_t index) {
+    if (index < SKETCH_SUB_COUNT) {
+        return index;
+    }
+
+    uint32_t shift = (index - SKETCH_SUB_COUNT) / SKETCH_HALF_COUNT + 1;
+    uint64_t top = (index - SKETCH_SUB_COUNT) % SKETCH_HALF_COUNT + SKETCH_HALF_COUNT;
+
+    return top << shift;
+}
+
+static uint64_t bucket_upper(uint32_t index) {
+    if (index < SKETCH_SUB_COUNT) {
+        return index;
+    }
+
+    uint32_t shift = (index - SKETCH_SUB_COUNT) / SKETCH_HALF_COUNT + 1;
+    return bucket_lower(index) + ((1ULL << shift) - 1);
+}
+
+quantile_sketch_t* sketch_create(void) {
+    quantile_sketch_t *sketch = malloc(sizeof(quantile_sketch_t));
+    if (!sketch) return NULL;
+
+    sketch_reset(sketch);
+    return sketch;
+}
+
+void sketch_destroy(quantile_sketch_t *sketch) {
+    free(sketch);
+}
+
+void sketch_reset(quantile_sketch_t *sketch) {
+    memset(sketch->counts, 0, sizeof(sketch->counts));
+    sketch->total = 0;
+    sketch->min = UINT64_MAX;
+    sketch->max = 0;
+}
+
+void sketch_add(quantile_sketch_t *sketch, uint64_t value) {
+    sketch->counts[bucket_index(value)]++;
+    sketch->total++;
+
+    if (value < sketch->min) sketch->min = value;
+    if (value > sketch->max) sketch->max = value;
+}
+
+void sketch_merge(quantile_sketch_t *dst, const quantile_sketch_t *src) {
+    for (uint32_t i = 0; i < SKETCH_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+
+    dst->total += src->total;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t sketch_value_at_rank(const quantile_sketch_t *sketch, uint64_t rank) {
+    if (sketch->total == 0) return 0;
+    if (rank >= sketch->total) rank = sketch->total - 1;
+
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < SKETCH_BUCKETS; i++) {
+        cumulative += sketch->counts[i];
+        if (cumulative > rank) {
+            uint64_t lower = bucket_lower(i);
+            uint64_t value = lower + (bucket_upper(i) - lower) / 2;
+
+            if (value < sketch->min) value = sketch->min;
+            if (value > sketch->max) value = sketch->max;
+            return value;
+        }
+    }
+
+    return sketch->max;
+}
+
+uint64_t sketch_median(const quantile_sketch_t *sketch) {
+    if (sketch->total == 0) return 0;
+
+    uint64_t upper = sketch_value_at_rank(sketch, sketch->total / 2);
+    if (sketch->total % 2 != 0) {
+        return upper;
+    }
+
+    uint64_t lower = sketch_value_at_rank(sketch, sketch->total / 2 - 1);
+    return (lower + upper) / 2;
+}
+
+uint64_t sketch_remove_outside(quantile_sketch_t *sketch, uint64_t lower, uint64_t upper) {
+    uint64_t removed = 0;
+    uint64_t new_min = UINT64_MAX;
+    uint64_t new_max = 0;
+
+    for (uint32_t i = 0; i < SKETCH_BUCKETS; i++) {
+        if (sketch->counts[i] == 0) continue;
+
+        if (bucket_upper(i) < lower || bucket_lower(i) > upper) {
+            removed += sketch->counts[i];
+            sketch->counts[i] = 0;
+            continue;
+        }
+
+        if (new_min == UINT64_MAX) new_min = bucket_lower(i);
+        new_max = bucket_upper(i);
+    }
+
+    sketch->total -= removed;
+    if (sketch->total == 0) {
+        sketch->min = UINT64_MAX;
+        sketch->max = 0;
+    } else {
+        if (new_min > sketch->min) sketch->min = new_min;
+        if (new_max < sketch->max) sketch->max = new_max;
+    }
+
+    return removed;
+}
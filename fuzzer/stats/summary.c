@@ -0,0 +1,230 @@
+#include "summary.h"
+#include <string.h>
+#include <x86intrin.h>
+
+// Exact int64 -> double for |d| < 2^51 without AVX-512DQ.
+#define MAGIC_2P52_2P51 6755399441055744.0
+#define AVX2_EXACT_RANGE (1ULL << 51)
+
+typedef struct {
+    uint64_t ref;
+    uint64_t min;
+    uint64_t max;
+    uint64_t above;
+    double s1;
+    double s2;
+} summary_acc_t;
+
+static void acc_init(summary_acc_t *acc, uint64_t ref) {
+    acc->ref = ref;
+    acc->min = UINT64_MAX;
+    acc->max = 0;
+    acc->above = 0;
+    acc->s1 = 0.0;
+    acc->s2 = 0.0;
+}
+
+static inline __attribute__((always_inline))
+uint64_t load_element(const void *data, size_t i, int wide) {
+    return wide ? ((const uint64_t *)data)[i] : ((const uint32_t *)data)[i];
+}
+
+static inline __attribute__((always_inline))
+double shifted(uint64_t v, uint64_t ref) {
+    return (v >= ref) ? (double)(v - ref) : -(double)(ref - v);
+}
+
+static inline __attribute__((always_inline))
+void scalar_range(const void *data, size_t begin, size_t end, int wide,
+                  uint64_t threshold, summary_acc_t *acc) {
+    for (size_t i = begin; i < end; i++) {
+        uint64_t v = load_element(data, i, wide);
+        double d = shifted(v, acc->ref);
+
+        if (v < acc->min) acc->min = v;
+        if (v > acc->max) acc->max = v;
+        acc->above += (v > threshold);
+        acc->s1 += d;
+        acc->s2 += d * d;
+    }
+}
+
+static inline __attribute__((always_inline))
+void scalar_sums(const void *data, size_t count, int wide, summary_acc_t *acc) {
+    acc->s1 = 0.0;
+    acc->s2 = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double d = shifted(load_element(data, i, wide), acc->ref);
+        acc->s1 += d;
+        acc->s2 += d * d;
+    }
+}
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+
+static inline __attribute__((always_inline))
+size_t simd_range(const void *data, size_t count, int wide, uint64_t threshold,
+                  summary_acc_t *acc) {
+    __m512i vmin = _mm512_set1_epi64((long long)UINT64_MAX);
+    __m512i vmax = _mm512_setzero_si512();
+    __m512i vthr = _mm512_set1_epi64((long long)threshold);
+    __m512i vref = _mm512_set1_epi64((long long)acc->ref);
+    __m512d vs1 = _mm512_setzero_pd();
+    __m512d vs2 = _mm512_setzero_pd();
+    uint64_t above = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i x = wide
+            ? _mm512_loadu_si512((const void *)((const uint64_t *)data + i))
+            : _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i *)((const uint32_t *)data + i)));
+
+        vmin = _mm512_min_epu64(vmin, x);
+        vmax = _mm512_max_epu64(vmax, x);
+        above += __builtin_popcount(_mm512_cmpgt_epu64_mask(x, vthr));
+
+        __m512d d = _mm512_cvtepi64_pd(_mm512_sub_epi64(x, vref));
+        vs1 = _mm512_add_pd(vs1, d);
+        vs2 = _mm512_fmadd_pd(d, d, vs2);
+    }
+
+    if (i > 0) {
+        acc->min = _mm512_reduce_min_epu64(vmin);
+        acc->max = _mm512_reduce_max_epu64(vmax);
+        acc->above = above;
+        acc->s1 = _mm512_reduce_add_pd(vs1);
+        acc->s2 = _mm512_reduce_add_pd(vs2);
+    }
+
+    return i;
+}
+
+#define SIMD_EXACT_RANGE (1ULL << 63)
+
+#elif defined(__AVX2__)
+
+static inline __attribute__((always_inline))
+void store_lanes(__m256i v, uint64_t lanes[4]) {
+    _mm256_storeu_si256((__m256i *)lanes, v);
+}
+
+static inline __attribute__((always_inline))
+double hreduce_pd(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+static inline __attribute__((always_inline))
+size_t simd_range(const void *data, size_t count, int wide, uint64_t threshold,
+                  summary_acc_t *acc) {
+    // AVX2 only has signed 64-bit compares; flipping the sign bit makes
+    // them unsigned.
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i magic_i = _mm256_castpd_si256(_mm256_set1_pd(MAGIC_2P52_2P51));
+    const __m256d magic_d = _mm256_set1_pd(MAGIC_2P52_2P51);
+
+    __m256i vmin = _mm256_set1_epi64x((long long)UINT64_MAX);
+    __m256i vmax = _mm256_setzero_si256();
+    __m256i vthr = _mm256_xor_si256(_mm256_set1_epi64x((long long)threshold), sign);
+    __m256i vref = _mm256_set1_epi64x((long long)acc->ref);
+    __m256i vabove = _mm256_setzero_si256();
+    __m256d vs1 = _mm256_setzero_pd();
+    __m256d vs2 = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = wide
+            ? _mm256_loadu_si256((const __m256i *)((const uint64_t *)data + i))
+            : _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)((const uint32_t *)data + i)));
+        __m256i xs = _mm256_xor_si256(x, sign);
+
+        __m256i lt = _mm256_cmpgt_epi64(_mm256_xor_si256(vmin, sign), xs);
+        vmin = _mm256_blendv_epi8(vmin, x, lt);
+        __m256i gt = _mm256_cmpgt_epi64(xs, _mm256_xor_si256(vmax, sign));
+        vmax = _mm256_blendv_epi8(vmax, x, gt);
+        vabove = _mm256_sub_epi64(vabove, _mm256_cmpgt_epi64(xs, vthr));
+
+        __m256i d = _mm256_sub_epi64(x, vref);
+        __m256d dd = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(d, magic_i)), magic_d);
+        vs1 = _mm256_add_pd(vs1, dd);
+        vs2 = _mm256_add_pd(vs2, _mm256_mul_pd(dd, dd));
+    }
+
+    if (i > 0) {
+        uint64_t mins[4], maxs[4], aboves[4];
+        store_lanes(vmin, mins);
+        store_lanes(vmax, maxs);
+        store_lanes(vabove, aboves);
+
+        for (int k = 0; k < 4; k++) {
+            if (mins[k] < acc->min) acc->min = mins[k];
+            if (maxs[k] > acc->max) acc->max = maxs[k];
+            acc->above += aboves[k];
+        }
+        acc->s1 = hreduce_pd(vs1);
+        acc->s2 = hreduce_pd(vs2);
+    }
+
+    return i;
+}
+
+#define SIMD_EXACT_RANGE AVX2_EXACT_RANGE
+
+#else
+
+static inline __attribute__((always_inline))
+size_t simd_range(const void *data, size_t count, int wide, uint64_t threshold,
+                  summary_acc_t *acc) {
+    (void)data; (void)count; (void)wide; (void)threshold; (void)acc;
+    return 0;
+}
+
+#define SIMD_EXACT_RANGE UINT64_MAX
+
+#endif
+
+static inline __attribute__((always_inline))
+void summarize(const void *data, size_t count, int wide, uint64_t threshold,
+               summary_t *out) {
+    memset(out, 0, sizeof(summary_t));
+    out->min = UINT64_MAX;
+    if (count == 0) return;
+
+    summary_acc_t acc;
+    acc_init(&acc, load_element(data, 0, wide));
+
+    size_t done = simd_range(data, count, wide, threshold, &acc);
+    scalar_range(data, done, count, wide, threshold, &acc);
+
+    // The vector paths treat x - ref as int64 (and AVX2 converts it exactly
+    // only below 2^51); redo the sums in scalar for wider ranges.
+    if (done > 0 && acc.max - acc.min >= SIMD_EXACT_RANGE) {
+        scalar_sums(data, count, wide, &acc);
+    }
+
+    out->count = count;
+    out->min = acc.min;
+    out->max = acc.max;
+    out->above = acc.above;
+    out->mean = (double)acc.ref + acc.s1 / count;
+    out->m2 = acc.s2 - acc.s1 * acc.s1 / count;
+    if (out->m2 < 0.0) out->m2 = 0.0;
+}
+
+void summary_u64(const uint64_t *data, size_t count, uint64_t threshold, summary_t *out) {
+    summarize(data, count, 1, threshold, out);
+}
+
+void summary_u32(const uint32_t *data, size_t count, uint32_t threshold, summary_t *out) {
+    summarize(data, count, 0, threshold, out);
+}
+
+double summary_variance(const summary_t *s) {
+    return (s->count > 0) ? s->m2 / s->count : 0.0;
+}
+
+double summary_sample_variance(const summary_t *s) {
+    return (s->count > 1) ? s->m2 / (s->count - 1) : 0.0;
+}
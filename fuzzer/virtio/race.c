@@ -1,5 +1,6 @@
 #include "race.h"
 #include "cache.h"
+#include "summary.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -33,26 +34,13 @@ bool race_estimate_iotlb_window(iotlb_profile_t *profile, uint32_t samples) {
     }
     printf("\n");
 
-    uint64_t sum = 0;
-    uint64_t min = UINT64_MAX;
-    uint64_t max = 0;
+    summary_t summary;
+    summary_u64(measurements, samples, UINT64_MAX, &summary);
 
-    for (uint32_t i = 0; i < samples; i++) {
-        sum += measurements[i];
-        if (measurements[i] < min) min = measurements[i];
-        if (measurements[i] > max) max = measurements[i];
-    }
-
-    profile->iotlb_inv_mean = sum / samples;
-    profile->iotlb_inv_min = min;
-    profile->iotlb_inv_max = max;
-
-    uint64_t var_sum = 0;
-    for (uint32_t i = 0; i < samples; i++) {
-        int64_t diff = measurements[i] - profile->iotlb_inv_mean;
-        var_sum += diff * diff;
-    }
-    profile->iotlb_inv_stddev = (uint64_t)sqrt(var_sum / samples);
+    profile->iotlb_inv_mean = (uint64_t)summary.mean;
+    profile->iotlb_inv_min = summary.min;
+    profile->iotlb_inv_max = summary.max;
+    profile->iotlb_inv_stddev = (uint64_t)sqrt(summary_variance(&summary));
     profile->sample_count = samples;
 
     printf("[+] IOTLB Window Profile:\n");